@@ -60,7 +60,7 @@
 #define configENABLE_FPU                         0
 #define configENABLE_MPU                         0
 
-#define configUSE_PREEMPTION                     0
+#define configUSE_PREEMPTION                     1
 #define configSUPPORT_STATIC_ALLOCATION          1
 #define configSUPPORT_DYNAMIC_ALLOCATION         1
 #define configUSE_IDLE_HOOK                      0
@@ -69,12 +69,13 @@
 #define configTICK_RATE_HZ                       ((TickType_t)1000)
 #define configMAX_PRIORITIES                     ( 56 )
 #define configMINIMAL_STACK_SIZE                 ((uint16_t)128)
-#define configTOTAL_HEAP_SIZE                    ((size_t)20000)
+/* Every kernel object is statically allocated, this only holds the CMSIS timer callback wrappers */
+#define configTOTAL_HEAP_SIZE                    ((size_t)1024)
 #define configMAX_TASK_NAME_LEN                  ( 16 )
 #define configUSE_TRACE_FACILITY                 1
 #define configUSE_16_BIT_TICKS                   0
 #define configUSE_MUTEXES                        1
-#define configQUEUE_REGISTRY_SIZE                8
+#define configQUEUE_REGISTRY_SIZE                16
 #define configCHECK_FOR_STACK_OVERFLOW           2
 #define configUSE_RECURSIVE_MUTEXES              1
 #define configUSE_MALLOC_FAILED_HOOK             1
@@ -92,7 +93,8 @@
 
 /* Software timer definitions. */
 #define configUSE_TIMERS                         1
-#define configTIMER_TASK_PRIORITY                ( 2 )
+/* Must match TASK_PRIORITY(TIMER_SERVICE), checked in task_sched.c */
+#define configTIMER_TASK_PRIORITY                ( 49 )
 #define configTIMER_QUEUE_LENGTH                 10
 #define configTIMER_TASK_STACK_DEPTH             256
 
@@ -168,6 +170,30 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+/* Run time stats count CPU cycles on the DWT cycle counter, which task_sched_init() starts */
+#define configGENERATE_RUN_TIME_STATS            1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()         (*(volatile uint32_t *)0xE0001004) /* DWT->CYCCNT */
+#define INCLUDE_xTaskGetIdleTaskHandle           1
+
+/* Kernel event trace and queue high water marks, see trace.h and queue_stats.h */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+  #include "trace.h"
+  #include "queue_stats.h"
+#endif
+#define traceTASK_CREATE(pxNewTCB)            trace_task_created((pxNewTCB)->uxTCBNumber, (pxNewTCB)->pcTaskName)
+#define traceTASK_SWITCHED_IN()               trace_task_switched_in(pxCurrentTCB->uxTCBNumber, pxCurrentTCB->uxPriority)
+#define traceQUEUE_CREATE(pxNewQueue)         queue_stats_created((pxNewQueue), (pxNewQueue)->uxItemSize)
+#define traceQUEUE_SEND(pxQueue)              do { trace_record(TRACE_QUEUE_SEND, trace_object_id(pxQueue)); \
+                                                   queue_stats_sent((pxQueue)->uxQueueNumber, (pxQueue)->uxMessagesWaiting + 1); } while (0)
+#define traceQUEUE_SEND_FAILED(pxQueue)       trace_record(TRACE_QUEUE_SEND_FAILED, trace_object_id(pxQueue))
+#define traceQUEUE_RECEIVE(pxQueue)           trace_record(TRACE_QUEUE_RECEIVE, trace_object_id(pxQueue))
+#define traceQUEUE_RECEIVE_FAILED(pxQueue)    trace_record(TRACE_QUEUE_RECEIVE_FAILED, trace_object_id(pxQueue))
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)     do { trace_record(TRACE_QUEUE_SEND_FROM_ISR, trace_object_id(pxQueue)); \
+                                                   queue_stats_sent((pxQueue)->uxQueueNumber, (pxQueue)->uxMessagesWaiting + 1); } while (0)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)  trace_record(TRACE_QUEUE_RECEIVE_FROM_ISR, trace_object_id(pxQueue))
+#define traceTASK_NOTIFY()                    trace_record(TRACE_TASK_NOTIFY, pxTCB->uxTCBNumber)
+#define traceTASK_NOTIFY_FROM_ISR()           trace_record(TRACE_TASK_NOTIFY_FROM_ISR, pxTCB->uxTCBNumber)
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,118 @@
+/**
+ * @file blackbox.h
+ * @brief Black box recorder. Every pedals task iteration and a summary of every received CAN frame go into a ring in RAM, which is frozen and saved to a reserved flash sector when the car faults, so the seconds leading up to it survive a power cycle. Decode a dump with scripts/blackbox_decode.py.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include "can.h"
+#include "cmsis_os.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BLACKBOX_SAMPLES    512 /* Pedals task iterations, 5 s at PEDALS_SAMPLE_DELAY */
+#define BLACKBOX_CAN_FRAMES 128
+
+/* Sector 3, kept out of the program by STM32F405RGTx_FLASH.ld */
+#define BLACKBOX_ADDR	0x0800C000
+#define BLACKBOX_LEN	0x4000 /* Bytes */
+#define BLACKBOX_MAGIC	0x31584242 /* "BBX1" */
+#define BLACKBOX_VERSION 2
+
+#define BLACKBOX_BSPD_PREFAULT (1U << 0)
+#define BLACKBOX_BRAKE	       (1U << 1)
+
+/* One pedals task iteration */
+typedef struct {
+	uint32_t time; /* Bus time, us, see timebase.h */
+	uint16_t adc[4]; /* Raw accel 2, accel 1, brake 1, brake 2 */
+	uint8_t accel1; /* Normalized accel 1, % */
+	uint8_t accel2; /* Normalized accel 2, % */
+	uint8_t accel; /* Combined accel, % */
+	uint8_t func_state; /* func_state_t */
+	uint16_t brake; /* Combined raw brake */
+	int16_t torque; /* Torque target, Nm */
+	int16_t current; /* AC current command, multiplied by 10 */
+	uint8_t flags; /* BLACKBOX_BSPD_PREFAULT, BLACKBOX_BRAKE */
+	uint8_t reserved;
+	float mph;
+} blackbox_sample_t;
+
+/* One received CAN frame */
+typedef struct {
+	uint32_t time; /* Bus time, us */
+	uint16_t id;
+	uint8_t len;
+	uint8_t reserved;
+	uint8_t data[4]; /* The first four bytes */
+} blackbox_can_t;
+
+/*
+ * A saved dump is this header, then BLACKBOX_SAMPLES samples, then
+ * BLACKBOX_CAN_FRAMES frames, little endian. Each ring is oldest first from
+ * its next index once it has wrapped. The header is written last, so a dump
+ * cut short by a power cycle has no magic and is ignored.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_samples; /* Recorded, at most BLACKBOX_SAMPLES */
+	uint32_t next_sample; /* Where the next sample would have gone */
+	uint32_t num_can; /* Recorded, at most BLACKBOX_CAN_FRAMES */
+	uint32_t next_can; /* Where the next frame would have gone */
+	uint32_t fault; /* fault_code_t that froze the recorder, 0 if saved by hand */
+	uint32_t time; /* Bus time it was frozen at, us */
+} blackbox_header_t;
+
+_Static_assert(sizeof(blackbox_sample_t) == 28, "Keep samples packed");
+_Static_assert(sizeof(blackbox_can_t) == 12, "Keep frames packed");
+_Static_assert(sizeof(blackbox_header_t) +
+			       BLACKBOX_SAMPLES * sizeof(blackbox_sample_t) +
+			       BLACKBOX_CAN_FRAMES * sizeof(blackbox_can_t) <=
+		       BLACKBOX_LEN,
+	       "The black box must fit its flash sector");
+
+/**
+ * @brief Record a pedals task iteration. Only call from the pedals task. Just a copy into the ring, does nothing while frozen.
+ */
+void blackbox_record(const blackbox_sample_t *sample);
+
+/**
+ * @brief Record a received CAN frame. Only call from the CAN receive task.
+ */
+void blackbox_record_can(const can_msg_t *msg);
+
+/**
+ * @brief Stop recording and save the rings to flash in the background. Recording starts again once they are saved. Nothing is saved if flash already holds a dump, so the first fault is kept until it is cleared. A save by hand is also dropped while the car is active if the sector has to be erased first, since erasing stalls the CPU.
+ *
+ * @param fault The fault that froze the recorder, 0 if saved by hand
+ */
+void blackbox_freeze(uint32_t fault);
+
+/**
+ * @brief Get the dump saved in flash.
+ *
+ * @return const blackbox_header_t* The dump's header, or NULL if there is no dump
+ */
+const blackbox_header_t *blackbox_saved(void);
+
+/**
+ * @brief Erase the saved dump so the next fault can be saved. Erasing stalls the CPU, so it is refused while the car is active or a dump is waiting to be saved or being saved.
+ *
+ * @return int 0 on success, -1 if refused, -2 if the flash could not be erased
+ */
+int blackbox_clear(void);
+
+/**
+ * @brief Task that saves the rings to flash after a freeze.
+ */
+void vBlackbox(void *pv_params);
+extern osThreadId_t blackbox_handle;
+extern const osThreadAttr_t blackbox_attributes;
+
+#endif
@@ -17,6 +17,20 @@
 #include "can.h"
 #include "cmsis_os.h"
 #include "dti.h"
+#include <stdbool.h>
+
+#define CAN_MSG_QUEUE_SIZE 50 /* messages */
+
+typedef struct {
+	uint32_t rx_frames;
+	uint32_t rx_dropped; /* Inbound queue was full */
+	uint32_t tx_frames;
+	uint32_t tx_dropped; /* Outbound queue was full */
+	uint32_t tx_errors; /* Rejected by the CAN peripheral */
+	uint8_t tx_error_count; /* Transmit error counter of the CAN peripheral */
+	uint8_t rx_error_count; /* Receive error counter of the CAN peripheral */
+	bool bus_off;
+} can_stats_t;
 
 /**
  * @brief Callback to be called when a message is received on CAN line 1.
@@ -33,6 +47,18 @@ void can1_callback(CAN_HandleTypeDef *hcan);
  */
 int8_t queue_can_msg(can_msg_t msg);
 
+/**
+ * @brief Get how many more messages fit in the outbound queue. Lets bulk senders leave room for control traffic.
+ */
+uint32_t can_outbound_space(void);
+
+/**
+ * @brief Get the frame counters for CAN line 1, and the state of its error counters.
+ * 
+ * @param out Pointer to the struct the stats will be copied to.
+ */
+void can_get_stats(can_stats_t *out);
+
 /**
  * @brief Initialize CAN line 1.
  * 
@@ -0,0 +1,31 @@
+/**
+ * @file ccmram.h
+ * @brief Placement of variables in the 64 KB core coupled memory.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef CCMRAM_H
+#define CCMRAM_H
+
+/*
+ * CCM RAM is zero wait state and only connected to the CPU, so the control path
+ * never contends with DMA for it on the bus matrix. DMA can't reach it either:
+ * never place a buffer in it that is handed to a DMA transfer, and keep that
+ * in mind for task stacks.
+ *
+ * The name is only used to give the variable its own section, so it shows up
+ * in the map file and in scripts/ram_report.py. Use the variable's name.
+ *
+ *     static uint32_t pedals_stack[256] CCM_BSS(pedals_stack);
+ */
+
+/* Zeroed at startup, like .bss */
+#define CCM_BSS(name) __attribute__((section(".ccmbss." #name)))
+
+/* Copied from flash at startup, like .data */
+#define CCM_DATA(name) __attribute__((section(".ccmram." #name)))
+
+#endif
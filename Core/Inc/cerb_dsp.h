@@ -0,0 +1,122 @@
+/**
+ * @file cerb_dsp.h
+ * @brief Fixed point signal processing kernels for sensor filtering. Uses the Cortex-M4 SIMD instructions when they are available and plain C otherwise, so the same code can be unit tested on the host.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef CERB_DSP_H
+#define CERB_DSP_H
+
+#include <stdint.h>
+
+/* FIR filter on Q15 samples */
+typedef struct {
+	const int16_t *coeffs; /* Q15, coeffs[0] is applied to the newest sample */
+	int16_t *state; /* 2 * num_taps samples, so the window is never split */
+	uint16_t num_taps; /* Must be even */
+	uint16_t index;
+} dsp_fir_t;
+
+/* Direct form 1 biquad on Q15 samples */
+typedef struct {
+	int16_t b[3]; /* Q14 */
+	int16_t neg_a[2]; /* Q14, stored negated so every term is accumulated */
+	int16_t x[2]; /* x[n-1], x[n-2] */
+	int16_t y[2]; /* y[n-1], y[n-2] */
+} dsp_biquad_t;
+
+/* Calibration for normalizing a pair of 12 bit sensors to 0-100 */
+typedef struct {
+	int16_t offset[2];
+	uint16_t gain[2]; /* Q16 percent per count */
+} dsp_norm_dual_t;
+
+typedef struct {
+	int16_t min;
+	int16_t max;
+	int16_t mean;
+	uint32_t variance; /* counts squared */
+} dsp_stats_t;
+
+/**
+ * @brief Initialize a FIR filter.
+ *
+ * @param fir Pointer to the filter
+ * @param coeffs Q15 filter coefficients, newest sample first. Must stay valid for the life of the filter.
+ * @param state Buffer of 2 * num_taps samples to hold the filter history
+ * @param num_taps Number of coefficients, must be even
+ */
+void dsp_fir_init(dsp_fir_t *fir, const int16_t *coeffs, int16_t *state,
+		  uint16_t num_taps);
+
+/**
+ * @brief Push a sample through a FIR filter.
+ *
+ * @param fir Pointer to the filter
+ * @param sample The new sample
+ * @return int16_t The filtered sample, saturated to 16 bits
+ */
+int16_t dsp_fir(dsp_fir_t *fir, int16_t sample);
+
+/**
+ * @brief Push a block of samples through a FIR filter.
+ *
+ * @param fir Pointer to the filter
+ * @param in Samples to filter
+ * @param out Buffer the filtered samples will be written to, may be the same as in
+ * @param len Number of samples
+ */
+void dsp_fir_block(dsp_fir_t *fir, const int16_t *in, int16_t *out,
+		   uint16_t len);
+
+/**
+ * @brief Initialize a biquad filter.
+ *
+ * @param biquad Pointer to the filter
+ * @param coeffs Q14 coefficients in the order b0, b1, b2, a1, a2, where y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+ */
+void dsp_biquad_init(dsp_biquad_t *biquad, const int16_t coeffs[5]);
+
+/**
+ * @brief Push a sample through a biquad filter.
+ *
+ * @param biquad Pointer to the filter
+ * @param sample The new sample
+ * @return int16_t The filtered sample, saturated to 16 bits
+ */
+int16_t dsp_biquad(dsp_biquad_t *biquad, int16_t sample);
+
+/**
+ * @brief Calculate the calibration for a pair of sensors read by dsp_norm_dual().
+ *
+ * @param norm Pointer to the calibration
+ * @param offset Reading of each sensor at 0%
+ * @param max Reading of each sensor at 100%, must be more than 100 counts above the offset
+ */
+void dsp_norm_dual_init(dsp_norm_dual_t *norm, const int16_t offset[2],
+			const int16_t max[2]);
+
+/**
+ * @brief Normalize a pair of 12 bit sensor readings to 0-100. Readings below the offset are clamped to 0. Agrees with integer division to within 1.
+ *
+ * @param norm Pointer to the calibration
+ * @param raw_a Reading of the first sensor
+ * @param raw_b Reading of the second sensor
+ * @param out Buffer the two normalized readings will be written to
+ */
+void dsp_norm_dual(const dsp_norm_dual_t *norm, uint16_t raw_a, uint16_t raw_b,
+		   uint16_t out[2]);
+
+/**
+ * @brief Calculate the minimum, maximum, mean and population variance of a block of samples.
+ *
+ * @param buf Samples
+ * @param len Number of samples
+ * @param stats Pointer to the struct the statistics will be written to
+ */
+void dsp_stats(const int16_t *buf, uint16_t len, dsp_stats_t *stats);
+
+#endif
@@ -0,0 +1,46 @@
+/**
+ * @file cerb_math.h
+ * @brief Single precision math helpers. The FPU on the M4 only handles floats, so any double in an expression is emulated in software.
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026
+ * 
+ */
+
+#ifndef CERB_MATH_H
+#define CERB_MATH_H
+
+#include <math.h>
+#include <stdbool.h>
+
+#define PI_F		  3.14159265f
+#define INCHES_PER_MILE_F 63360.0f
+#define MPH_TO_KMH_F	  1.609f
+
+/**
+ * @brief Clamp a value to a range.
+ * 
+ * @param val Value to clamp.
+ * @param min Lower bound of the range.
+ * @param max Upper bound of the range.
+ * @return float The clamped value.
+ */
+static inline float clampf(float val, float min, float max)
+{
+	return val < min ? min : (val > max ? max : val);
+}
+
+/**
+ * @brief Check if two values are within a tolerance of each other.
+ * 
+ * @param a First value.
+ * @param b Second value.
+ * @param tol Tolerance.
+ * @return bool True if |a - b| < tol.
+ */
+static inline bool nearf(float a, float b, float tol)
+{
+	return fabsf(a - b) < tol;
+}
+
+#endif
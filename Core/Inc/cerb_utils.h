@@ -14,6 +14,7 @@
 #include "cmsis_os.h"
 #include "stdbool.h"
 #include "timer.h"
+#include <stddef.h>
 
 /**
  * @brief Function to debounce a signal. Debounce is started and maintained by a high signal, and it is interrupted by a low signal. The callback is called in a thread context.
@@ -28,14 +29,12 @@ void debounce(bool input, nertimer_t *timer, uint32_t period,
 	      void (*cb)(void *arg), void *arg);
 
 /**
- * @brief Queue a message and set a thread noticication flag. The message is queued with a timeout of 0.
+ * @brief Format a float to three decimal places. The C library is linked with nano.specs, which leaves out %f, so this formats the whole and thousandths parts as integers instead.
  * 
- * @param queue Queue to put message in.
- * @param msg_ptr Pointer to message to put in queue.
- * @param thread_id ID of thread that is being notified.
- * @param flags Flag to set in thread's notification array.
- * @return osStatus_t The error code of queueing the message.
+ * @param buf Buffer to write to.
+ * @param len Length of the buffer.
+ * @param value Value to format. Magnitudes too large for the whole part to fit in 32 bits are written as inf.
+ * @return int What snprintf returns.
  */
-osStatus_t queue_and_set_flag(osMessageQueueId_t queue, const void *msg_ptr,
-			      osThreadId_t thread_id, uint32_t flags);
+int format_float(char *buf, size_t len, float value);
 #endif
@@ -20,6 +20,8 @@
 #define STATE_MACHINE_DELAY
 #define TORQUE_CALC_DELAY
 #define FAULT_HANDLE_DELAY
+#define RTOS_STATS_DELAY 1000 /* ms */
+#define SUPERVISOR_DELAY 50 /* ms */
 
 /* Pedal tuning */
 #define PEDALS_SAMPLE_DELAY 10 /* ms */
@@ -28,13 +30,23 @@
 #define ACCEL2_OFFSET	    1780
 #define ACCEL2_MAX_VAL	    3365
 #define PEDAL_BRAKE_THRESH  650
+#define PEDAL_DIFF_THRESH   30 /* % */
+
+/* Accel pedal ADC window, enforced by the ADC3 analog watchdog */
+#define PEDAL_OPEN_CIRCUIT_THRESH  4076 /* 20 counts below full scale */
+#define PEDAL_SHORT_CIRCUIT_THRESH 500
+
+/* LV sense calibration defaults, oversampled ADC counts to LV monitor CAN units */
+#define LV_SENSE_GAIN_Q16 734577 /* 8.967 * 10 / 8 in Q16.16 */
+#define LV_SENSE_OFFSET	  0
 
 /* Torque Tuning */
-#define MAX_TORQUE 220 /* Nm */
+#define MAX_TORQUE    220 /* Nm */
+#define PIT_MAX_SPEED 5.0f /* mph */
 
 /* Endurance Mode Thresholds */
-#define REGEN_THRESHOLD	       0.01
-#define ACCELERATION_THRESHOLD 0.05
+#define REGEN_THRESHOLD	       0.01f
+#define ACCELERATION_THRESHOLD 0.05f
 
 /* Maximum AC braking current */
 #define MAX_REGEN_CURRENT 20
@@ -75,5 +87,15 @@
 #define CANID_LV_MONITOR       0x503
 #define CANID_PEDALS_ACCEL_MSG 0x504
 #define CANID_PEDALS_BRAKE_MSG 0x505
+#define CANID_RTOS_STATS       0x508
+#define CANID_TRACE_REQUEST    0x509
+#define CANID_TRACE_DUMP       0x50A
+#define CANID_PROBE_REQUEST    0x50B
+#define CANID_PROBE_DUMP       0x50C
+#define CANID_XCP_CRO	       0x50D
+#define CANID_XCP_DTO	       0x50E
+#define CANID_PARAM_REQUEST    0x50F
+#define CANID_PARAM_RESPONSE   0x510
+#define CANID_TIME_SYNC	       0x511
 // Reserved for MPU debug message, see yaml for format
 #define CANID_EXTRA_MSG 0x701
\ No newline at end of file
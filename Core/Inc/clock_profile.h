@@ -0,0 +1,101 @@
+/**
+ * @file clock_profile.h
+ * @brief Selectable system clock profiles and the peripheral timings derived from them.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef CLOCK_PROFILE_H
+#define CLOCK_PROFILE_H
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+
+#define CLOCK_PROFILE_HSI_16  0 /* No PLL, the reset clock */
+#define CLOCK_PROFILE_HSI_168 1
+#define CLOCK_PROFILE_HSE_168 2
+
+/* Select with make CLOCK_PROFILE=... */
+#ifndef CLOCK_PROFILE
+#define CLOCK_PROFILE CLOCK_PROFILE_HSI_168
+#endif
+
+/* Rates every profile has to hit */
+#define CLOCK_CAN_BITRATE 500000 /* bit/s */
+#define CLOCK_LV_TIM_HZ	  1000000 /* TIM3 counter, paces the LV ADC */
+#define CLOCK_TIMEBASE_HZ 1000000 /* TIM2 counter, the microsecond timebase */
+
+/*
+ * Each profile provides:
+ *  - oscillator and PLL settings, bus dividers and flash wait states
+ *  - the resulting HCLK, PCLK1 and PCLK2 so the startup check can compare against them
+ *  - CAN prescaler and bit segments for CLOCK_CAN_BITRATE from PCLK1
+ *  - ADC prescaler (ADCCLK <= 36 MHz) and the sample time that keeps the pedal sampling window near 1 us
+ *
+ * I2C and UART need nothing here, the HAL derives their dividers from PCLK1 at init.
+ * The ART prefetch and caches are turned on by HAL_Init() (see stm32f4xx_hal_conf.h).
+ */
+#if CLOCK_PROFILE == CLOCK_PROFILE_HSI_16
+
+#define CLOCK_HCLK_HZ	       16000000
+#define CLOCK_PCLK1_HZ	       16000000
+#define CLOCK_PCLK2_HZ	       16000000
+#define CLOCK_FLASH_LATENCY    FLASH_LATENCY_0
+#define CLOCK_APB1_DIV	       RCC_HCLK_DIV1
+#define CLOCK_APB2_DIV	       RCC_HCLK_DIV1
+#define CLOCK_CAN_PRESCALER    2
+#define CLOCK_CAN_BS1	       CAN_BS1_13TQ
+#define CLOCK_CAN_BS2	       CAN_BS2_2TQ
+#define CLOCK_ADC_PRESCALER    ADC_CLOCK_SYNC_PCLK_DIV6 /* 2.67 MHz */
+#define CLOCK_PEDAL_SAMPLETIME ADC_SAMPLETIME_3CYCLES
+
+#elif CLOCK_PROFILE == CLOCK_PROFILE_HSI_168 || \
+	CLOCK_PROFILE == CLOCK_PROFILE_HSE_168
+
+#if CLOCK_PROFILE == CLOCK_PROFILE_HSI_168
+#define CLOCK_PLL_SOURCE RCC_PLLSOURCE_HSI
+#define CLOCK_PLL_M	 (HSI_VALUE / 2000000) /* 2 MHz VCO input */
+#define CLOCK_PLL_N	 168
+#else
+/* MPU only brings out OSC_IN, so the external clock is driven in bypass mode */
+#define CLOCK_HSE_STATE	 RCC_HSE_BYPASS
+#define CLOCK_PLL_SOURCE RCC_PLLSOURCE_HSE
+#define CLOCK_PLL_M	 (HSE_VALUE / 1000000) /* 1 MHz VCO input */
+#define CLOCK_PLL_N	 336
+#endif
+#define CLOCK_PLL_P RCC_PLLP_DIV2 /* 336 MHz VCO / 2 */
+#define CLOCK_PLL_Q 7 /* 48 MHz for USB */
+
+#define CLOCK_HCLK_HZ	       168000000
+#define CLOCK_PCLK1_HZ	       42000000
+#define CLOCK_PCLK2_HZ	       84000000
+#define CLOCK_FLASH_LATENCY    FLASH_LATENCY_5 /* 2.7 - 3.6 V, 150 - 168 MHz */
+#define CLOCK_APB1_DIV	       RCC_HCLK_DIV4
+#define CLOCK_APB2_DIV	       RCC_HCLK_DIV2
+#define CLOCK_CAN_PRESCALER    6 /* 14 tq, sampled at 85.7% */
+#define CLOCK_CAN_BS1	       CAN_BS1_11TQ
+#define CLOCK_CAN_BS2	       CAN_BS2_2TQ
+#define CLOCK_ADC_PRESCALER    ADC_CLOCK_SYNC_PCLK_DIV4 /* 21 MHz */
+#define CLOCK_PEDAL_SAMPLETIME ADC_SAMPLETIME_28CYCLES
+
+#else
+#error "Unknown CLOCK_PROFILE"
+#endif
+
+/* Timers on a divided APB run at twice the bus clock */
+#define CLOCK_APB1_TIM_HZ \
+	(CLOCK_APB1_DIV == RCC_HCLK_DIV1 ? CLOCK_PCLK1_HZ : 2 * CLOCK_PCLK1_HZ)
+#define CLOCK_APB2_TIM_HZ \
+	(CLOCK_APB2_DIV == RCC_HCLK_DIV1 ? CLOCK_PCLK2_HZ : 2 * CLOCK_PCLK2_HZ)
+
+/**
+ * @brief Check that the clock tree, flash and CAN timing came out the way the selected profile says they should.
+ *
+ * @param hcan Pointer to the initialized CAN handle
+ * @return int8_t 0 if everything matches, otherwise the number of mismatches
+ */
+int8_t clock_profile_check(CAN_HandleTypeDef *hcan);
+
+#endif
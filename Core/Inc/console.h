@@ -0,0 +1,30 @@
+/**
+ * @file console.h
+ * @brief Command console on the serial port, for looking into and tuning the car while it runs.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "cmsis_os.h"
+
+/*
+ * Lines typed into the serial port are echoed back and run as a command when
+ * enter is pressed. Backspace deletes a character and Ctrl-C throws the line
+ * away. Type "help" for the list of commands.
+ *
+ * The console runs below every other task, so using it never delays the car.
+ */
+
+/**
+ * @brief Task that edits lines received on the serial port and runs them.
+ */
+void vConsole(void *pv_params);
+extern osThreadId_t console_handle;
+extern const osThreadAttr_t console_attributes;
+
+#endif
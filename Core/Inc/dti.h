@@ -27,7 +27,7 @@
 	0x496 /* Throttle signal, Brake signal, IO, Drive enable */
 
 #define TIRE_DIAMETER 16 /* inches */
-#define GEAR_RATIO    47 / 13.0 /* unitless */
+#define GEAR_RATIO    (47 / 13.0f) /* unitless */
 #define POLE_PAIRS    10 /* unitless */
 
 typedef struct {
@@ -42,7 +42,6 @@ typedef struct {
 	int8_t throttle_signal; /* SCALE: 1         UNITS: Percentage             */
 	int8_t brake_signal; /* SCALE: 1         UNITS: Percentage             */
 	int8_t drive_enable; /* SCALE: 1         UNITS: No units just a number */
-	osMutexId_t *mutex;
 } dti_t;
 
 /**
@@ -91,6 +90,14 @@ uint16_t dti_get_input_voltage(dti_t *dti);
  */
 void dti_set_torque(int16_t torque);
 
+/**
+ * @brief Get the last torque target passed to dti_set_torque() and the AC current command it became.
+ * 
+ * @param torque Torque target, Nm
+ * @param current AC current command, multiplied by 10
+ */
+void dti_get_command(int16_t *torque, int16_t *current);
+
 /**
  * @brief Set the brake AC current target for regenerative braking. Only positive values are accepted by the DTI.
  * 
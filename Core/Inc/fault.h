@@ -3,6 +3,7 @@
 
 #include "cerberus_conf.h"
 #include "cmsis_os.h"
+#include <stdbool.h>
 
 typedef enum { DEFCON1 = 1, DEFCON2, DEFCON3, DEFCON4, DEFCON5 } fault_sev_t;
 
@@ -20,27 +21,83 @@ typedef enum {
 	STATE_RECEIVED_FAULT = 0x200,
 	INVALID_TRANSITION_FAULT = 0x400,
 	BMS_CAN_MONITOR_FAULT = 0x800,
-	BUTTONS_MONITOR_FAULT = 0xF00,
 	BSPD_PREFAULT = 0x1000,
 	LV_MONITOR_FAULT = 0x2000,
 	RTDS_FAULT = 0x4000,
+	DEADLINE_MISS_FAULT = 0x8000,
+	BUTTONS_MONITOR_FAULT = 0x10000,
 	MAX_FAULTS
 } fault_code_t;
 
+#define NUM_FAULTS 17 /* Bits used by fault_code_t */
+
 typedef struct {
 	fault_code_t id;
 	fault_sev_t severity;
 	char *diag;
 } fault_data_t;
 
+/*
+ * A fault is active from when it is first raised until it has not been
+ * raised for FAULT_CLEAR_TIME. Raising an active fault again only counts it,
+ * unless it is raised at a higher severity.
+ *
+ * The status of every fault is sent in one CANID_FAULT_MSG frame whenever it
+ * changes, and every FAULT_STATUS_PERIOD otherwise:
+ *   [0:3]  Mask of active fault_code_t, big endian
+ *   [4]    Highest severity of any active fault, 0 if none are active
+ */
+#define FAULT_CLEAR_TIME    1000 /* ms */
+#define FAULT_STATUS_PERIOD 1000 /* ms */
+
+typedef struct {
+	uint32_t count; /* Times raised since boot */
+	uint32_t first; /* Bus time of the first raise, us, see timebase.h */
+	uint32_t last; /* Bus time of the latest raise, us */
+	/* The same on the local timebase, which time sync never moves, for timing how long ago */
+	uint32_t first_local; /* us */
+	uint32_t last_local; /* us */
+	uint8_t severity; /* fault_sev_t while active, 0 otherwise */
+} fault_stats_t;
+
 /**
- * @brief Put a fault in the fault queue.
+ * @brief Raise a fault. Safe to call from a task or an interrupt, and cheap to call repeatedly while the fault condition holds.
  * 
  * @param fault_data Pointer to struct containing data about the fault
- * @return osStatus_t Error code of osMessageQueuePut operation
+ * @return osStatus_t osOK, osErrorParameter if the fault is not valid, or osErrorResource if the queue is full
  */
 osStatus_t queue_fault(fault_data_t *fault_data);
 
+/**
+ * @brief Get the mask of active faults.
+ */
+uint32_t fault_active(void);
+
+/**
+ * @brief Check whether any active fault is severe enough to fault the car. The car must not leave FAULTED while one is.
+ */
+bool fault_car_active(void);
+
+/**
+ * @brief Get the counters of a fault.
+ *
+ * @param bit Bit of the fault in fault_code_t, less than NUM_FAULTS
+ * @param stats Pointer to the struct the counters will be copied to
+ */
+void fault_get_stats(uint32_t bit, fault_stats_t *stats);
+
+/**
+ * @brief Get the name of a fault.
+ *
+ * @param bit Bit of the fault in fault_code_t, less than NUM_FAULTS
+ */
+const char *fault_name(uint32_t bit);
+
+/**
+ * @brief Create the fault queue. Must be called before the scheduler is started, faults can be queued from interrupts as soon as it is running.
+ */
+void fault_init();
+
 /**
  * @brief Task for processing faults.
  * 
@@ -0,0 +1,55 @@
+/**
+ * @file flash.h
+ * @brief Erasing and programming the internal flash, shared by everything that keeps data in a reserved sector.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The CPU stalls while the flash is busy, since code runs from it. Erasing a
+ * 16 KB sector takes a few hundred ms, so only erase while the car is not
+ * active. Programming a word stalls for around 16 us.
+ */
+
+#define FLASH_ERASED_WORD 0xFFFFFFFF
+
+/**
+ * @brief Create the lock that keeps flash operations from different tasks apart. Must be called before the scheduler is started.
+ */
+void flash_init(void);
+
+/**
+ * @brief Erase a sector.
+ *
+ * @param sector The sector, FLASH_SECTOR_x
+ * @return int 0 on success, -1 on error
+ */
+int flash_erase(uint32_t sector);
+
+/**
+ * @brief Program words into erased flash and check they read back.
+ *
+ * @param addr Address to program, word aligned
+ * @param data The words
+ * @param len Number of bytes, a multiple of 4
+ * @return int 0 on success, -1 on error
+ */
+int flash_program(uint32_t addr, const void *data, uint32_t len);
+
+/**
+ * @brief Check that a range of flash is erased.
+ *
+ * @param addr Start of the range, word aligned
+ * @param len Number of bytes, a multiple of 4
+ */
+bool flash_erased(uint32_t addr, uint32_t len);
+
+#endif
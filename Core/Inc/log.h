@@ -0,0 +1,110 @@
+/**
+ * @file log.h
+ * @brief Deferred logging. LOG() takes a printf format and arguments like serial_print(), but the format string never leaves the host: the target sends a binary record of the string's id, a timestamp and the raw argument words, and scripts/log_decode.py rebuilds the text from the ELF. Build with `make LOG_TEXT=1` to format on the target instead.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define LOG_MAX_ARGS 6
+
+/*
+ * Records are sent in line with the text on the serial console. Each one is
+ * LOG_RECORD_START, the COBS encoding of
+ *
+ *   [0:1]  format string id, its offset in the .log_fmt section
+ *   [2:5]  bus time, us, see timebase.h
+ *   [6:]   one 32 bit word per argument
+ *
+ * and a 0 byte. Multi byte values are little endian. Neither marker ever
+ * appears in text, so the decoder passes everything else through as it is.
+ *
+ * Integer, character and float arguments are sent as their value, doubles
+ * are narrowed to floats. A %s argument is sent as the string's address, so
+ * it only decodes if the string is in flash, like a literal.
+ */
+#define LOG_RECORD_START 0x1E
+
+#ifdef LOG_TEXT
+
+#include "serial_monitor.h"
+
+#define LOG(...) serial_print(__VA_ARGS__)
+
+#else
+
+/**
+ * @brief Send a log record. Use LOG() rather than calling this directly.
+ *
+ * @param id Format string id
+ * @param args Argument words
+ * @param num_args Number of argument words, at most LOG_MAX_ARGS
+ * @return int 0 on success, -1 if the record was dropped
+ */
+int log_write(uint16_t id, const uint32_t *args, uint32_t num_args);
+
+static inline uint32_t log_int_word(uint32_t value)
+{
+	return value;
+}
+
+static inline uint32_t log_float_word(float value)
+{
+	uint32_t word;
+	memcpy(&word, &value, sizeof(word));
+	return word;
+}
+
+static inline uint32_t log_double_word(double value)
+{
+	return log_float_word((float)value);
+}
+
+static inline uint32_t log_string_word(const char *value)
+{
+	return (uintptr_t)value;
+}
+
+#define LOG_WORD(x)                                    \
+	_Generic((x),                                  \
+		float: log_float_word,                 \
+		double: log_double_word,               \
+		char *: log_string_word,               \
+		const char *: log_string_word,         \
+		default: log_int_word)(x)
+
+#define LOG_NUM_ARGS(...) LOG_NUM_ARGS_(, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NUM_ARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+
+#define LOG_CAT(a, b)  LOG_CAT_(a, b)
+#define LOG_CAT_(a, b) a##b
+
+#define LOG_WORDS_0()
+#define LOG_WORDS_1(a)		     LOG_WORD(a),
+#define LOG_WORDS_2(a, b)	     LOG_WORDS_1(a) LOG_WORD(b),
+#define LOG_WORDS_3(a, b, c)	     LOG_WORDS_2(a, b) LOG_WORD(c),
+#define LOG_WORDS_4(a, b, c, d)	     LOG_WORDS_3(a, b, c) LOG_WORD(d),
+#define LOG_WORDS_5(a, b, c, d, e)    LOG_WORDS_4(a, b, c, d) LOG_WORD(e),
+#define LOG_WORDS_6(a, b, c, d, e, f) LOG_WORDS_5(a, b, c, d, e) LOG_WORD(f),
+
+/* The format string goes in a section that is kept in the ELF but never loaded, its offset there is its id */
+#define LOG(fmt, ...)                                                        \
+	({                                                                   \
+		static const char log_fmt[]                                  \
+			__attribute__((section(".log_fmt"), used)) = fmt;    \
+		const uint32_t log_args[] = { LOG_CAT(                       \
+			LOG_WORDS_, LOG_NUM_ARGS(__VA_ARGS__))(__VA_ARGS__) 0 }; \
+		log_write((uintptr_t)log_fmt, log_args,                      \
+			  LOG_NUM_ARGS(__VA_ARGS__));                        \
+	})
+
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * @file mailbox.h
+ * @brief Fixed size message passing between tasks and from interrupts, one kernel call to send and one to receive.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * A mailbox is a statically allocated kernel queue. Senders never block, and
+ * the receiver blocks on the mailbox itself, so a message costs one kernel
+ * call on each side and wakes the receiver once. Any number of tasks and
+ * interrupts can send, one task receives.
+ *
+ *     static mailbox_t fault_mailbox;
+ *     static uint8_t fault_mailbox_buf[MAILBOX_BUF_SIZE(16, fault_data_t)];
+ *
+ *     mailbox_init(&fault_mailbox, "FaultQueue", fault_mailbox_buf, 16, sizeof(fault_data_t));
+ */
+typedef struct {
+	QueueHandle_t queue; /* NULL until initialized */
+	StaticQueue_t cb;
+} mailbox_t;
+
+#define MAILBOX_BUF_SIZE(len, type) ((len) * sizeof(type))
+
+/**
+ * @brief Create a mailbox. Must be called before the scheduler is started.
+ *
+ * @param mailbox The mailbox
+ * @param name Name shown in the queue stats and kernel aware debuggers
+ * @param buf Storage for the messages, MAILBOX_BUF_SIZE(len, type) bytes
+ * @param len Number of messages the mailbox holds
+ * @param msg_size Size of each message
+ */
+void mailbox_init(mailbox_t *mailbox, const char *name, uint8_t *buf,
+		  uint32_t len, uint32_t msg_size);
+
+/**
+ * @brief Send a message without blocking. Safe to call from a task or an interrupt.
+ *
+ * @return int 0 on success, -1 if the mailbox is full or not yet created
+ */
+int mailbox_post(mailbox_t *mailbox, const void *msg);
+
+/**
+ * @brief Send a message without blocking, from an interrupt only. Skips working out the calling context.
+ *
+ * @return int 0 on success, -1 if the mailbox is full or not yet created
+ */
+int mailbox_post_from_isr(mailbox_t *mailbox, const void *msg);
+
+/**
+ * @brief Get how many more messages fit in a mailbox.
+ */
+uint32_t mailbox_space(mailbox_t *mailbox);
+
+/**
+ * @brief Receive a message, blocking until one arrives. Only one task may receive from a mailbox.
+ *
+ * @param mailbox The mailbox
+ * @param msg Where the message is copied to
+ * @param timeout Ticks to wait, 0 to poll or osWaitForever
+ * @return bool True if a message was received, false on timeout
+ */
+bool mailbox_wait(mailbox_t *mailbox, void *msg, uint32_t timeout);
+
+#endif
@@ -36,7 +36,7 @@ typedef struct {
 } data_collection_args_t;
 
 /**
- * @brief Task for collecting functional data from the car. Includes TSMS and steering wheel button monitoring.
+ * @brief Task for collecting functional data from the car. Includes TSMS monitoring and polling of steering wheel inputs without their own EXTI line.
  * 
  * @param pv_params Pointer to data_collection_args_t
  */
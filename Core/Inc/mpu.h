@@ -8,13 +8,19 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/* Extra bits of LV sense resolution gained by oversampling, costs 4 samples per bit */
+#define LV_OVERSAMPLE_BITS  3
+#define LV_OVERSAMPLE_COUNT (1 << (2 * LV_OVERSAMPLE_BITS))
+
 typedef struct {
 	I2C_HandleTypeDef *hi2c;
 	ADC_HandleTypeDef *pedals_adc;
 	uint32_t pedal_dma_buf[4];
 
 	ADC_HandleTypeDef *lv_adc;
-	uint32_t lv_dma_buf;
+	/* Paces the LV ADC, which fills the buffer as a ring */
+	TIM_HandleTypeDef *lv_tim;
+	uint32_t lv_dma_buf[LV_OVERSAMPLE_COUNT];
 
 	GPIO_TypeDef *led_gpio;
 	GPIO_TypeDef *watchdog_gpio;
@@ -36,12 +42,14 @@ typedef struct {
  * @param hi2c Pointer to struct representing i2c1
  * @param pedals_adc Pointer to struct representing pedals ADC
  * @param lv_adc Pointer to struct representing LV battery ADC
+ * @param lv_tim Pointer to the timer that triggers LV battery ADC conversions
  * @param led_gpio Pointer to struct represneitng LED GPIO
  * @param watchdog_gpio Pointer to struct represneting watchdog GPIO
  * @return mpu_t* Pointer to struct representing the MPU
  */
 mpu_t *init_mpu(I2C_HandleTypeDef *hi2c, ADC_HandleTypeDef *pedals_adc,
-		ADC_HandleTypeDef *lv_adc, GPIO_TypeDef *led_gpio,
+		ADC_HandleTypeDef *lv_adc, TIM_HandleTypeDef *lv_tim,
+		GPIO_TypeDef *led_gpio,
 		GPIO_TypeDef *watchdog_gpio);
 
 /**
@@ -53,10 +61,10 @@ mpu_t *init_mpu(I2C_HandleTypeDef *hi2c, ADC_HandleTypeDef *pedals_adc,
 void read_pedals(mpu_t *mpu, uint32_t pedal_buf[4]);
 
 /**
- * @brief Read the voltage of the low voltage batteries.
+ * @brief Read the voltage of the low voltage batteries, averaged over the last LV_OVERSAMPLE_COUNT conversions.
  * 
  * @param mpu Pointer to struct representing the MPU.
- * @param lv_buf Pointer to location where raw ADC value will be stored.
+ * @param lv_buf Pointer to location where the oversampled ADC value (12 + LV_OVERSAMPLE_BITS bits) will be stored.
  */
 void read_lv_voltage(mpu_t *mpu, uint32_t *lv_buf);
 
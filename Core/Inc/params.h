@@ -0,0 +1,161 @@
+/**
+ * @file params.h
+ * @brief Control parameters that can be tuned at runtime and saved to flash. Each defaults to its value in cerberus_conf.h, and can only be set within its limits.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include "can.h"
+#include "cerberus_conf.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * X(id, field, type, default, min, max). The type must be float or int32_t,
+ * so every field is written in one store.
+ *
+ * Bump PARAMS_VERSION whenever this table changes, saved parameters from
+ * another version are ignored and the defaults used instead.
+ */
+#define PARAMS_VERSION 2
+
+#define PARAM_TABLE(X)                                                       \
+	X(ACCEL1_OFFSET, accel1_offset, int32_t, ACCEL1_OFFSET, 0,           \
+	  4095) /* ADC counts */                                             \
+	X(ACCEL1_MAX, accel1_max, int32_t, ACCEL1_MAX_VAL, 0,                \
+	  4095) /* ADC counts */                                             \
+	X(ACCEL2_OFFSET, accel2_offset, int32_t, ACCEL2_OFFSET, 0,           \
+	  4095) /* ADC counts */                                             \
+	X(ACCEL2_MAX, accel2_max, int32_t, ACCEL2_MAX_VAL, 0,                \
+	  4095) /* ADC counts */                                             \
+	X(PEDAL_DIFF_THRESH, pedal_diff_thresh, int32_t, PEDAL_DIFF_THRESH,  \
+	  0, 100) /* % */                                                    \
+	X(TORQUE_LIMIT, torque_limit, float, MAX_TORQUE, 0, MAX_TORQUE)      \
+	/* Nm */                                                             \
+	X(REGEN_LIMIT, regen_limit, float, MAX_REGEN_CURRENT, 0,             \
+	  MAX_REGEN_CURRENT) /* A */                                         \
+	X(ACCEL_THRESHOLD, accel_threshold, float, ACCELERATION_THRESHOLD,   \
+	  0.0f, 0.2f) /* Pedal travel, 0-1 */                                \
+	X(REGEN_THRESHOLD, regen_threshold, float, REGEN_THRESHOLD, 0.001f,  \
+	  0.1f) /* Pedal travel, 0-1 */                                      \
+	X(PIT_MAX_SPEED, pit_max_speed, float, PIT_MAX_SPEED, 0.5f,          \
+	  PIT_MAX_SPEED) /* mph */                                           \
+	X(LV_SENSE_GAIN, lv_sense_gain, int32_t, LV_SENSE_GAIN_Q16, 0,       \
+	  1 << 21) /* Q16.16 */                                              \
+	X(LV_SENSE_OFFSET, lv_sense_offset, int32_t, LV_SENSE_OFFSET, -5000, \
+	  5000) /* LV monitor CAN units */
+
+#define PARAM_ID(id, field, type, def, min, max) PARAM_##id,
+typedef enum { PARAM_TABLE(PARAM_ID) NUM_PARAMS } param_id_t;
+
+#define PARAM_FIELD(id, field, type, def, min, max) type field;
+typedef struct {
+	PARAM_TABLE(PARAM_FIELD)
+} params_t;
+
+/*
+ * The parameters the control loop is using. Read fields directly, it costs
+ * the same as reading any global. Only params_apply() writes it.
+ */
+extern params_t params;
+
+/*
+ * Requests are a CANID_PARAM_REQUEST frame:
+ *   [0]    param_request_t
+ *   [1]    Parameter id, for PARAM_GET and PARAM_SET
+ *   [2:5]  Value for PARAM_SET, little endian float
+ *
+ * Each is answered with a CANID_PARAM_RESPONSE frame:
+ *   [0]    The request
+ *   [1]    The parameter id
+ *   [2:5]  The parameter's value, little endian float
+ *   [6]    0 on success, 1 if the request was refused
+ */
+typedef enum {
+	PARAM_GET,
+	PARAM_SET, /* Staged until PARAM_COMMIT */
+	PARAM_COMMIT,
+	PARAM_SAVE, /* Only what has been committed */
+	PARAM_DEFAULTS, /* Stage every default */
+} param_request_t;
+
+/**
+ * @brief Load the parameters last saved to flash, or the defaults if there are none. Must be called before the scheduler is started.
+ */
+void params_init(void);
+
+/**
+ * @brief Switch the control loop to the committed parameters, if any were committed since the last call. Call at the top of every control loop iteration, so each iteration sees one whole set.
+ */
+void params_apply(void);
+
+/**
+ * @brief Get the staged value of a parameter, which is what the control loop uses once it is committed.
+ */
+float param_get(param_id_t id);
+
+/**
+ * @brief Stage a new value for a parameter. It is not used until params_commit() is called, so several can be changed at once.
+ *
+ * @param id The parameter
+ * @param value The new value, which must be whole for integer parameters
+ * @return int 0 on success, -1 if the value is outside the parameter's limits
+ */
+int param_set(param_id_t id, float value);
+
+/**
+ * @brief Stage the default value of every parameter.
+ */
+void params_defaults(void);
+
+/**
+ * @brief Snapshot the staged parameters for the control loop to switch to at its next iteration. Later changes are staged again, and never seen by the control loop until the next commit.
+ */
+void params_commit(void);
+
+/**
+ * @brief Save the committed parameters to flash. Staged changes are not saved until they are committed. Saving can stall the CPU while a flash sector is erased, so it is refused while the car is active.
+ *
+ * @return int 0 on success, -1 if the car is active, -2 if the flash could not be written
+ */
+int params_save(void);
+
+/**
+ * @brief Look up a parameter by name.
+ *
+ * @return int The parameter's id, or -1 if there is no parameter with that name
+ */
+int param_find(const char *name);
+
+/**
+ * @brief Get a parameter's name.
+ */
+const char *param_name(param_id_t id);
+
+/**
+ * @brief Get a parameter's limits.
+ */
+void param_limits(param_id_t id, float *min, float *max);
+
+/**
+ * @brief Check whether memory overlaps any copy of the parameters, which must only be changed through param_set() so their limits hold.
+ *
+ * @param addr Start of the memory
+ * @param len Length of the memory
+ * @return bool True if any byte of it is a parameter
+ */
+bool params_overlaps(const void *addr, uint32_t len);
+
+/**
+ * @brief Handle a parameter request received over CAN.
+ *
+ * @param msg The CANID_PARAM_REQUEST message
+ */
+void handle_param_request(can_msg_t msg);
+
+#endif
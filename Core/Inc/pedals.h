@@ -19,7 +19,6 @@
 
 #define PEDAL_DATA_FLAG 1U
 
-#define PIT_MAX_SPEED	 5.0 /* mph */
 #define ACCUMULATOR_SIZE 10 /* size of the accumulator for averaging */
 
 typedef struct {
@@ -51,6 +50,13 @@ void decrease_torque_limit();
  */
 bool get_brake_state();
 
+/**
+ * @brief Called from the ADC interrupt when an accel pedal reading leaves the window set by the analog watchdog. Starts the pedal fault confirmation window.
+ * 
+ * @param hadc Pointer to the pedal ADC
+ */
+void pedal_watchdog_isr(ADC_HandleTypeDef *hadc);
+
 /**
  * @brief Task for reading pedal data, calculating pedal faults, and sending drive commands to the DTI.
  * 
@@ -0,0 +1,121 @@
+/**
+ * @file probe.h
+ * @brief Execution time probes for hot functions. A probe wraps a region with two reads of the DWT cycle counter and accumulates the count, min, max and total cycles spent in it. Build with `make PROBES=1`, otherwise the probes compile to nothing.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Every probed region, X(name). A region is probed with
+ *
+ *	PROBE_START(name);
+ *	...
+ *	PROBE_END(name);
+ *
+ * in the same scope, and must not return in between.
+ */
+#define PROBE_TABLE(X)            \
+	X(CAN1_CALLBACK)          \
+	X(CALC_PEDAL_FAULTS)      \
+	X(HANDLE_ENDURANCE)       \
+	X(DTI_SET_TORQUE)         \
+	X(STEERINGIO_UPDATE)
+
+#define PROBE_ID(name) PROBE_##name,
+typedef enum { PROBE_TABLE(PROBE_ID) NUM_PROBES } probe_id_t;
+
+#ifdef PROBE_ENABLE
+#include "stm32f4xx.h"
+#include "can.h"
+
+typedef struct {
+	uint32_t count;
+	uint32_t min; /* CPU cycles */
+	uint32_t max; /* CPU cycles */
+	uint64_t total; /* CPU cycles */
+} probe_t;
+
+extern probe_t probes[NUM_PROBES];
+
+/**
+ * @brief Accumulate one pass through a probed region. Safe to call from interrupts.
+ *
+ * @param id The probe
+ * @param cycles CPU cycles spent in the region
+ */
+static inline void probe_record(probe_id_t id, uint32_t cycles)
+{
+	probe_t *probe = &probes[id];
+
+	/* Probes are hit from tasks and interrupts, keep the update whole */
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	probe->count++;
+	probe->total += cycles;
+	if (cycles < probe->min)
+		probe->min = cycles;
+	if (cycles > probe->max)
+		probe->max = cycles;
+	__set_PRIMASK(primask);
+}
+
+#define PROBE_START(name) const uint32_t probe_start_##name = DWT->CYCCNT
+#define PROBE_END(name) \
+	probe_record(PROBE_##name, DWT->CYCCNT - probe_start_##name)
+
+/*
+ * Requests are a CANID_PROBE_REQUEST frame with the command in byte 0.
+ *
+ * A dump is two CANID_PROBE_DUMP frames per probe, in PROBE_TABLE order, and
+ * one line per probe on the serial console. Multi byte values are little
+ * endian, and cycle counts saturate at 24 bits.
+ *
+ * Byte 0 is the probe id:
+ *   [1:4]  count
+ *   [5:7]  average cycles
+ *
+ * Byte 0 is the probe id with bit 7 set:
+ *   [1:3]  min cycles
+ *   [4:6]  max cycles
+ */
+typedef enum {
+	PROBE_DUMP,
+	PROBE_DUMP_AND_RESET,
+	PROBE_RESET,
+} probe_request_t;
+
+/**
+ * @brief Clear every probe.
+ */
+void probe_reset(void);
+
+/**
+ * @brief Send every probe over CAN and the serial console.
+ *
+ * @param reset Clear each probe as it is read
+ */
+void probe_dump(bool reset);
+
+/**
+ * @brief Handle a probe request received over CAN.
+ *
+ * @param msg The CANID_PROBE_REQUEST message
+ */
+void handle_probe_request(can_msg_t msg);
+
+#else
+
+#define PROBE_START(name)
+#define PROBE_END(name)
+
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file queue_stats.h
+ * @brief High water marks of every message queue, kept through the FreeRTOS trace hooks, see FreeRTOSConfig.h.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef QUEUE_STATS_H
+#define QUEUE_STATS_H
+
+/* Included from FreeRTOSConfig.h, so this must not depend on the kernel headers */
+#include <stdint.h>
+
+#define QUEUE_STATS_MAX_QUEUES 16
+
+typedef struct {
+	void *handle;
+	const char *name; /* NULL if the queue has no name */
+	uint32_t waiting;
+	uint32_t length;
+	uint32_t high_water; /* Most messages ever waiting at once */
+} queue_stats_t;
+
+/**
+ * @brief Kernel hook, start tracking a queue. Mutexes and semaphores are ignored.
+ *
+ * @param queue The queue's handle
+ * @param item_size Size of the queue's messages, 0 for mutexes and semaphores
+ */
+void queue_stats_created(void *queue, uint32_t item_size);
+
+/**
+ * @brief Kernel hook, record the number of messages in a queue after a send.
+ *
+ * @param number The queue number given to the queue when it was created, 0 if it is not tracked
+ * @param waiting Messages in the queue
+ */
+static inline void queue_stats_sent(uint32_t number, uint32_t waiting)
+{
+	extern uint32_t queue_stats_high_water[QUEUE_STATS_MAX_QUEUES + 1];
+
+	/* Queue number 0 is every untracked queue, which nothing reads */
+	if (waiting > queue_stats_high_water[number])
+		queue_stats_high_water[number] = waiting;
+}
+
+/**
+ * @brief Number of queues being tracked.
+ */
+uint32_t queue_stats_num_queues(void);
+
+/**
+ * @brief Get a snapshot of a queue's stats.
+ *
+ * @param index Index of the queue, in order of creation
+ * @param stats Pointer to the struct the stats will be copied to
+ */
+void queue_stats_get(uint32_t index, queue_stats_t *stats);
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * @file rtos_stats.h
+ * @brief Per task CPU load, stack headroom and heap telemetry, built on the FreeRTOS run time stats.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef RTOS_STATS_H
+#define RTOS_STATS_H
+
+#include "cmsis_os.h"
+
+#define RTOS_STATS_MAX_TASKS	24
+#define RTOS_STATS_SERIAL_EVERY 5 /* reports */
+
+/*
+ * Every report is a burst of CANID_RTOS_STATS frames multiplexed on byte 0.
+ * Multi byte values are little endian.
+ *
+ * Mux 0, system:
+ *   [1]    idle, percent of CPU
+ *   [2:3]  minimum ever free heap, bytes
+ *   [4:5]  free heap, bytes
+ *   [6]    number of tasks
+ *   [7]    serial messages dropped since boot, saturates at 255
+ *
+ * Mux 1 to number of tasks, one per task in FreeRTOS task number order:
+ *   [1]    FreeRTOS task number, stable for the life of the task
+ *   [2:3]  CPU load, tenths of a percent
+ *   [4:5]  stack high water mark, bytes
+ *   [6]    base priority
+ *   [7]    first character of the task name
+ *
+ * CPU load covers the time since the last report. Interrupts are charged to
+ * whichever task they preempted.
+ */
+
+/**
+ * @brief Task that periodically reports the RTOS stats over CAN, and every RTOS_STATS_SERIAL_EVERY reports over the serial console.
+ */
+void vRtosStats(void *pv_params);
+extern osThreadId_t rtos_stats_handle;
+extern const osThreadAttr_t rtos_stats_attributes;
+
+#endif
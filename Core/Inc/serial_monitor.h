@@ -2,13 +2,36 @@
 #define SERIAL_MONITOR_H
 
 #include "cmsis_os.h"
+#include "stm32f4xx_hal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Output goes into a byte ring that USART3 drains by DMA, so printing costs
+ * the caller a format and a copy, and never blocks. Safe to call from any
+ * task or interrupt. Messages that do not fit in the ring are dropped whole
+ * and counted.
+ */
 
 /* Function to queue a message to be sent on the UART stream */
 int serial_print(const char *format, ...);
 
-/* Task for printing values to USART output */
-void vSerialMonitor(void *pv_params);
-extern osThreadId_t serial_monitor_handle;
-extern const osThreadAttr_t serial_monitor_attributes;
+/* Queue raw bytes to be sent on the UART stream, returns -1 if they were dropped */
+int serial_write(const void *data, size_t len);
+
+/* Number of messages dropped because the ring was full */
+uint32_t serial_dropped(void);
+
+/* Take one received byte, returns 0 if there is none */
+int serial_read(uint8_t *byte);
+
+/* Set the thread flag that is raised on a thread whenever bytes are received */
+void serial_set_reader(osThreadId_t thread, uint32_t flag);
+
+/* Move received bytes into the receive ring, called from the UART interrupt before the HAL handler */
+void serial_monitor_rx_isr(void);
+
+/* Start draining the ring out of a UART, must be called after the UART is initialized */
+void serial_monitor_init(UART_HandleTypeDef *huart);
 
 #endif // SERIAL_MONITOR_H
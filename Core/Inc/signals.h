@@ -0,0 +1,107 @@
+/**
+ * @file signals.h
+ * @brief Latest value of state shared between tasks. Each signal has one producer that publishes it without locking, and any task can read it without waiting or subscribe to be told when it changes.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef SIGNALS_H
+#define SIGNALS_H
+
+#include "cmsis_os.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * X(id, member), where member is the field of signal_value_t the signal is
+ * stored in. Only the task named in the comment may publish each signal.
+ */
+#define SIGNAL_TABLE(X)                                                      \
+	X(BRAKE, b) /* Brakes engaged, pedals task */                        \
+	X(TSMS, b) /* Debounced TSMS, data collection task */               \
+	X(RPM, i) /* Motor RPM, CAN receive task */                          \
+	X(MPH, f) /* Speed of the car, CAN receive task */                   \
+	X(FUNC_STATE, u) /* func_state_t, state machine director */          \
+	X(PEDAL, u) /* Accel pedal travel %, pedals task */                  \
+	X(LV_VOLTAGE, u) /* LV battery, as sent in CANID_LV_MONITOR, non functional data task */
+
+#define SIGNAL_ID(id, member) SIGNAL_##id,
+typedef enum { SIGNAL_TABLE(SIGNAL_ID) NUM_SIGNALS } signal_id_t;
+
+#define SIGNAL_MAX_SUBSCRIBERS 2 /* Per signal */
+
+/* Every signal fits in one word */
+typedef union {
+	bool b;
+	int32_t i;
+	uint32_t u;
+	float f;
+} signal_value_t;
+
+typedef struct {
+	signal_value_t value;
+	uint32_t time; /* Kernel tick it was published at */
+	uint32_t version; /* Counts publishes, 0 if it was never published */
+} signal_sample_t;
+
+/**
+ * @brief Publish a new value. Must only be called by the signal's producer. Subscribers are notified if the value is different from the last one.
+ *
+ * @param id The signal
+ * @param value The new value
+ */
+void signal_publish(signal_id_t id, signal_value_t value);
+
+/**
+ * @brief Read the latest value of a signal with its version and time. Never blocks, and only repeats the copy if the producer published part way through it.
+ *
+ * @param id The signal
+ * @param sample Where the value is copied to
+ */
+void signal_read(signal_id_t id, signal_sample_t *sample);
+
+/**
+ * @brief Read the latest value of a signal.
+ */
+static inline signal_value_t signal_get(signal_id_t id)
+{
+	signal_sample_t sample;
+	signal_read(id, &sample);
+	return sample.value;
+}
+
+/**
+ * @brief Get how long ago a signal was last published, to tell whether it is stale.
+ *
+ * @return uint32_t Age in ticks, UINT32_MAX if it was never published
+ */
+uint32_t signal_age(signal_id_t id);
+
+/**
+ * @brief Set thread flags on the calling task every time a signal changes. The new value is already published when the flags are set. Wait for them with osThreadFlagsWait(), or poll with osThreadFlagsClear(), then read the signal.
+ *
+ * @param id The signal
+ * @param flags Flags to set
+ * @return int 0 on success, -1 if the signal already has SIGNAL_MAX_SUBSCRIBERS
+ */
+int signal_subscribe(signal_id_t id, uint32_t flags);
+
+/**
+ * @brief Get a signal's name.
+ */
+const char *signal_name(signal_id_t id);
+
+/**
+ * @brief Print a signal's value as text.
+ *
+ * @param id The signal the value is from
+ * @param value The value
+ * @param buf Where the text is written
+ * @param len Size of buf
+ */
+void signal_format(signal_id_t id, signal_value_t value, char *buf,
+		   uint32_t len);
+
+#endif
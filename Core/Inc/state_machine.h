@@ -57,6 +57,37 @@ typedef struct {
 	dti_t *mc;
 } sm_director_args_t;
 
+/**
+ * @brief Outcome of a state transition request, the reason it was refused if it was.
+ */
+typedef enum {
+	TRANSITION_OK,
+	TRANSITION_NOT_ALLOWED, /* Not reachable from the current state */
+	TRANSITION_MOVING, /* The motor must be stopped */
+	TRANSITION_BRAKE_OFF, /* Brakes must be engaged */
+	TRANSITION_TSMS_OFF, /* TSMS must be on */
+	TRANSITION_FAULT_ACTIVE, /* A fault that faults the car is still active */
+	NUM_TRANSITION_RESULTS
+} transition_result_t;
+
+#define STATE_TRACE_LEN 16 /* Requests */
+
+/**
+ * @brief A state transition request handled by the director.
+ */
+typedef struct {
+	uint32_t latency; /* us from the request being queued to it being handled */
+	bool nero; /* NERO request if true, functional otherwise */
+	uint8_t from; /* func_state_t, or NERO index for NERO requests */
+	uint8_t to; /* func_state_t, or NERO index for NERO requests */
+	uint8_t result; /* transition_result_t */
+} state_trace_t;
+
+/**
+ * @brief Create the state transition queue. Must be called before the scheduler is started.
+ */
+void state_machine_init();
+
 /**
  * @brief Task for handling state transitions.
  * 
@@ -80,6 +111,11 @@ func_state_t get_func_state();
  */
 bool get_active();
 
+/**
+ * @brief Returns true if a functional state is an active state, for tasks that keep their own copy of the state.
+ */
+bool is_active_state(func_state_t functional);
+
 /**
  * @brief Retrieves the current NERO state.
  * 
@@ -119,6 +155,40 @@ int select_nero_index();
  */
 int set_home_mode();
 
+/**
+ * @brief Queue a transition to any functional state. The director still rejects transitions that are not allowed from the current state.
+ * 
+ * @param new_state The functional state to enter
+ * @return int Error code resulting from queueing a state transition
+ */
+int request_func_state(func_state_t new_state);
+
+/**
+ * @brief Queue a transition to any NERO state. The director still rejects transitions that are not allowed from the current state.
+ * 
+ * @param new_state The NERO state to enter
+ * @return int Error code resulting from queueing a state transition
+ */
+int request_nero_state(nero_state_t new_state);
+
+/**
+ * @brief Get the number of requests in the transition trace, at most STATE_TRACE_LEN.
+ */
+uint32_t state_trace_num();
+
+/**
+ * @brief Get a request from the transition trace, oldest first.
+ *
+ * @param n Index of the request, 0 is the oldest
+ * @param entry Pointer to the location the request will be copied to
+ */
+void state_trace_get(uint32_t n, state_trace_t *entry);
+
+/**
+ * @brief Get a short description of a transition result.
+ */
+const char *transition_result_name(transition_result_t result);
+
 /**
  * @brief Queue a state transition to set the functinoal mode of the car to the faulted state.
  * 
@@ -2,13 +2,16 @@
 #define STEERING_H
 
 #include "cmsis_os.h"
-#include "ringbuffer.h"
-#include "timer.h"
+#include "stm32f4xx_hal.h"
 #include <stdbool.h>
 #include <stdint.h>
 
 #define STEERING_CANID_IO 0x680
 
+#define STEERING_EDGE_QUEUE_SIZE 16 /* edges, must be a power of 2 */
+#define STEERING_CONFIRMED_FLAG	 1U
+#define STEERING_DEBOUNCE_TIM_HZ 10000 /* debounce timer counter clock */
+
 typedef enum {
 	NONE,
 	NONE2,
@@ -23,29 +26,76 @@ typedef enum {
 	MAX_STEERING_BUTTONS
 } steeringio_button_t;
 
+/* Edge on a steering wheel input, recorded from the EXTI interrupt */
+typedef struct {
+	uint32_t timestamp; /* timebase_local(), us, so latencies survive a time sync step */
+	uint16_t pin;
+} steeringio_edge_t;
+
 typedef struct {
 	/* Necessary to allow multiple threads to access same data */
 	osMutexId_t *button_mutex;
-	nertimer_t *debounce_timers[MAX_STEERING_BUTTONS];
-	bool raw_buttons[MAX_STEERING_BUTTONS];
+	/* One pulse timer that confirms the inputs have settled */
+	TIM_HandleTypeDef *debounce_tim;
+
+	/* Single producer (EXTI ISR), single consumer (steering task) queue */
+	steeringio_edge_t edges[STEERING_EDGE_QUEUE_SIZE];
+	volatile uint8_t edge_head;
+	volatile uint8_t edge_tail;
+	volatile uint32_t dropped_edges;
+
+	/* Button snapshot that survived the debounce window, written by the timer ISR */
+	volatile uint8_t confirmed_data;
+	/* Last levels seen on the inputs that share an EXTI line with another input */
+	uint16_t shared_lines_state;
+
+	/* Time from the first edge of a press to the press being handled */
+	uint32_t press_latency; /* us */
 	bool debounced_buttons[MAX_STEERING_BUTTONS];
-	/* Array indicating that a button has already been pressed and not unpressed */
-	bool debounced[MAX_STEERING_BUTTONS];
 } steeringio_t;
 
 /**
  * @brief Creates a new steering wheel interface.
- * 
+ *
+ * @param debounce_tim Timer configured for one pulse mode with a STEERING_DEBOUNCE_TIM_HZ counter clock
  * @return steeringio_t* Pointer to struct defining steering wheel interface
  */
-steeringio_t *steeringio_init();
+steeringio_t *steeringio_init(TIM_HandleTypeDef *debounce_tim);
 
 /**
  * @brief Update the status of the steering wheel buttons.
- * 
+ *
  * @param wheel Pointer to struct representing the steering wheel
- * @param button_data Unsigned 8 bit integer where each bit is a button status
+ * @param button_data Unsigned 8 bit integer where each bit is a debounced button status
  */
 void steeringio_update(steeringio_t *wheel, uint8_t button_data);
 
+/**
+ * @brief Record an edge on a steering wheel input and restart the debounce window. Must only be called from the EXTI interrupt.
+ *
+ * @param pin GPIO pin (EXTI line) that triggered the interrupt
+ */
+void steeringio_edge_isr(uint16_t pin);
+
+/**
+ * @brief Called from the debounce timer interrupt once the inputs have been stable for the debounce period.
+ */
+void steeringio_debounce_isr(void);
+
+/**
+ * @brief Check the inputs that can't be given their own EXTI line and raise a software edge if they changed.
+ *
+ * @param wheel Pointer to struct representing the steering wheel
+ */
+void steeringio_poll_shared_lines(steeringio_t *wheel);
+
+/**
+ * @brief Task for handling debounced steering wheel button presses. Sleeps until the debounce timer confirms a change.
+ *
+ * @param pv_params Pointer to steeringio_t
+ */
+void vSteeringIO(void *pv_params);
+extern osThreadId_t steeringio_thread;
+extern const osThreadAttr_t steeringio_attributes;
+
 #endif /* STEERING_H */
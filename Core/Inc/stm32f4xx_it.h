@@ -53,7 +53,14 @@ void BusFault_Handler(void);
 void UsageFault_Handler(void);
 void DebugMon_Handler(void);
 void SysTick_Handler(void);
+void EXTI1_IRQHandler(void);
+void EXTI4_IRQHandler(void);
+void DMA1_Stream3_IRQHandler(void);
+void ADC_IRQHandler(void);
 void CAN1_RX0_IRQHandler(void);
+void EXTI9_5_IRQHandler(void);
+void USART3_IRQHandler(void);
+void TIM7_IRQHandler(void);
 /* USER CODE BEGIN EFP */
 
 /* USER CODE END EFP */
@@ -0,0 +1,42 @@
+/**
+ * @file supervisor.h
+ * @brief Deadline monitor and watchdog supervisor. The IWDG is only refreshed while every registered task keeps checking in.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "cmsis_os.h"
+#include "stm32f4xx_hal.h"
+#include "task_sched.h"
+
+/* Event driven tasks must wake up and check in at least this often */
+#define SUPERVISOR_HEARTBEAT 100 /* ms */
+
+/* A task is stuck once it has gone this many periods or heartbeats without checking in */
+#define SUPERVISOR_MISSED_CHECKINS 3
+
+/* Deadline misses in a row before a fault is raised */
+#define SUPERVISOR_OVERRUN_LIMIT 3
+
+/**
+ * @brief Put a task under supervision. Call from the task before its loop, the task then checks in with task_sched_complete() at the end of every iteration.
+ *
+ * @param task The task to supervise
+ */
+void supervisor_register(task_id_t task);
+
+/**
+ * @brief Task that checks every registered task's deadlines and check ins, and refreshes the IWDG while they are all healthy.
+ *
+ * @param pv_params Pointer to the IWDG_HandleTypeDef
+ */
+void vSupervisor(void *pv_params);
+extern osThreadId_t supervisor_handle;
+extern const osThreadAttr_t supervisor_attributes;
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * @file task_sched.h
+ * @brief Timing table every task priority is derived from, and release time tracking for the periodic tasks.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef TASK_SCHED_H
+#define TASK_SCHED_H
+
+#include "cmsis_os.h"
+#include "cerberus_conf.h"
+#include <stdint.h>
+
+/*
+ * Period and deadline of every task, in ms. Event driven tasks have a period of 0.
+ *
+ * Priorities are assigned deadline monotonically: the shorter the deadline, the
+ * higher the priority, and tasks with the same deadline share a priority and are
+ * time sliced. Change timing here rather than in the thread attributes.
+ *
+ * X(name, period, deadline, arg)
+ */
+#define TASK_SCHED_TABLE(X, arg)                                      \
+	X(FAULT_HANDLER, 0, 2, arg)                                   \
+	X(CAN_RECEIVE, 0, 5, arg)                                     \
+	X(CAN_DISPATCH, 0, 5, arg)                                    \
+	X(PEDALS, PEDALS_SAMPLE_DELAY, PEDALS_SAMPLE_DELAY, arg)       \
+	X(STATE_MACHINE, 0, 15, arg)                                  \
+	X(DATA_COLLECTION, 20, 20, arg)                               \
+	X(TIMER_SERVICE, 0, 25, arg)                                  \
+	X(STEERINGIO, 0, 50, arg)                                     \
+	X(SUPERVISOR, SUPERVISOR_DELAY, SUPERVISOR_DELAY, arg)         \
+	X(RTDS, 0, 100, arg)                                          \
+	X(TEMP_MONITOR, TEMP_SENS_SAMPLE_DELAY, TEMP_SENS_SAMPLE_DELAY, \
+	  arg)                                                        \
+	X(IMU_MONITOR, IMU_SAMPLE_DELAY, IMU_SAMPLE_DELAY, arg)       \
+	X(SHUTDOWN_MONITOR, SHUTDOWN_MONITOR_DELAY,                   \
+	  SHUTDOWN_MONITOR_DELAY, arg)                                \
+	X(NON_FUNCTIONAL, FUSES_SAMPLE_DELAY, FUSES_SAMPLE_DELAY, arg) \
+	X(RTOS_STATS, RTOS_STATS_DELAY, RTOS_STATS_DELAY, arg)         \
+	X(BLACKBOX, 0, 1000, arg)                                     \
+	X(TRACE_DUMP, 0, 2000, arg)                                   \
+	X(CONSOLE, 0, 5000, arg)
+
+#define TASK_SCHED_ID(name, period, deadline, arg) TASK_##name,
+typedef enum { TASK_SCHED_TABLE(TASK_SCHED_ID, 0) NUM_SCHED_TASKS } task_id_t;
+
+#define TASK_SCHED_TIMING(name, period, deadline, arg) \
+	TASK_##name##_PERIOD = (period), TASK_##name##_DEADLINE = (deadline),
+enum { TASK_SCHED_TABLE(TASK_SCHED_TIMING, 0) };
+
+#define TASK_PERIOD(name)   TASK_##name##_PERIOD /* ms */
+#define TASK_DEADLINE(name) TASK_##name##_DEADLINE /* ms */
+
+/* Counts the tasks with a shorter deadline, each one pushes this task down a level */
+#define TASK_SCHED_SHORTER(name, period, deadline, than) +((deadline) < (than))
+#define TASK_PRIORITY(name)                                                     \
+	((osPriority_t)(osPriorityRealtime7 -                                   \
+			(0 TASK_SCHED_TABLE(TASK_SCHED_SHORTER, TASK_DEADLINE(name)))))
+
+/* Spacing between releases of a task, and how long each iteration took */
+typedef struct {
+	uint32_t last_release; /* CPU cycles */
+	uint32_t min_period; /* CPU cycles */
+	uint32_t max_period; /* CPU cycles */
+	uint32_t releases;
+	uint32_t max_exec; /* CPU cycles */
+	uint32_t overruns; /* Iterations that finished after their deadline */
+	uint32_t overruns_in_row;
+	uint32_t last_complete; /* ms */
+} task_sched_stats_t;
+
+/**
+ * @brief Start the cycle counter used to timestamp releases and clear every task's stats. Must be called before the scheduler is started.
+ */
+void task_sched_init(void);
+
+/**
+ * @brief Record that a periodic task has woken up for its next period. Call once at the top of every iteration of the task loop.
+ *
+ * @param task The task that was released
+ */
+void task_sched_release(task_id_t task);
+
+/**
+ * @brief Record that a task has finished an iteration, and check it against its deadline. Call at the end of every iteration of the task loop, after task_sched_release().
+ *
+ * @param task The task that finished
+ */
+void task_sched_complete(task_id_t task);
+
+/**
+ * @brief Get a snapshot of a task's release stats.
+ *
+ * @param task The task to get stats for
+ * @param stats Pointer to the struct the stats will be copied to
+ */
+void task_sched_get_stats(task_id_t task, task_sched_stats_t *stats);
+
+/**
+ * @brief Clear a task's release stats.
+ *
+ * @param task The task to clear stats for
+ */
+void task_sched_reset_stats(task_id_t task);
+
+/**
+ * @brief Convert a number of CPU cycles to microseconds.
+ */
+uint32_t task_sched_cycles_to_us(uint32_t cycles);
+
+#ifdef TASK_SCHED_JITTER_TEST
+#include "mpu.h"
+#include "pdu.h"
+
+typedef struct {
+	mpu_t *mpu;
+	pdu_t *pdu;
+} jitter_test_args_t;
+
+/**
+ * @brief Saturates the serial and I2C tasks, then reports whether the pedal loop period stayed within tolerance.
+ *
+ * @param pv_params Pointer to jitter_test_args_t
+ */
+void vJitterTest(void *pv_params);
+extern osThreadId_t jitter_test_handle;
+extern const osThreadAttr_t jitter_test_attributes;
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @file timebase.h
+ * @brief Microsecond timebase shared by every timestamp the car records. TIM2 counts free running at CLOCK_TIMEBASE_HZ, and an offset kept by time sync turns it into bus time, the same time every node on the CAN bus agrees on.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+
+/*
+ * Both times are 32 bit microsecond counts that wrap every 71 minutes, so
+ * only ever compare them by subtracting. Bus time is the local time on the
+ * time sync master, and steps when a slave first syncs, see timesync.h.
+ */
+#define TIMEBASE_TIM TIM2 /* 32 bit */
+
+/* Bus time minus local time, only written by time sync */
+extern volatile uint32_t timebase_offset;
+
+/**
+ * @brief Get the local time, which is never adjusted. Callable from anywhere, including interrupts.
+ *
+ * @return uint32_t Local time, us
+ */
+static inline uint32_t timebase_local(void)
+{
+	return TIMEBASE_TIM->CNT;
+}
+
+/**
+ * @brief Get the bus time. One register read and an add, callable from anywhere, including interrupts.
+ *
+ * @return uint32_t Bus time, us
+ */
+static inline uint32_t now_us(void)
+{
+	return TIMEBASE_TIM->CNT + timebase_offset;
+}
+
+/**
+ * @brief Start the timebase. Timestamps are 0 until it is started, so do it before anything else.
+ *
+ * @param htim TIM2, configured to count at CLOCK_TIMEBASE_HZ up to 0xFFFFFFFF
+ */
+void timebase_init(TIM_HandleTypeDef *htim);
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file timesync.h
+ * @brief Time sync over CAN. The master broadcasts its time so every node can discipline its clock to one bus time, and logs from different ECUs line up to well under a millisecond. Cerberus is the master unless built with `make TIMESYNC_SLAVE=1`.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+#include "can.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Sync is two step, like AUTOSAR CanTSyn. Every TIMESYNC_PERIOD the master
+ * sends a SYNC frame, then a FUP (follow up) frame with the bus time the SYNC
+ * frame finished at, which is when receivers timestamp it. Both are
+ * CANID_TIME_SYNC:
+ *
+ *   [0]    TIMESYNC_SYNC or TIMESYNC_FUP
+ *   [1]    sequence number, the same in a SYNC and its FUP
+ *   [2:3]  reserved, 0
+ *   [4:7]  SYNC: bus time it was queued at, us, for nodes that only need
+ *          coarse time. FUP: bus time the SYNC finished at, us
+ *
+ * Times are big endian. A slave timestamps SYNC frames as they are received
+ * and corrects its clock by the difference once the FUP arrives. The SYNC is
+ * only handed to the controller once it has nothing else to send, so it is
+ * only late if it loses arbitration to another node.
+ */
+#define TIMESYNC_SYNC 0x10
+#define TIMESYNC_FUP  0x18
+
+#define TIMESYNC_PERIOD	 100 /* ms */
+#define TIMESYNC_TIMEOUT (10 * TIMESYNC_PERIOD) /* ms without a sync before a slave is unsynced */
+#define TIMESYNC_STEP_US 500 /* Errors larger than this are stepped out, smaller ones are halved each sync */
+
+typedef struct {
+	bool master;
+	bool synced; /* Always true on the master */
+	uint32_t syncs; /* SYNC frames sent, or SYNC and FUP pairs applied */
+	int32_t error; /* Slave: bus time error corrected by the last sync, us */
+	uint32_t last; /* Bus time of the last sync, us */
+} timesync_status_t;
+
+/**
+ * @brief Start broadcasting on the master. Call once the kernel is initialized.
+ */
+void timesync_init(void);
+
+/**
+ * @brief Timestamp a SYNC frame the moment it is received. Call from the CAN receive interrupt for every CANID_TIME_SYNC frame.
+ *
+ * @param msg The frame
+ * @param local timebase_local() when the frame was received
+ */
+void timesync_received_from_isr(const can_msg_t *msg, uint32_t local);
+
+/**
+ * @brief Discipline the clock from a FUP frame. Call from the CAN receive task for every CANID_TIME_SYNC frame.
+ */
+void timesync_handle(const can_msg_t *msg);
+
+/**
+ * @brief Queue the FUP for a SYNC frame the master just handed to the controller. Call from the CAN dispatch task.
+ *
+ * @param msg The SYNC frame
+ * @param sent now_us() just before it was handed to the controller
+ */
+void timesync_sent(const can_msg_t *msg, uint32_t sent);
+
+/**
+ * @brief Get whether this node is synced, and how well.
+ */
+void timesync_get_status(timesync_status_t *status);
+
+#endif
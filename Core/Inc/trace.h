@@ -0,0 +1,123 @@
+/**
+ * @file trace.h
+ * @brief Kernel event trace recorder. Task switches, queue and notification traffic and interrupts are recorded into a circular buffer in CCM RAM through the FreeRTOS trace hooks, see FreeRTOSConfig.h. Decode a dump with scripts/trace_decode.py.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Included from FreeRTOSConfig.h, so this must not depend on the kernel headers */
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TRACE_BUFFER_LEN 2048 /* events, must be a power of 2 */
+#define TRACE_MAX_TASKS	 32
+
+typedef enum {
+	TRACE_TASK_SWITCHED_IN = 1, /* arg is the task's priority */
+	TRACE_QUEUE_SEND, /* arg is the object id of the queue, mutex or semaphore */
+	TRACE_QUEUE_SEND_FAILED,
+	TRACE_QUEUE_RECEIVE,
+	TRACE_QUEUE_RECEIVE_FAILED,
+	TRACE_QUEUE_SEND_FROM_ISR,
+	TRACE_QUEUE_RECEIVE_FROM_ISR,
+	TRACE_TASK_NOTIFY, /* arg is the task number of the notified task */
+	TRACE_TASK_NOTIFY_FROM_ISR,
+	TRACE_ISR_ENTER, /* arg is the exception number */
+	TRACE_ISR_EXIT,
+	TRACE_FREEZE,
+
+	/* Only sent in dumps */
+	TRACE_DUMP_START = 0xF0, /* timestamp is the timebase rate in Hz, arg is the number of events */
+	TRACE_TASK_NAME, /* timestamp is 4 characters of the name, arg is their offset */
+	TRACE_DUMP_END,
+} trace_event_type_t;
+
+/* Every event is one CAN frame when dumped, little endian */
+typedef struct {
+	uint32_t timestamp; /* Bus time, see timebase.h */
+	uint8_t type;
+	uint8_t task; /* Task number of the running task, or the task switched in */
+	uint16_t arg;
+} trace_event_t;
+
+_Static_assert(sizeof(trace_event_t) == 8, "Trace events must fit a CAN frame");
+
+/**
+ * @brief Record an event for the running task. Safe to call from any context, including kernel critical sections.
+ *
+ * @param type The event
+ * @param arg Event specific argument
+ */
+void trace_record(trace_event_type_t type, uint16_t arg);
+
+/**
+ * @brief Kernel hook, record a task being switched in.
+ */
+void trace_task_switched_in(uint32_t task, uint32_t priority);
+
+/**
+ * @brief Kernel hook, remember a task's name so it can be sent with dumps.
+ */
+void trace_task_created(uint32_t task, const char *name);
+
+/**
+ * @brief Record entry to an interrupt handler. Call first thing in the handler.
+ */
+void trace_isr_enter(void);
+
+/**
+ * @brief Record exit from an interrupt handler. Call last thing in the handler.
+ */
+void trace_isr_exit(void);
+
+/**
+ * @brief Stop recording so the events leading up to a fault are kept until they are dumped.
+ */
+void trace_freeze(void);
+
+/**
+ * @brief Clear the buffer and start recording again after a freeze.
+ */
+void trace_resume(void);
+
+/**
+ * @brief Pause or unpause recording without clearing the buffer, so it can be read out. A freeze takes precedence over a pause.
+ */
+void trace_pause(bool paused);
+
+/**
+ * @brief Get the number of events in the buffer.
+ */
+uint32_t trace_num_events(void);
+
+/**
+ * @brief Get an event from the buffer, oldest first. Recording should be paused or frozen while reading.
+ *
+ * @param n Index of the event, 0 is the oldest
+ * @param event Pointer to the location the event will be copied to
+ */
+void trace_get_event(uint32_t n, trace_event_t *event);
+
+/**
+ * @brief Get the name of a task seen by the recorder.
+ *
+ * @param task Task number
+ * @return const char* The name, or NULL if the task is unknown
+ */
+const char *trace_task_name(uint32_t task);
+
+/**
+ * @brief Pack the address of a kernel object into 16 bits. Control blocks are word aligned and live either in SRAM or CCM RAM, which is flagged by the top bit.
+ */
+static inline uint16_t trace_object_id(const void *object)
+{
+	uint32_t addr = (uint32_t)object;
+	return ((addr & 0x1FFFF) >> 2) | (addr < 0x20000000 ? 0x8000 : 0);
+}
+
+#endif
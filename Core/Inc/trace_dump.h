@@ -0,0 +1,44 @@
+/**
+ * @file trace_dump.h
+ * @brief Sends the kernel event trace over CAN or the serial console on request.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef TRACE_DUMP_H
+#define TRACE_DUMP_H
+
+#include "can.h"
+#include "cmsis_os.h"
+
+/*
+ * Requests are a CANID_TRACE_REQUEST frame with the command in byte 0.
+ *
+ * A dump is a TRACE_DUMP_START record, the task names, every event oldest
+ * first, then a TRACE_DUMP_END record. Over CAN each record is the 8 bytes of
+ * a trace_event_t on CANID_TRACE_DUMP. Over the serial console it is a line of
+ * "TRACE " followed by the same 8 bytes in hex.
+ */
+typedef enum {
+	TRACE_DUMP_CAN,
+	TRACE_DUMP_UART,
+	TRACE_RESUME, /* Clear the buffer and start recording after a fault froze it */
+} trace_request_t;
+
+/**
+ * @brief Handle a trace request received over CAN.
+ *
+ * @param msg The CANID_TRACE_REQUEST message
+ */
+void handle_trace_request(can_msg_t msg);
+
+/**
+ * @brief Task that sends the trace buffer when a dump is requested.
+ */
+void vTraceDump(void *pv_params);
+extern osThreadId_t trace_dump_handle;
+extern const osThreadAttr_t trace_dump_attributes;
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * @file xcp.h
+ * @brief XCP slave for measurement and calibration with standard tooling. Memory is read and written by address, and DAQ lists sample a set of addresses every time an event fires and stream them to the master.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef XCP_H
+#define XCP_H
+
+/* Independent of the transport and the kernel, so it can be tested on the host */
+#include "cerberus_conf.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Supported commands: CONNECT, DISCONNECT, GET_STATUS, SYNCH,
+ * GET_COMM_MODE_INFO, SET_MTA, UPLOAD, SHORT_UPLOAD, DOWNLOAD,
+ * SHORT_DOWNLOAD, and dynamic DAQ configuration: FREE_DAQ, ALLOC_DAQ,
+ * ALLOC_ODT, ALLOC_ODT_ENTRY, SET_DAQ_PTR, WRITE_DAQ, CLEAR_DAQ_LIST,
+ * SET_DAQ_LIST_MODE, GET_DAQ_LIST_MODE, START_STOP_DAQ_LIST,
+ * START_STOP_SYNCH, GET_DAQ_PROCESSOR_INFO, GET_DAQ_RESOLUTION_INFO and
+ * GET_DAQ_EVENT_INFO.
+ *
+ * Packets are at most 8 bytes, little endian, with byte granularity. DAQ
+ * packets start with the absolute ODT number as their PID. A list in
+ * timestamp mode has a 4 byte xcp_timestamp() after the PID of its first
+ * ODT, which leaves 3 bytes for that ODT's entries. Configuration is refused
+ * while any DAQ list is running, and events read it under xcp_lock(), so a
+ * list stopped and reconfigured mid-sample is never seen half changed.
+ */
+#define XCP_MAX_CTO 8 /* Bytes */
+#define XCP_MAX_DTO 8 /* Bytes */
+
+#define XCP_MAX_DAQ_LISTS   4
+#define XCP_MAX_ODTS	    16 /* Shared by every DAQ list */
+#define XCP_MAX_ODT_ENTRIES 64 /* Shared by every ODT */
+
+/*
+ * Event channels DAQ lists can be attached to, X(name, period). Each fires
+ * once per period of the task that calls xcp_event() for it.
+ */
+#define XCP_EVENT_TABLE(X) X(PEDALS, PEDALS_SAMPLE_DELAY) /* ms */
+
+#define XCP_EVENT_ID(name, period) XCP_EVENT_##name,
+typedef enum { XCP_EVENT_TABLE(XCP_EVENT_ID) XCP_NUM_EVENTS } xcp_event_t;
+
+/**
+ * @brief Send a packet to the master.
+ *
+ * @param data The packet
+ * @param len Length of the packet, at most XCP_MAX_DTO
+ */
+typedef void (*xcp_send_t)(const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Set the transport responses and DAQ packets are sent on. Must be called before any other XCP function.
+ */
+void xcp_init(xcp_send_t send);
+
+/**
+ * @brief Handle a command packet from the master. Commands are handled one at a time, so this must only be called from one task.
+ *
+ * @param cmd The packet
+ * @param len Length of the packet
+ */
+void xcp_command(const uint8_t *cmd, uint8_t len);
+
+/**
+ * @brief Sample and send every running DAQ list attached to an event. Costs nothing when no list is attached.
+ *
+ * @param event The event that fired
+ */
+void xcp_event(xcp_event_t event);
+
+/**
+ * @brief Turn an address from the master into a pointer, checking it may be accessed. Provided by the platform.
+ *
+ * @param addr The address
+ * @param ext The address extension
+ * @param len Number of bytes that will be accessed
+ * @param write True if the bytes will be written
+ * @return void* Pointer to the first byte, or NULL if access is denied
+ */
+void *xcp_map(uint32_t addr, uint8_t ext, uint32_t len, bool write);
+
+/**
+ * @brief Get the time DAQ lists in timestamp mode are stamped with. Provided by the platform.
+ *
+ * @return uint32_t Time, us
+ */
+uint32_t xcp_timestamp(void);
+
+/**
+ * @brief Keep commands from running while an event reads the DAQ configuration. Held for a few short copies and never around xcp_send(). Provided by the platform.
+ */
+void xcp_lock(void);
+
+/**
+ * @brief Release xcp_lock(). Provided by the platform.
+ */
+void xcp_unlock(void);
+
+#endif
@@ -0,0 +1,27 @@
+/**
+ * @file xcp_can.h
+ * @brief XCP on CAN: commands arrive on CANID_XCP_CRO, and responses and DAQ packets are sent on CANID_XCP_DTO.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef XCP_CAN_H
+#define XCP_CAN_H
+
+#include "can.h"
+
+/**
+ * @brief Send XCP packets on CAN 1. Must be called after CAN 1 is initialized.
+ */
+void xcp_can_init(void);
+
+/**
+ * @brief Handle an XCP command received over CAN.
+ *
+ * @param msg The CANID_XCP_CRO message
+ */
+void handle_xcp_command(can_msg_t msg);
+
+#endif
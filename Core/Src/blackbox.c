@@ -0,0 +1,180 @@
+/**
+ * @file blackbox.c
+ * @brief Black box recorder of the pedals task and received CAN frames, saved to flash on a fault.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "blackbox.h"
+#include "flash.h"
+#include "log.h"
+#include "state_machine.h"
+#include "stm32f4xx_hal.h"
+#include "task_sched.h"
+#include "timebase.h"
+#include "ccmram.h"
+#include <stddef.h>
+#include <string.h>
+
+#define BLACKBOX_SECTOR FLASH_SECTOR_3
+#define FREEZE_FLAG	1U
+
+/* Programming stalls the CPU, so give the other tasks a tick between chunks */
+#define CHUNK_LEN 64 /* Bytes */
+
+#define SAMPLES_ADDR (BLACKBOX_ADDR + sizeof(blackbox_header_t))
+#define CAN_ADDR     (SAMPLES_ADDR + sizeof(samples))
+
+static blackbox_sample_t samples[BLACKBOX_SAMPLES];
+static blackbox_can_t can_frames[BLACKBOX_CAN_FRAMES];
+
+/* Total recorded, the ring index is this modulo its length */
+static uint32_t num_samples;
+static uint32_t num_can;
+
+static volatile bool frozen;
+static volatile bool saving;
+static blackbox_header_t header;
+
+void blackbox_record(const blackbox_sample_t *sample)
+{
+	if (frozen)
+		return;
+
+	samples[num_samples % BLACKBOX_SAMPLES] = *sample;
+	num_samples++;
+}
+
+void blackbox_record_can(const can_msg_t *msg)
+{
+	if (frozen)
+		return;
+
+	blackbox_can_t *frame = &can_frames[num_can % BLACKBOX_CAN_FRAMES];
+	frame->time = now_us();
+	frame->id = msg->id;
+	frame->len = msg->len;
+	memcpy(frame->data, msg->data, sizeof(frame->data));
+	num_can++;
+}
+
+void blackbox_freeze(uint32_t fault)
+{
+	/* Keep the first fault, not the ones it set off */
+	if (__atomic_test_and_set(&frozen, __ATOMIC_ACQUIRE))
+		return;
+
+	header = (blackbox_header_t){ .magic = BLACKBOX_MAGIC,
+				      .version = BLACKBOX_VERSION,
+				      .fault = fault,
+				      .time = now_us() };
+	osThreadFlagsSet(blackbox_handle, FREEZE_FLAG);
+}
+
+const blackbox_header_t *blackbox_saved(void)
+{
+	const blackbox_header_t *saved = (const blackbox_header_t *)BLACKBOX_ADDR;
+
+	if (saved->magic != BLACKBOX_MAGIC ||
+	    saved->version != BLACKBOX_VERSION)
+		return NULL;
+
+	return saved;
+}
+
+int blackbox_clear(void)
+{
+	/* A freeze hands over to the save task before it starts saving */
+	if (get_active() || frozen || saving)
+		return -1;
+
+	return flash_erase(BLACKBOX_SECTOR) ? -2 : 0;
+}
+
+/**
+ * @brief Program a block a chunk at a time, yielding between chunks.
+ */
+static int save_block(uint32_t addr, const void *data, uint32_t len)
+{
+	for (uint32_t offset = 0; offset < len; offset += CHUNK_LEN) {
+		uint32_t chunk = len - offset < CHUNK_LEN ? len - offset :
+							    CHUNK_LEN;
+		if (flash_program(addr + offset, (const uint8_t *)data + offset,
+				  chunk))
+			return -1;
+		osDelay(1);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Save the frozen rings, the header last so only a whole dump is valid.
+ */
+static int save(void)
+{
+	if (blackbox_saved())
+		return -1;
+
+	/* Something half written is in the way. Erasing stalls the CPU, which is fine once the car has faulted, but not for a save by hand while driving */
+	if (!flash_erased(BLACKBOX_ADDR, BLACKBOX_LEN)) {
+		if (!header.fault && get_active())
+			return -3;
+		if (flash_erase(BLACKBOX_SECTOR))
+			return -2;
+	}
+
+	header.num_samples = num_samples < BLACKBOX_SAMPLES ? num_samples :
+							      BLACKBOX_SAMPLES;
+	header.next_sample = num_samples % BLACKBOX_SAMPLES;
+	header.num_can = num_can < BLACKBOX_CAN_FRAMES ? num_can :
+							 BLACKBOX_CAN_FRAMES;
+	header.next_can = num_can % BLACKBOX_CAN_FRAMES;
+
+	if (save_block(SAMPLES_ADDR, samples, sizeof(samples)) ||
+	    save_block(CAN_ADDR, can_frames, sizeof(can_frames)) ||
+	    save_block(BLACKBOX_ADDR, &header, sizeof(header)))
+		return -2;
+
+	return 0;
+}
+
+osThreadId_t blackbox_handle;
+static StaticTask_t blackbox_cb CCM_BSS(blackbox_cb);
+static uint32_t blackbox_stack[128 * 4 / sizeof(uint32_t)]
+	CCM_BSS(blackbox_stack);
+const osThreadAttr_t blackbox_attributes = {
+	.name = "Blackbox",
+	.cb_mem = &blackbox_cb,
+	.cb_size = sizeof(blackbox_cb),
+	.stack_mem = blackbox_stack,
+	.stack_size = sizeof(blackbox_stack),
+	.priority = TASK_PRIORITY(BLACKBOX),
+};
+
+void vBlackbox(void *pv_params)
+{
+	for (;;) {
+		osThreadFlagsWait(FREEZE_FLAG, osFlagsWaitAny, osWaitForever);
+
+		saving = true;
+		int ret = save();
+		saving = false;
+
+		if (ret == -1)
+			LOG("Black box already holds a dump, clear it to save another\r\n");
+		else if (ret == -3)
+			LOG("Black box needs erasing, which is refused while the car is active\r\n");
+		else if (ret)
+			LOG("Could not save the black box to flash\r\n");
+		else
+			LOG("Saved the black box to flash\r\n");
+
+		/* Start over so the next dump does not mix in what led up to this one */
+		num_samples = 0;
+		num_can = 0;
+		__atomic_clear(&frozen, __ATOMIC_RELEASE);
+	}
+}
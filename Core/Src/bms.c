@@ -8,7 +8,15 @@
 #include <stdlib.h>
 #include "stdio.h"
 
-bms_t *bms;
+static bms_t bms_data;
+bms_t *bms = &bms_data;
+
+static StaticTimer_t bms_monitor_timer_cb;
+static const osTimerAttr_t bms_monitor_timer_attributes = {
+	.name = "BmsMonitor",
+	.cb_mem = &bms_monitor_timer_cb,
+	.cb_size = sizeof(bms_monitor_timer_cb),
+};
 
 void bms_fault_callback()
 {
@@ -21,11 +29,9 @@ void bms_fault_callback()
 
 void bms_init()
 {
-	bms = malloc(sizeof(bms_t));
-	assert(bms);
-
-	bms->bms_monitor_timer =
-		osTimerNew(&bms_fault_callback, osTimerOnce, NULL, NULL);
+	bms->bms_monitor_timer = osTimerNew(&bms_fault_callback, osTimerOnce,
+					    NULL, &bms_monitor_timer_attributes);
+	assert(bms->bms_monitor_timer);
 }
 
 void handle_dcl_msg()
@@ -20,44 +20,70 @@
 #include "stdio.h"
 #include <string.h>
 #include "cerb_utils.h"
+#include "mailbox.h"
+#include "task_sched.h"
+#include "ccmram.h"
+#include "trace_dump.h"
+#include "xcp_can.h"
+#include "params.h"
+#include "supervisor.h"
+#include "probe.h"
+#include "blackbox.h"
+#include "timebase.h"
+#include "timesync.h"
 
-#define CAN_MSG_QUEUE_SIZE 50 /* messages */
+/* Both CAN rings are only touched by the CPU, so they can live in CCM RAM */
+static mailbox_t can_outbound_mailbox CCM_BSS(can_outbound_mailbox);
+static uint8_t can_outbound_mailbox_buf[MAILBOX_BUF_SIZE(CAN_MSG_QUEUE_SIZE,
+							 can_msg_t)]
+	CCM_BSS(can_outbound_mailbox_buf);
 
-#define CAN_DISPATCH_FLAG 1U
+static mailbox_t can_inbound_mailbox CCM_BSS(can_inbound_mailbox);
+static uint8_t can_inbound_mailbox_buf[MAILBOX_BUF_SIZE(CAN_MSG_QUEUE_SIZE,
+							can_msg_t)]
+	CCM_BSS(can_inbound_mailbox_buf);
 
-#define NEW_CAN_MSG_FLAG 1U
+static can_t can1_data;
+can_t *can1 = &can1_data;
 
-static osMessageQueueId_t can_outbound_queue;
-static osMessageQueueId_t can_inbound_queue;
-
-can_t *can1;
+static can_stats_t stats;
 
 /* Relevant Info for Initializing CAN 1 */
-static uint32_t id_list[] = { DTI_CANID_ERPM, DTI_CANID_CURRENTS, BMS_DCL_MSG };
+static uint32_t id_list[] = { DTI_CANID_ERPM, DTI_CANID_CURRENTS, BMS_DCL_MSG,
+			      CANID_TRACE_REQUEST, CANID_XCP_CRO,
+			      CANID_PARAM_REQUEST,
+#ifdef PROBE_ENABLE
+			      CANID_PROBE_REQUEST,
+#endif
+#ifdef TIMESYNC_SLAVE
+			      CANID_TIME_SYNC,
+#endif
+};
 
 void init_can1(CAN_HandleTypeDef *hcan)
 {
 	assert(hcan);
 
-	/* Create PDU struct */
-	can1 = malloc(sizeof(can_t));
-	assert(can1);
-
 	can1->hcan = hcan;
 	can1->id_list = id_list;
 	can1->id_list_len = sizeof(id_list) / sizeof(uint32_t);
 
 	assert(!can_init(can1));
 
-	can_outbound_queue =
-		osMessageQueueNew(CAN_MSG_QUEUE_SIZE, sizeof(can_msg_t), NULL);
-	can_inbound_queue =
-		osMessageQueueNew(CAN_MSG_QUEUE_SIZE, sizeof(can_msg_t), NULL);
+	mailbox_init(&can_outbound_mailbox, "CanOutbound",
+		     can_outbound_mailbox_buf, CAN_MSG_QUEUE_SIZE,
+		     sizeof(can_msg_t));
+	mailbox_init(&can_inbound_mailbox, "CanInbound",
+		     can_inbound_mailbox_buf, CAN_MSG_QUEUE_SIZE,
+		     sizeof(can_msg_t));
 }
 
 /* Callback to be called when we get a CAN message */
 void can1_callback(CAN_HandleTypeDef *hcan)
 {
+	/* Taken first, time sync is only as good as this timestamp */
+	uint32_t received = timebase_local();
+
 	fault_data_t fault_data = {
 		.id = CAN_ROUTING_FAULT,
 		.severity = DEFCON2,
@@ -77,24 +103,50 @@ void can1_callback(CAN_HandleTypeDef *hcan)
 	new_msg.len = rx_header.DLC;
 	new_msg.id = rx_header.StdId;
 
-	queue_and_set_flag(can_inbound_queue, &new_msg, can_receive_thread,
-			   NEW_CAN_MSG_FLAG);
+	if (new_msg.id == CANID_TIME_SYNC)
+		timesync_received_from_isr(&new_msg, received);
+
+	stats.rx_frames++;
+	if (mailbox_post_from_isr(&can_inbound_mailbox, &new_msg))
+		stats.rx_dropped++;
 }
 
 int8_t queue_can_msg(can_msg_t msg)
 {
-	if (!can_outbound_queue)
-		return -1;
+	int8_t ret = mailbox_post(&can_outbound_mailbox, &msg);
+	/* Queued from many tasks */
+	if (ret)
+		__atomic_fetch_add(&stats.tx_dropped, 1, __ATOMIC_RELAXED);
+
+	return ret;
+}
+
+uint32_t can_outbound_space(void)
+{
+	return mailbox_space(&can_outbound_mailbox);
+}
+
+void can_get_stats(can_stats_t *out)
+{
+	*out = stats;
 
-	return queue_and_set_flag(can_outbound_queue, &msg, can_dispatch_handle,
-				  CAN_DISPATCH_FLAG);
+	uint32_t esr = can1->hcan->Instance->ESR;
+	out->tx_error_count = (esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos;
+	out->rx_error_count = (esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos;
+	out->bus_off = esr & CAN_ESR_BOFF;
 }
 
 osThreadId_t can_dispatch_handle;
+static StaticTask_t can_dispatch_cb CCM_BSS(can_dispatch_cb);
+static uint32_t can_dispatch_stack[128 * 8 / sizeof(uint32_t)]
+	CCM_BSS(can_dispatch_stack);
 const osThreadAttr_t can_dispatch_attributes = {
 	.name = "CanDispatch",
-	.stack_size = 128 * 8,
-	.priority = (osPriority_t)osPriorityRealtime6,
+	.cb_mem = &can_dispatch_cb,
+	.cb_size = sizeof(can_dispatch_cb),
+	.stack_mem = can_dispatch_stack,
+	.stack_size = sizeof(can_dispatch_stack),
+	.priority = TASK_PRIORITY(CAN_DISPATCH),
 };
 
 void vCanDispatch(void *pv_params)
@@ -107,18 +159,36 @@ void vCanDispatch(void *pv_params)
 
 	CAN_HandleTypeDef *hcan = (CAN_HandleTypeDef *)pv_params;
 
+	supervisor_register(TASK_CAN_DISPATCH);
+
 	for (;;) {
-		osThreadFlagsWait(CAN_DISPATCH_FLAG, osFlagsWaitAny,
-				  osWaitForever);
+		/* Wake up to check in even when there is nothing to send */
+		bool pending = mailbox_wait(&can_outbound_mailbox,
+					    &msg_from_queue,
+					    SUPERVISOR_HEARTBEAT);
+		task_sched_release(TASK_CAN_DISPATCH);
+
 		/* Send CAN message */
-		while (osMessageQueueGet(can_outbound_queue, &msg_from_queue,
-					 NULL, 0U) == osOK) {
+		for (; pending; pending = mailbox_wait(&can_outbound_mailbox,
+						       &msg_from_queue, 0U)) {
+			/* A time sync frame waits until all three transmit mailboxes are empty, so nothing in the controller goes out ahead of it */
+			bool sync = msg_from_queue.id == CANID_TIME_SYNC;
+			uint32_t free = sync ? 3 : 1;
+
 			/* Wait if CAN outbound queue is full */
-			while (HAL_CAN_GetTxMailboxesFreeLevel(hcan) == 0) {
+			while (HAL_CAN_GetTxMailboxesFreeLevel(hcan) < free) {
 				osDelay(1);
 			}
 
+			uint32_t sent = now_us();
 			msg_status = can_send_msg(can1, &msg_from_queue);
+			if (sync && msg_status == HAL_OK)
+				timesync_sent(&msg_from_queue, sent);
+
+			if (msg_status == HAL_OK)
+				stats.tx_frames++;
+			else
+				stats.tx_errors++;
 
 			if (msg_status == HAL_ERROR) {
 				fault_data.diag = "Failed to send CAN message";
@@ -128,14 +198,22 @@ void vCanDispatch(void *pv_params)
 				queue_fault(&fault_data);
 			}
 		}
+
+		task_sched_complete(TASK_CAN_DISPATCH);
 	}
 }
 
 osThreadId_t can_receive_thread;
+static StaticTask_t can_receive_cb CCM_BSS(can_receive_cb);
+static uint32_t can_receive_stack[128 * 8 / sizeof(uint32_t)]
+	CCM_BSS(can_receive_stack);
 const osThreadAttr_t can_receive_attributes = {
 	.name = "CanProcessing",
-	.stack_size = 128 * 8,
-	.priority = (osPriority_t)osPriorityRealtime,
+	.cb_mem = &can_receive_cb,
+	.cb_size = sizeof(can_receive_cb),
+	.stack_mem = can_receive_stack,
+	.stack_size = sizeof(can_receive_stack),
+	.priority = TASK_PRIORITY(CAN_RECEIVE),
 };
 
 void vCanReceive(void *pv_params)
@@ -145,10 +223,9 @@ void vCanReceive(void *pv_params)
 	can_msg_t msg;
 
 	for (;;) {
-		osThreadFlagsWait(NEW_CAN_MSG_FLAG, osFlagsWaitAny,
-				  osWaitForever);
-		while (osOK ==
-		       osMessageQueueGet(can_inbound_queue, &msg, 0U, 0U)) {
+		if (mailbox_wait(&can_inbound_mailbox, &msg, osWaitForever)) {
+			blackbox_record_can(&msg);
+
 			switch (msg.id) {
 			/* Messages Relevant to Motor Controller */
 			case DTI_CANID_ERPM:
@@ -157,6 +234,23 @@ void vCanReceive(void *pv_params)
 			case BMS_DCL_MSG:
 				handle_dcl_msg();
 				break;
+			case CANID_TRACE_REQUEST:
+				handle_trace_request(msg);
+				break;
+			case CANID_XCP_CRO:
+				handle_xcp_command(msg);
+				break;
+			case CANID_PARAM_REQUEST:
+				handle_param_request(msg);
+				break;
+			case CANID_TIME_SYNC:
+				timesync_handle(&msg);
+				break;
+#ifdef PROBE_ENABLE
+			case CANID_PROBE_REQUEST:
+				handle_probe_request(msg);
+				break;
+#endif
 			default:
 				break;
 			}
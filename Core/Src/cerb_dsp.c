@@ -0,0 +1,214 @@
+/**
+ * @file cerb_dsp.c
+ * @brief Fixed point signal processing kernels for sensor filtering.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "cerb_dsp.h"
+#include <assert.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_DSP)
+#include "stm32f4xx.h"
+#define DSP_USE_SIMD 1
+#endif
+
+/**
+ * @brief Saturate an accumulator to 16 bits.
+ */
+static inline int16_t sat_q15(int64_t val)
+{
+	if (val > INT16_MAX)
+		return INT16_MAX;
+	if (val < INT16_MIN)
+		return INT16_MIN;
+	return (int16_t)val;
+}
+
+#ifdef DSP_USE_SIMD
+/**
+ * @brief Load two adjacent int16s as one packed word. The M4 handles the unaligned load in hardware.
+ */
+static inline uint32_t read_pair(const int16_t *ptr)
+{
+	uint32_t val;
+	memcpy(&val, ptr, sizeof(val));
+	return val;
+}
+#endif
+
+void dsp_fir_init(dsp_fir_t *fir, const int16_t *coeffs, int16_t *state,
+		  uint16_t num_taps)
+{
+	assert(fir);
+	assert(coeffs);
+	assert(state);
+	/* Taps are processed in pairs */
+	assert(num_taps && !(num_taps & 1));
+
+	fir->coeffs = coeffs;
+	fir->state = state;
+	fir->num_taps = num_taps;
+	fir->index = 0;
+	memset(state, 0, 2 * num_taps * sizeof(int16_t));
+}
+
+int16_t dsp_fir(dsp_fir_t *fir, int16_t sample)
+{
+	uint16_t n = fir->num_taps;
+
+	/* Newest sample goes in front, and is mirrored so the window is contiguous */
+	fir->index = fir->index ? fir->index - 1 : n - 1;
+	fir->state[fir->index] = sample;
+	fir->state[fir->index + n] = sample;
+
+	const int16_t *x = &fir->state[fir->index];
+	const int16_t *h = fir->coeffs;
+	int64_t acc = 0;
+
+#ifdef DSP_USE_SIMD
+	for (uint16_t i = 0; i < n; i += 2)
+		acc = (int64_t)__SMLALD(read_pair(&h[i]), read_pair(&x[i]),
+					(uint64_t)acc);
+#else
+	for (uint16_t i = 0; i < n; i++)
+		acc += (int32_t)h[i] * x[i];
+#endif
+
+	return sat_q15(acc >> 15);
+}
+
+void dsp_fir_block(dsp_fir_t *fir, const int16_t *in, int16_t *out,
+		   uint16_t len)
+{
+	for (uint16_t i = 0; i < len; i++)
+		out[i] = dsp_fir(fir, in[i]);
+}
+
+void dsp_biquad_init(dsp_biquad_t *biquad, const int16_t coeffs[5])
+{
+	assert(biquad);
+	assert(coeffs);
+
+	memset(biquad, 0, sizeof(dsp_biquad_t));
+	biquad->b[0] = coeffs[0];
+	biquad->b[1] = coeffs[1];
+	biquad->b[2] = coeffs[2];
+	biquad->neg_a[0] = -coeffs[3];
+	biquad->neg_a[1] = -coeffs[4];
+}
+
+int16_t dsp_biquad(dsp_biquad_t *biquad, int16_t sample)
+{
+	int64_t acc = (int32_t)biquad->b[0] * sample;
+
+#ifdef DSP_USE_SIMD
+	acc = (int64_t)__SMLALD(read_pair(&biquad->b[1]),
+				read_pair(biquad->x), (uint64_t)acc);
+	acc = (int64_t)__SMLALD(read_pair(biquad->neg_a), read_pair(biquad->y),
+				(uint64_t)acc);
+#else
+	acc += (int32_t)biquad->b[1] * biquad->x[0] +
+	       (int32_t)biquad->b[2] * biquad->x[1];
+	acc += (int32_t)biquad->neg_a[0] * biquad->y[0] +
+	       (int32_t)biquad->neg_a[1] * biquad->y[1];
+#endif
+
+	int16_t out = sat_q15(acc >> 14);
+
+	biquad->x[1] = biquad->x[0];
+	biquad->x[0] = sample;
+	biquad->y[1] = biquad->y[0];
+	biquad->y[0] = out;
+
+	return out;
+}
+
+void dsp_norm_dual_init(dsp_norm_dual_t *norm, const int16_t offset[2],
+			const int16_t max[2])
+{
+	assert(norm);
+
+	for (uint8_t i = 0; i < 2; i++) {
+		uint32_t span = max[i] - offset[i];
+		/* Gain has to fit in 16 bits */
+		assert(max[i] - offset[i] > 100);
+
+		norm->offset[i] = offset[i];
+		/* Rounded to nearest */
+		norm->gain[i] = ((100UL << 16) + span / 2) / span;
+	}
+}
+
+void dsp_norm_dual(const dsp_norm_dual_t *norm, uint16_t raw_a, uint16_t raw_b,
+		   uint16_t out[2])
+{
+	uint32_t diff_a, diff_b;
+
+#ifdef DSP_USE_SIMD
+	/* Subtract both offsets at once, then clamp both differences to 0 */
+	uint32_t diff = __SSUB16(__PKHBT(raw_a, raw_b, 16),
+				 read_pair(norm->offset));
+	diff = __USAT16(diff, 15);
+	diff_a = diff & 0xFFFF;
+	diff_b = diff >> 16;
+#else
+	int32_t a = (int32_t)raw_a - norm->offset[0];
+	int32_t b = (int32_t)raw_b - norm->offset[1];
+	diff_a = a > 0 ? a : 0;
+	diff_b = b > 0 ? b : 0;
+#endif
+
+	out[0] = (diff_a * norm->gain[0]) >> 16;
+	out[1] = (diff_b * norm->gain[1]) >> 16;
+}
+
+void dsp_stats(const int16_t *buf, uint16_t len, dsp_stats_t *stats)
+{
+	memset(stats, 0, sizeof(dsp_stats_t));
+	if (!len)
+		return;
+
+	int16_t min = buf[0];
+	int16_t max = buf[0];
+	int64_t sum = 0;
+	int64_t sum_sq = 0;
+	uint16_t i = 0;
+
+#ifdef DSP_USE_SIMD
+	for (; i + 1 < len; i += 2) {
+		uint32_t pair = read_pair(&buf[i]);
+		/* Multiplying by packed ones sums both halves */
+		sum = (int64_t)__SMLALD(pair, 0x00010001, (uint64_t)sum);
+		sum_sq = (int64_t)__SMLALD(pair, pair, (uint64_t)sum_sq);
+
+		if (buf[i] < min)
+			min = buf[i];
+		if (buf[i] > max)
+			max = buf[i];
+		if (buf[i + 1] < min)
+			min = buf[i + 1];
+		if (buf[i + 1] > max)
+			max = buf[i + 1];
+	}
+#endif
+
+	for (; i < len; i++) {
+		sum += buf[i];
+		sum_sq += (int32_t)buf[i] * buf[i];
+
+		if (buf[i] < min)
+			min = buf[i];
+		if (buf[i] > max)
+			max = buf[i];
+	}
+
+	stats->min = min;
+	stats->max = max;
+	stats->mean = sum / len;
+	/* Population variance without losing the fractional part of the mean */
+	stats->variance = (sum_sq * len - sum * sum) / ((int64_t)len * len);
+}
@@ -8,6 +8,9 @@
  */
 
 #include "cerb_utils.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
 
 void debounce(bool input, nertimer_t *timer, uint32_t period,
 	      void (*cb)(void *arg), void *arg)
@@ -22,10 +25,29 @@ void debounce(bool input, nertimer_t *timer, uint32_t period,
 	}
 }
 
-osStatus_t queue_and_set_flag(osMessageQueueId_t queue, const void *msg_ptr,
-			      osThreadId_t thread_id, uint32_t flags)
+int format_float(char *buf, size_t len, float value)
 {
-	osStatus_t status = osMessageQueuePut(queue, msg_ptr, 0U, 0U);
-	osThreadFlagsSet(thread_id, flags);
-	return status;
-}
\ No newline at end of file
+	if (isnan(value))
+		return snprintf(buf, len, "nan");
+
+	float mag = fabsf(value);
+	const char *sign = value < 0 ? "-" : "";
+
+	if (mag >= 4294967296.0f)
+		return snprintf(buf, len, "%sinf", sign);
+
+	/* Taking off the whole part is exact, so large values keep every digit */
+	uint32_t whole = (uint32_t)mag;
+	uint32_t thousandths = (uint32_t)((mag - (float)whole) * 1000.0f + 0.5f);
+	if (thousandths == 1000) {
+		whole++;
+		thousandths = 0;
+	}
+
+	/* Don't print -0.000 */
+	if (!whole && !thousandths)
+		sign = "";
+
+	return snprintf(buf, len, "%s%lu.%03lu", sign, (unsigned long)whole,
+			(unsigned long)thousandths);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file clock_profile.c
+ * @brief Startup check for the selected clock profile.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "clock_profile.h"
+#include <stdio.h>
+
+/**
+ * @brief Compare a measured value against what the profile expects, and report it if it is off.
+ *
+ * @return int8_t 1 if the values differ, 0 if they match
+ */
+static int8_t check(const char *name, uint32_t actual, uint32_t expected)
+{
+	if (actual == expected)
+		return 0;
+
+	printf("Clock check: %s is %lu, expected %lu\r\n", name,
+	       (unsigned long)actual, (unsigned long)expected);
+	return 1;
+}
+
+int8_t clock_profile_check(CAN_HandleTypeDef *hcan)
+{
+	int8_t errors = 0;
+
+	errors += check("SYSCLK", HAL_RCC_GetSysClockFreq(), CLOCK_HCLK_HZ);
+	errors += check("HCLK", HAL_RCC_GetHCLKFreq(), CLOCK_HCLK_HZ);
+	errors += check("PCLK1", HAL_RCC_GetPCLK1Freq(), CLOCK_PCLK1_HZ);
+	errors += check("PCLK2", HAL_RCC_GetPCLK2Freq(), CLOCK_PCLK2_HZ);
+	errors += check("flash latency", __HAL_FLASH_GET_LATENCY(),
+			CLOCK_FLASH_LATENCY);
+	errors += check("ART", READ_BIT(FLASH->ACR, FLASH_ACR_PRFTEN |
+							    FLASH_ACR_ICEN |
+							    FLASH_ACR_DCEN),
+			(PREFETCH_ENABLE ? FLASH_ACR_PRFTEN : 0) |
+				(INSTRUCTION_CACHE_ENABLE ? FLASH_ACR_ICEN :
+							    0) |
+				(DATA_CACHE_ENABLE ? FLASH_ACR_DCEN : 0));
+
+	/* Bit time is the sync segment plus both bit segments */
+	uint32_t ts1 = (hcan->Init.TimeSeg1 >> CAN_BTR_TS1_Pos) + 1;
+	uint32_t ts2 = (hcan->Init.TimeSeg2 >> CAN_BTR_TS2_Pos) + 1;
+	errors += check("CAN bitrate",
+			HAL_RCC_GetPCLK1Freq() /
+				(hcan->Init.Prescaler * (1 + ts1 + ts2)),
+			CLOCK_CAN_BITRATE);
+
+	if (!errors)
+		printf("Clock check passed: %lu MHz\r\n",
+		       (unsigned long)(HAL_RCC_GetHCLKFreq() / 1000000));
+
+	return errors;
+}
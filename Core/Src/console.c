@@ -0,0 +1,540 @@
+/**
+ * @file console.c
+ * @brief Command console on the serial port, for looking into and tuning the car while it runs.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "console.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "blackbox.h"
+#include "can_handler.h"
+#include "cerb_utils.h"
+#include "fault.h"
+#include "params.h"
+#include "probe.h"
+#include "queue_stats.h"
+#include "rtos_stats.h"
+#include "serial_monitor.h"
+#include "signals.h"
+#include "state_machine.h"
+#include "task_sched.h"
+#include "timebase.h"
+#include "timesync.h"
+#include "ccmram.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONSOLE_RX_FLAG	  1U
+#define CONSOLE_LINE_LEN  64 /* Characters */
+#define CONSOLE_MAX_ARGS  4
+#define CONSOLE_PRINT_LEN 128 /* Characters */
+
+/* Give up on a line of output if the serial ring stops draining */
+#define CONSOLE_PRINT_TIMEOUT 100 /* ms */
+
+#define CTRL_C	  0x03
+#define BACKSPACE 0x08
+#define DELETE	  0x7F
+
+typedef struct {
+	const char *name;
+	const char *usage;
+	void (*handler)(int argc, char *argv[]);
+} console_cmd_t;
+
+static const char *func_state_names[MAX_FUNC_STATES] = {
+	[READY] = "ready",
+	[F_PIT] = "pit",
+	[F_PERFORMANCE] = "performance",
+	[F_EFFICIENCY] = "efficiency",
+	[REVERSE] = "reverse",
+	[FAULTED] = "faulted",
+};
+
+static const char *nero_state_names[MAX_NERO_STATES] = {
+	[OFF] = "off",
+	[PIT] = "pit",
+	[PERFORMANCE] = "performance",
+	[EFFICIENCY] = "efficiency",
+	[DEBUG] = "debug",
+	[CONFIGURATION] = "configuration",
+	[FLAPPY_BIRD] = "flappy_bird",
+	[EXIT] = "exit",
+};
+
+/* Snapshot for the tasks command, too big for the console's stack */
+static TaskStatus_t tasks[RTOS_STATS_MAX_TASKS];
+
+/**
+ * @brief Print to the serial port, waiting for room in the ring rather than dropping the line. Only the console can afford to wait.
+ */
+static void console_print(const char *format, ...)
+{
+	va_list arg;
+	char buffer[CONSOLE_PRINT_LEN];
+
+	va_start(arg, format);
+	int len = vsnprintf(buffer, sizeof(buffer), format, arg);
+	va_end(arg);
+
+	if (len < 0)
+		return;
+	if (len > (int)sizeof(buffer) - 1)
+		len = sizeof(buffer) - 1;
+
+	for (uint32_t waited = 0; waited < CONSOLE_PRINT_TIMEOUT; waited++) {
+		if (serial_write(buffer, len) == 0)
+			return;
+		osDelay(1);
+	}
+}
+
+/**
+ * @brief Find a name in a table of names.
+ *
+ * @return int Index of the name, or -1 if it is not in the table
+ */
+static int find_name(const char *name, const char *names[], int num_names)
+{
+	for (int i = 0; i < num_names; i++) {
+		if (names[i] && !strcmp(name, names[i]))
+			return i;
+	}
+
+	return -1;
+}
+
+static void cmd_help(int argc, char *argv[]);
+
+static void cmd_tasks(int argc, char *argv[])
+{
+	static const char state_chars[] = { [eRunning] = 'X', [eReady] = 'R',
+					    [eBlocked] = 'B', [eSuspended] = 'S',
+					    [eDeleted] = 'D', [eInvalid] = '?' };
+
+	UBaseType_t num_tasks =
+		uxTaskGetSystemState(tasks, RTOS_STATS_MAX_TASKS, NULL);
+
+	console_print("%-24s state prio stack left (bytes)\r\n", "task");
+	for (UBaseType_t i = 0; i < num_tasks; i++) {
+		console_print("%-24s %c     %-4lu %u\r\n", tasks[i].pcTaskName,
+			      state_chars[tasks[i].eCurrentState],
+			      tasks[i].uxCurrentPriority,
+			      tasks[i].usStackHighWaterMark *
+				      sizeof(StackType_t));
+	}
+}
+
+static void cmd_queues(int argc, char *argv[])
+{
+	console_print("%-24s waiting length high water\r\n", "queue");
+	for (uint32_t i = 0; i < queue_stats_num_queues(); i++) {
+		queue_stats_t stats;
+		queue_stats_get(i, &stats);
+		console_print("%-24s %-7lu %-6lu %lu\r\n",
+			      stats.name ? stats.name : "(unnamed)",
+			      stats.waiting, stats.length, stats.high_water);
+	}
+}
+
+static void cmd_heap(int argc, char *argv[])
+{
+	console_print("heap free %u min %u, serial dropped %lu\r\n",
+		      xPortGetFreeHeapSize(),
+		      xPortGetMinimumEverFreeHeapSize(), serial_dropped());
+}
+
+static void cmd_can(int argc, char *argv[])
+{
+	if (argc != 2 || strcmp(argv[1], "stats")) {
+		cmd_help(1, argv);
+		return;
+	}
+
+	can_stats_t stats;
+	can_get_stats(&stats);
+	console_print("rx %lu dropped %lu\r\n", stats.rx_frames,
+		      stats.rx_dropped);
+	console_print("tx %lu dropped %lu errors %lu\r\n", stats.tx_frames,
+		      stats.tx_dropped, stats.tx_errors);
+	console_print("error counters tx %u rx %u%s\r\n", stats.tx_error_count,
+		      stats.rx_error_count, stats.bus_off ? ", bus off" : "");
+}
+
+static void cmd_faults(int argc, char *argv[])
+{
+	uint32_t now = timebase_local();
+
+	console_print("active 0x%05lx\r\n", fault_active());
+	console_print("%-20s sev count first (ms ago) last (ms ago)\r\n",
+		      "fault");
+	for (uint32_t bit = 0; bit < NUM_FAULTS; bit++) {
+		fault_stats_t stats;
+		fault_get_stats(bit, &stats);
+		if (!stats.count)
+			continue;
+
+		console_print("%-20s %-3u %-5lu %-16lu %lu\r\n",
+			      fault_name(bit), stats.severity, stats.count,
+			      (now - stats.first_local) / 1000,
+			      (now - stats.last_local) / 1000);
+	}
+}
+
+static void cmd_probe(int argc, char *argv[])
+{
+#ifdef PROBE_ENABLE
+	if (argc == 2 && !strcmp(argv[1], "dump")) {
+		probe_dump(false);
+		return;
+	}
+	if (argc == 2 && !strcmp(argv[1], "reset")) {
+		probe_reset();
+		return;
+	}
+
+	cmd_help(1, argv);
+#else
+	console_print("Probes are not built in, build with PROBES=1\r\n");
+#endif
+}
+
+static void print_param(param_id_t id)
+{
+	float min, max;
+	char value_str[16], min_str[16], max_str[16];
+
+	param_limits(id, &min, &max);
+	format_float(value_str, sizeof(value_str), param_get(id));
+	format_float(min_str, sizeof(min_str), min);
+	format_float(max_str, sizeof(max_str), max);
+	console_print("%-18s %s (%s to %s)\r\n", param_name(id), value_str,
+		      min_str, max_str);
+}
+
+static void cmd_param(int argc, char *argv[])
+{
+	if (argc == 2 && !strcmp(argv[1], "get")) {
+		for (param_id_t id = 0; id < NUM_PARAMS; id++)
+			print_param(id);
+		return;
+	}
+
+	int id = argc >= 3 ? param_find(argv[2]) : -1;
+	if (argc >= 3 && id < 0) {
+		console_print("No parameter named %s\r\n", argv[2]);
+		return;
+	}
+
+	if (argc == 3 && !strcmp(argv[1], "get")) {
+		print_param(id);
+		return;
+	}
+
+	if (argc == 4 && !strcmp(argv[1], "set")) {
+		char *end;
+		float value = strtof(argv[3], &end);
+		if (end == argv[3] || *end || param_set(id, value))
+			console_print("%s is not a valid value\r\n", argv[3]);
+		else
+			params_commit();
+		print_param(id);
+		return;
+	}
+
+	if (argc == 2 && !strcmp(argv[1], "save")) {
+		int ret = params_save();
+		if (ret == -1)
+			console_print("Cannot save while the car is active\r\n");
+		else if (ret)
+			console_print("Could not write to flash\r\n");
+		else
+			console_print("Saved\r\n");
+		return;
+	}
+
+	if (argc == 2 && !strcmp(argv[1], "defaults")) {
+		params_defaults();
+		params_commit();
+		console_print("Restored defaults, save to keep them\r\n");
+		return;
+	}
+
+	cmd_help(1, argv);
+}
+
+static void cmd_signals(int argc, char *argv[])
+{
+	console_print("%-12s %-12s version age (ms)\r\n", "signal", "value");
+	for (signal_id_t id = 0; id < NUM_SIGNALS; id++) {
+		signal_sample_t sample;
+		char value[16];
+
+		signal_read(id, &sample);
+		if (!sample.version) {
+			console_print("%-12s never published\r\n",
+				      signal_name(id));
+			continue;
+		}
+
+		signal_format(id, sample.value, value, sizeof(value));
+		console_print("%-12s %-12s %-7lu %lu\r\n", signal_name(id),
+			      value, sample.version,
+			      osKernelGetTickCount() - sample.time);
+	}
+}
+
+static const char *state_name(bool nero, uint8_t state)
+{
+	/* NERO requests can ask for an index past the end of the menu */
+	if (nero)
+		return state < MAX_NERO_STATES ? nero_state_names[state] : "?";
+	return state < MAX_FUNC_STATES ? func_state_names[state] : "?";
+}
+
+static void print_state_trace(void)
+{
+	for (uint32_t i = 0; i < state_trace_num(); i++) {
+		state_trace_t entry;
+		state_trace_get(i, &entry);
+
+		console_print("%-4s %s -> %s: %s, %lu us\r\n",
+			      entry.nero ? "nero" : "func",
+			      state_name(entry.nero, entry.from),
+			      state_name(entry.nero, entry.to),
+			      transition_result_name(entry.result),
+			      entry.latency);
+	}
+}
+
+static void cmd_state(int argc, char *argv[])
+{
+	if (argc == 2 && !strcmp(argv[1], "trace")) {
+		print_state_trace();
+		return;
+	}
+
+	if (argc == 1) {
+		nero_state_t nero = get_nero_state();
+		console_print("functional %s, nero %s%s\r\n",
+			      func_state_names[get_func_state()],
+			      nero_state_names[nero.nero_index],
+			      nero.home_mode ? " (home)" : "");
+		return;
+	}
+
+	int ret = -1;
+	if (argc == 3 && !strcmp(argv[1], "func")) {
+		int state = find_name(argv[2], func_state_names,
+				      MAX_FUNC_STATES);
+		if (state >= 0)
+			ret = request_func_state(state);
+	} else if ((argc == 3 || argc == 4) && !strcmp(argv[1], "nero")) {
+		int index = find_name(argv[2], nero_state_names,
+				      MAX_NERO_STATES);
+		if (index >= 0 && (argc == 3 || !strcmp(argv[3], "home")))
+			ret = request_nero_state((nero_state_t){
+				.nero_index = index, .home_mode = argc == 4 });
+	} else {
+		cmd_help(1, argv);
+		return;
+	}
+
+	/* The director can still refuse the transition, check with "state" */
+	console_print(ret ? "Could not request %s\r\n" : "Requested %s\r\n",
+		      argv[2]);
+}
+
+static void cmd_blackbox(int argc, char *argv[])
+{
+	if (argc == 1) {
+		const blackbox_header_t *saved = blackbox_saved();
+		if (!saved) {
+			console_print("No dump saved\r\n");
+			return;
+		}
+
+		console_print(
+			"Dump of fault 0x%05lx at %lu us, %lu samples %lu CAN frames\r\n",
+			saved->fault, saved->time, saved->num_samples,
+			saved->num_can);
+		return;
+	}
+
+	if (argc == 2 && !strcmp(argv[1], "save")) {
+		blackbox_freeze(0);
+		console_print("Saving, check back with blackbox\r\n");
+		return;
+	}
+
+	if (argc == 2 && !strcmp(argv[1], "clear")) {
+		int ret = blackbox_clear();
+		if (ret == -1)
+			console_print(
+				"Cannot clear while the car is active or saving\r\n");
+		else if (ret)
+			console_print("Could not erase flash\r\n");
+		else
+			console_print("Cleared\r\n");
+		return;
+	}
+
+	cmd_help(1, argv);
+}
+
+static void cmd_time(int argc, char *argv[])
+{
+	timesync_status_t status;
+	timesync_get_status(&status);
+	uint32_t now = now_us();
+
+	console_print("bus %lu us local %lu us\r\n", now, timebase_local());
+	console_print("%s, %s, %lu syncs", status.master ? "master" : "slave",
+		      status.synced ? "synced" : "not synced", status.syncs);
+	if (status.syncs)
+		console_print(", last %lu ms ago", (now - status.last) / 1000);
+	if (!status.master && status.syncs)
+		console_print(", error %ld us", status.error);
+	console_print("\r\n");
+}
+
+static const console_cmd_t commands[] = {
+	{ "help", "help", cmd_help },
+	{ "tasks", "tasks", cmd_tasks },
+	{ "queues", "queues", cmd_queues },
+	{ "heap", "heap", cmd_heap },
+	{ "can", "can stats", cmd_can },
+	{ "faults", "faults", cmd_faults },
+	{ "probe", "probe dump|reset", cmd_probe },
+	{ "param",
+	  "param get [name] | param set <name> <value> | param save | param defaults",
+	  cmd_param },
+	{ "signals", "signals", cmd_signals },
+	{ "state", "state [func <state> | nero <state> [home] | trace]",
+	  cmd_state },
+	{ "blackbox", "blackbox [save | clear]", cmd_blackbox },
+	{ "time", "time", cmd_time },
+};
+
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+/**
+ * @brief Print the usage of one command, or of all of them if it is not a command.
+ */
+static void cmd_help(int argc, char *argv[])
+{
+	for (uint32_t i = 0; i < NUM_COMMANDS; i++) {
+		if (argc == 1 && !strcmp(argv[0], commands[i].name) &&
+		    commands[i].handler != cmd_help) {
+			console_print("usage: %s\r\n", commands[i].usage);
+			return;
+		}
+	}
+
+	for (uint32_t i = 0; i < NUM_COMMANDS; i++)
+		console_print("  %s\r\n", commands[i].usage);
+}
+
+/**
+ * @brief Split a line into words and run the command it names.
+ */
+static void run_line(char *line)
+{
+	char *argv[CONSOLE_MAX_ARGS];
+	int argc = 0;
+
+	for (char *word = strtok(line, " \t"); word;
+	     word = strtok(NULL, " \t")) {
+		if (argc == CONSOLE_MAX_ARGS) {
+			console_print("Too many arguments\r\n");
+			return;
+		}
+		argv[argc++] = word;
+	}
+
+	if (argc == 0)
+		return;
+
+	for (uint32_t i = 0; i < NUM_COMMANDS; i++) {
+		if (!strcmp(argv[0], commands[i].name)) {
+			commands[i].handler(argc, argv);
+			return;
+		}
+	}
+
+	console_print("Unknown command %s, try help\r\n", argv[0]);
+}
+
+osThreadId_t console_handle;
+static StaticTask_t console_cb CCM_BSS(console_cb);
+static uint32_t console_stack[128 * 8 / sizeof(uint32_t)]
+	CCM_BSS(console_stack);
+const osThreadAttr_t console_attributes = {
+	.name = "Console",
+	.cb_mem = &console_cb,
+	.cb_size = sizeof(console_cb),
+	.stack_mem = console_stack,
+	.stack_size = sizeof(console_stack),
+	.priority = TASK_PRIORITY(CONSOLE),
+};
+
+void vConsole(void *pv_params)
+{
+	char line[CONSOLE_LINE_LEN];
+	uint32_t len = 0;
+	uint8_t last = 0;
+
+	serial_set_reader(osThreadGetId(), CONSOLE_RX_FLAG);
+	console_print("\r\n> ");
+
+	for (;;) {
+		uint8_t c;
+		if (!serial_read(&c)) {
+			osThreadFlagsWait(CONSOLE_RX_FLAG, osFlagsWaitAny,
+					  osWaitForever);
+			continue;
+		}
+
+		uint8_t prev = last;
+		last = c;
+
+		switch (c) {
+		case '\n':
+			/* Terminals end lines with either or both */
+			if (prev == '\r')
+				break;
+			/* fall through */
+		case '\r':
+			console_print("\r\n");
+			line[len] = '\0';
+			run_line(line);
+			len = 0;
+			console_print("> ");
+			break;
+		case BACKSPACE:
+		case DELETE:
+			if (len) {
+				len--;
+				console_print("\b \b");
+			}
+			break;
+		case CTRL_C:
+			len = 0;
+			console_print("^C\r\n> ");
+			break;
+		default:
+			/* Ignore control characters and anything past the end of the line */
+			if (c < ' ' || c > '~' || len == CONSOLE_LINE_LEN - 1)
+				break;
+			line[len++] = c;
+			serial_write(&c, 1);
+			break;
+		}
+	}
+}
@@ -14,7 +14,7 @@
 #include "emrax.h"
 #include "fault.h"
 #include "c_utils.h"
-#include <math.h>
+#include "cerb_math.h"
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,28 +22,37 @@
 #include "bms.h"
 #include "serial_monitor.h"
 #include "nero.h"
+#include "ccmram.h"
+#include "probe.h"
+#include "signals.h"
 
 #define CAN_QUEUE_SIZE 5 /* messages */
 #define SAMPLES	       20
-static osMutexAttr_t dti_mutex_attributes;
 
-dti_t *dti_init()
-{
-	dti_t *mc = malloc(sizeof(dti_t));
-	assert(mc);
+/* Wheel RPM to MPH: revolutions per hour times tire circumference in miles */
+#define RPM_TO_MPH \
+	(60 * TIRE_DIAMETER * PI_F / (GEAR_RATIO * INCHES_PER_MILE_F))
+
+static dti_t mc_data;
 
-	/* Create Mutex */
-	mc->mutex = osMutexNew(&dti_mutex_attributes);
-	assert(mc->mutex);
+/* Last torque target and current command sent, kept in memory so XCP can measure them */
+static volatile int16_t commanded_torque;
+static volatile int16_t commanded_current;
 
-	return mc;
+dti_t *dti_init()
+{
+	return &mc_data;
 }
 
 void dti_set_torque(int16_t torque)
 {
+	PROBE_START(DTI_SET_TORQUE);
+
+	commanded_torque = torque;
+
 	/* We can't change motor speed super fast else we blow diff, therefore low pass filter */
 	// Static variables for the buffer and index
-	static float buffer[SAMPLES] = { 0 };
+	static float buffer[SAMPLES] CCM_BSS(torque_filter_buffer);
 	static int index = 0;
 
 	// Add the new value to the buffer
@@ -53,7 +62,7 @@ void dti_set_torque(int16_t torque)
 	index = (index + 1) % SAMPLES;
 
 	// Calculate the average of the buffer
-	float sum = 0.0;
+	float sum = 0.0f;
 	for (int i = 0; i < SAMPLES; ++i) {
 		sum += buffer[i];
 	}
@@ -64,11 +73,20 @@ void dti_set_torque(int16_t torque)
 	}
 
 	/* Motor controller expects AC current target to be received as multiplied by 10 */
-	int16_t ac_current = (((float)average / EMRAX_KT) * 10);
+	int16_t ac_current = (int16_t)((average / EMRAX_KT) * 10);
+	commanded_current = ac_current;
 
 	// serial_print("Commanded Current: %d \r\n", ac_current);
 
 	dti_set_current(ac_current);
+
+	PROBE_END(DTI_SET_TORQUE);
+}
+
+void dti_get_command(int16_t *torque, int16_t *current)
+{
+	*torque = commanded_torque;
+	*current = commanded_current;
 }
 
 void dti_set_regen(uint16_t current_target)
@@ -76,7 +94,7 @@ void dti_set_regen(uint16_t current_target)
 	/* Simple moving average to smooth change in braking target */
 
 	// Static variables for the buffer and index
-	static uint16_t buffer[SAMPLES] = { 0 };
+	static uint16_t buffer[SAMPLES] CCM_BSS(regen_filter_buffer);
 	static int index = 0;
 
 	// Add the new value to the buffer
@@ -246,25 +264,12 @@ void dti_set_drive_enable(bool drive_enable)
 
 int32_t dti_get_rpm(dti_t *mc)
 {
-	int32_t rpm;
-	osMutexAcquire(*mc->mutex, osWaitForever);
-	rpm = mc->rpm;
-	//printf("Rpm %ld",rpm);
-	osMutexRelease(*mc->mutex);
-
-	return rpm;
+	return signal_get(SIGNAL_RPM).i;
 }
 
 float dti_get_mph(dti_t *mc)
 {
-	/* Convert RPM to MPH */
-	// rpm * gear ratio = wheel rpm
-	// tire diamter (in) to miles --> tire diamter miles
-	// wheel rpm * 60 --> wheel rph
-	// tire diamter miles * pi --> tire circumference
-	// rph * wheel circumference miles --> mph
-	return (dti_get_rpm(mc) / (GEAR_RATIO)) * 60 *
-	       (TIRE_DIAMETER / 63360.0) * M_PI;
+	return signal_get(SIGNAL_MPH).f;
 }
 
 void dti_record_rpm(dti_t *mc, can_msg_t msg)
@@ -274,9 +279,17 @@ void dti_record_rpm(dti_t *mc, can_msg_t msg)
 		       (msg.data[2] << 8) + (msg.data[3]);
 
 	int32_t rpm = erpm / POLE_PAIRS;
-
-	osMutexAcquire(*mc->mutex, osWaitForever);
 	mc->rpm = rpm;
-	osMutexRelease(*mc->mutex);
-	set_mph(dti_get_mph(mc));
+
+	/* Convert RPM to MPH */
+	// rpm / gear ratio = wheel rpm
+	// wheel rpm * 60 --> wheel rph
+	// tire diameter (in) * pi / inches per mile --> tire circumference in miles
+	// rph * wheel circumference miles --> mph
+	// everything but the rpm folds into one constant at compile time
+	float mph = rpm * RPM_TO_MPH;
+
+	signal_publish(SIGNAL_RPM, (signal_value_t){ .i = rpm });
+	signal_publish(SIGNAL_MPH, (signal_value_t){ .f = mph });
+	set_mph(mph);
 }
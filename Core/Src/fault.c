@@ -8,74 +8,236 @@
 #include <string.h>
 #include "c_utils.h"
 #include "cerb_utils.h"
+#include "mailbox.h"
+#include "task_sched.h"
+#include "ccmram.h"
+#include "trace.h"
+#include "log.h"
+#include "blackbox.h"
+#include "timebase.h"
 
 #define FAULT_HANDLE_QUEUE_SIZE 16
-#define NEW_FAULT_FLAG		1U
 
-osMessageQueueId_t fault_handle_queue;
+static mailbox_t fault_mailbox;
+static uint8_t fault_mailbox_buf[MAILBOX_BUF_SIZE(FAULT_HANDLE_QUEUE_SIZE,
+						  fault_data_t)];
+
+/* Written by whoever raises the fault, the severity is cleared by the handler */
+static volatile fault_stats_t records[NUM_FAULTS];
+
+/* Only touched by the fault handler */
+static volatile uint32_t active;
+
+/* What each severity does to the car, from most to least severe */
+static const struct {
+	bool fault_car; /* Enter the FAULTED state */
+	bool freeze; /* Keep the trace and black box leading up to the fault */
+} escalation[DEFCON5 + 1] = {
+	[DEFCON1] = { .fault_car = true, .freeze = true },
+	[DEFCON2] = { .fault_car = true, .freeze = true },
+	[DEFCON3] = { .fault_car = true, .freeze = true },
+	[DEFCON4] = { .fault_car = false, .freeze = false },
+	[DEFCON5] = { .fault_car = false, .freeze = false },
+};
+
+/* Indexed by the fault's bit in fault_code_t */
+static const char *fault_names[NUM_FAULTS] = {
+	"onboard_temp",
+	"onboard_pedal",
+	"imu",
+	"can_dispatch",
+	"can_routing",
+	"fuse_monitor",
+	"shutdown_monitor",
+	"dti_routing",
+	"steeringio_routing",
+	"state_received",
+	"invalid_transition",
+	"bms_can_monitor",
+	"bspd_prefault",
+	"lv_monitor",
+	"rtds",
+	"deadline_miss",
+	"buttons_monitor",
+};
 
 osStatus_t queue_fault(fault_data_t *fault_data)
 {
-	if (!fault_handle_queue)
-		return -1;
+	if (!fault_data->id || fault_data->id >= MAX_FAULTS ||
+	    (fault_data->id & (fault_data->id - 1)) ||
+	    fault_data->severity < DEFCON1 || fault_data->severity > DEFCON5)
+		return osErrorParameter;
+
+	volatile fault_stats_t *record = &records[__builtin_ctz(fault_data->id)];
+	uint32_t local = timebase_local();
+	uint32_t now = now_us();
+
+	/* Raised from many tasks and interrupts */
+	if (!__atomic_fetch_add(&record->count, 1, __ATOMIC_RELAXED)) {
+		record->first = now;
+		record->first_local = local;
+	}
+	record->last = now;
+	__atomic_store_n(&record->last_local, local, __ATOMIC_RELEASE);
+
+	/* Only tell the handler about a new fault, or one that got more severe */
+	uint8_t severity = __atomic_load_n(&record->severity, __ATOMIC_RELAXED);
+	do {
+		if (severity && severity <= fault_data->severity)
+			return osOK;
+	} while (!__atomic_compare_exchange_n(&record->severity, &severity,
+					      fault_data->severity, true,
+					      __ATOMIC_RELAXED,
+					      __ATOMIC_RELAXED));
+
+	if (mailbox_post(&fault_mailbox, fault_data)) {
+		/* Let the next raise try again */
+		__atomic_store_n(&record->severity, 0, __ATOMIC_RELAXED);
+		return osErrorResource;
+	}
+
+	return osOK;
+}
 
-	return queue_and_set_flag(fault_handle_queue, fault_data, fault_handle,
-				  NEW_FAULT_FLAG);
+uint32_t fault_active(void)
+{
+	return active;
+}
+
+bool fault_car_active(void)
+{
+	uint32_t mask = active;
+
+	for (uint32_t bit = 0; bit < NUM_FAULTS; bit++) {
+		uint8_t severity = records[bit].severity;
+		if ((mask & (1U << bit)) && severity &&
+		    escalation[severity].fault_car)
+			return true;
+	}
+
+	return false;
+}
+
+void fault_get_stats(uint32_t bit, fault_stats_t *stats)
+{
+	stats->count = records[bit].count;
+	stats->first = records[bit].first;
+	stats->last = records[bit].last;
+	stats->first_local = records[bit].first_local;
+	stats->last_local = records[bit].last_local;
+	stats->severity = records[bit].severity;
+}
+
+const char *fault_name(uint32_t bit)
+{
+	return fault_names[bit];
 }
 
 osThreadId_t fault_handle;
+static StaticTask_t fault_handle_cb CCM_BSS(fault_handle_cb);
+static uint32_t fault_handle_stack[32 * 16 / sizeof(uint32_t)]
+	CCM_BSS(fault_handle_stack);
 const osThreadAttr_t fault_handle_attributes = {
 	.name = "FaultHandler",
-	.stack_size = 32 * 16,
-	.priority = (osPriority_t)osPriorityRealtime7,
+	.cb_mem = &fault_handle_cb,
+	.cb_size = sizeof(fault_handle_cb),
+	.stack_mem = fault_handle_stack,
+	.stack_size = sizeof(fault_handle_stack),
+	.priority = TASK_PRIORITY(FAULT_HANDLER),
 };
 
+void fault_init()
+{
+	mailbox_init(&fault_mailbox, "FaultQueue", fault_mailbox_buf,
+		     FAULT_HANDLE_QUEUE_SIZE, sizeof(fault_data_t));
+}
+
+/**
+ * @brief Activate a new fault, or escalate an active one.
+ */
+static void handle_fault(const fault_data_t *fault_data)
+{
+	if (!(active & fault_data->id))
+		LOG("\r\nFault Handler! Diagnostic Info:\t%s\r\n\r\n",
+		    fault_data->diag);
+	active |= fault_data->id;
+
+	if (escalation[fault_data->severity].freeze) {
+		trace_freeze();
+		blackbox_freeze(fault_data->id);
+	}
+	if (escalation[fault_data->severity].fault_car)
+		fault();
+}
+
+/**
+ * @brief Clear every active fault that has not been raised for FAULT_CLEAR_TIME.
+ *
+ * @return bool True if any fault was cleared
+ */
+static bool clear_faults(void)
+{
+	uint32_t cleared = 0;
+
+	for (uint32_t bit = 0; bit < NUM_FAULTS; bit++) {
+		if (!(active & (1U << bit)))
+			continue;
+
+		/* Read after last, and signed, since a fault can be raised from an interrupt in between. Local time, as bus time can be stepped back */
+		uint32_t last = __atomic_load_n(&records[bit].last_local,
+						__ATOMIC_ACQUIRE);
+		uint32_t now = timebase_local();
+		if ((int32_t)(now - last) >= FAULT_CLEAR_TIME * 1000) {
+			cleared |= 1U << bit;
+			__atomic_store_n(&records[bit].severity, 0,
+					 __ATOMIC_RELAXED);
+		}
+	}
+
+	active &= ~cleared;
+	return cleared;
+}
+
+static void send_status(void)
+{
+	can_msg_t msg = { .id = CANID_FAULT_MSG, .len = 8, .data = { 0 } };
+	uint32_t mask = active;
+	uint8_t severity = 0;
+
+	for (uint32_t bit = 0; bit < NUM_FAULTS; bit++) {
+		uint8_t fault_severity = records[bit].severity;
+		if ((mask & (1U << bit)) && fault_severity &&
+		    (!severity || fault_severity < severity))
+			severity = fault_severity;
+	}
+
+	endian_swap(&mask, sizeof(mask));
+	memcpy(msg.data, &mask, sizeof(mask));
+	msg.data[4] = severity;
+
+	queue_can_msg(msg);
+}
+
 void vFaultHandler(void *pv_params)
 {
 	fault_data_t fault_data;
-	fault_handle_queue = osMessageQueueNew(FAULT_HANDLE_QUEUE_SIZE,
-					       sizeof(fault_data_t), NULL);
+	uint32_t next_status = HAL_GetTick();
 
 	for (;;) {
-		osThreadFlagsWait(NEW_FAULT_FLAG, osFlagsWaitAny,
-				  osWaitForever);
-
-		while (osMessageQueueGet(fault_handle_queue, &fault_data, NULL,
-					 osWaitForever) == osOK) {
-			uint32_t fault_id = (uint32_t)fault_data.id;
-			endian_swap(&fault_id, sizeof(fault_id));
-			uint8_t defcon = (uint8_t)fault_data.severity;
-
-			can_msg_t msg;
-			msg.id = CANID_FAULT_MSG;
-			msg.len = 8;
-
-			memcpy(msg.data, &fault_id, sizeof(fault_id));
-			memcpy(msg.data + sizeof(fault_id), &defcon,
-			       sizeof(defcon));
-
-			queue_can_msg(msg);
-			serial_print(
-				"\r\nFault Handler! Diagnostic Info:\t%s\r\n\r\n",
-				fault_data.diag);
-
-			switch (fault_data.severity) {
-			case DEFCON1: /* Highest(1st) Priority */
-				fault();
-				break;
-			case DEFCON2:
-				fault();
-				break;
-			case DEFCON3:
-				fault();
-				break;
-			case DEFCON4:
-				break;
-			case DEFCON5: /* Lowest Priority */
-				break;
-			default:
-				break;
-			}
+		/* Wake up for the keepalive even when nothing is raised */
+		int32_t until_status = next_status - HAL_GetTick();
+		bool changed = mailbox_wait(&fault_mailbox, &fault_data,
+					    until_status > 0 ? until_status :
+							       0);
+		if (changed)
+			handle_fault(&fault_data);
+
+		changed |= clear_faults();
+
+		uint32_t now = HAL_GetTick();
+		if (changed || (int32_t)(now - next_status) >= 0) {
+			send_status();
+			next_status = now + FAULT_STATUS_PERIOD;
 		}
 	}
-}
\ No newline at end of file
+}
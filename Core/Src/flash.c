@@ -0,0 +1,98 @@
+/**
+ * @file flash.c
+ * @brief Erasing and programming the internal flash.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "flash.h"
+#include "cmsis_os.h"
+#include "stm32f4xx_hal.h"
+#include <assert.h>
+#include <string.h>
+
+static osMutexId_t flash_mutex;
+static StaticSemaphore_t flash_mutex_cb;
+static const osMutexAttr_t flash_mutex_attributes = {
+	.name = "FlashMutex",
+	.cb_mem = &flash_mutex_cb,
+	.cb_size = sizeof(flash_mutex_cb),
+};
+
+void flash_init(void)
+{
+	flash_mutex = osMutexNew(&flash_mutex_attributes);
+	assert(flash_mutex);
+}
+
+static void flash_acquire(void)
+{
+	osMutexAcquire(flash_mutex, osWaitForever);
+	HAL_FLASH_Unlock();
+	__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR |
+			       FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR |
+			       FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR);
+}
+
+static void flash_release(void)
+{
+	HAL_FLASH_Lock();
+
+	/* The data cache may still hold what was there before */
+	__HAL_FLASH_DATA_CACHE_DISABLE();
+	__HAL_FLASH_DATA_CACHE_RESET();
+	__HAL_FLASH_DATA_CACHE_ENABLE();
+
+	osMutexRelease(flash_mutex);
+}
+
+int flash_erase(uint32_t sector)
+{
+	FLASH_EraseInitTypeDef erase = {
+		.TypeErase = FLASH_TYPEERASE_SECTORS,
+		.Sector = sector,
+		.NbSectors = 1,
+		.VoltageRange = FLASH_VOLTAGE_RANGE_3,
+	};
+	uint32_t sector_error;
+
+	flash_acquire();
+	HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &sector_error);
+	flash_release();
+
+	return status == HAL_OK ? 0 : -1;
+}
+
+int flash_program(uint32_t addr, const void *data, uint32_t len)
+{
+	const uint32_t *words = data;
+	int ret = 0;
+
+	flash_acquire();
+	for (uint32_t i = 0; i < len / sizeof(uint32_t); i++) {
+		if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD,
+				      addr + i * sizeof(uint32_t),
+				      words[i]) != HAL_OK) {
+			ret = -1;
+			break;
+		}
+	}
+	flash_release();
+
+	if (ret)
+		return ret;
+	return memcmp((const void *)addr, data, len) ? -1 : 0;
+}
+
+bool flash_erased(uint32_t addr, uint32_t len)
+{
+	for (uint32_t offset = 0; offset < len; offset += sizeof(uint32_t)) {
+		if (*(const volatile uint32_t *)(addr + offset) !=
+		    FLASH_ERASED_WORD)
+			return false;
+	}
+
+	return true;
+}
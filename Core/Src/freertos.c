@@ -87,6 +87,15 @@ void vApplicationMallocFailedHook(void)
 
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
+/* newlib's malloc is shared by every task, so lock the scheduler around it now that tasks can preempt each other */
+void __malloc_lock(struct _reent *r)
+{
+	vTaskSuspendAll();
+}
 
+void __malloc_unlock(struct _reent *r)
+{
+	(void)xTaskResumeAll();
+}
 /* USER CODE END Application */
 
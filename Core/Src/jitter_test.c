@@ -0,0 +1,129 @@
+/**
+ * @file jitter_test.c
+ * @brief On target test that the pedal loop keeps its period while the serial console and I2C tasks are saturated. Built with make JITTER_TEST=1, see Test/renode/sched_jitter.robot.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifdef TASK_SCHED_JITTER_TEST
+
+#include "task_sched.h"
+#include "ccmram.h"
+#include "serial_monitor.h"
+#include <assert.h>
+#include <stdbool.h>
+
+#define JITTER_TEST_SETTLE    1000 /* ms */
+#define JITTER_TEST_DURATION  5000 /* ms */
+#define JITTER_TEST_TOLERANCE 1000 /* us either side of the period */
+
+static volatile bool loaded;
+
+static void vSerialLoad(void *pv_params)
+{
+	uint32_t count = 0;
+
+	/* Keeps the serial ring full, and the UART DMA always running */
+	while (loaded)
+		serial_print("Jitter test load %lu\r\n", count++);
+
+	osThreadExit();
+}
+
+static void vI2CLoad(void *pv_params)
+{
+	jitter_test_args_t *args = (jitter_test_args_t *)pv_params;
+	uint16_t temp, humidity;
+	bool tsms;
+
+	/* Both buses back to back, including the PDU the pedal task writes the brakelight to */
+	while (loaded) {
+		read_tsms_sense(args->pdu, &tsms);
+		read_temp_sensor(args->mpu, &temp, &humidity);
+	}
+
+	osThreadExit();
+}
+
+osThreadId_t jitter_test_handle;
+static StaticTask_t jitter_test_cb CCM_BSS(jitter_test_cb);
+static uint32_t jitter_test_stack[128 * 4 / sizeof(uint32_t)]
+	CCM_BSS(jitter_test_stack);
+const osThreadAttr_t jitter_test_attributes = {
+	.name = "JitterTest",
+	.cb_mem = &jitter_test_cb,
+	.cb_size = sizeof(jitter_test_cb),
+	.stack_mem = jitter_test_stack,
+	.stack_size = sizeof(jitter_test_stack),
+	/* Only wakes up to start and stop the test */
+	.priority = (osPriority_t)osPriorityRealtime7,
+};
+
+static StaticTask_t serial_load_cb CCM_BSS(serial_load_cb);
+static uint32_t serial_load_stack[128 * 4 / sizeof(uint32_t)]
+	CCM_BSS(serial_load_stack);
+static const osThreadAttr_t serial_load_attributes = {
+	.name = "SerialLoad",
+	.cb_mem = &serial_load_cb,
+	.cb_size = sizeof(serial_load_cb),
+	.stack_mem = serial_load_stack,
+	.stack_size = sizeof(serial_load_stack),
+	.priority = TASK_PRIORITY(TRACE_DUMP),
+};
+
+static StaticTask_t i2c_load_cb CCM_BSS(i2c_load_cb);
+static uint32_t i2c_load_stack[128 * 4 / sizeof(uint32_t)]
+	CCM_BSS(i2c_load_stack);
+static const osThreadAttr_t i2c_load_attributes = {
+	.name = "I2CLoad",
+	.cb_mem = &i2c_load_cb,
+	.cb_size = sizeof(i2c_load_cb),
+	.stack_mem = i2c_load_stack,
+	.stack_size = sizeof(i2c_load_stack),
+	.priority = TASK_PRIORITY(DATA_COLLECTION),
+};
+
+void vJitterTest(void *pv_params)
+{
+	task_sched_stats_t stats;
+
+	osDelay(JITTER_TEST_SETTLE);
+
+	loaded = true;
+	osThreadId_t serial_load =
+		osThreadNew(vSerialLoad, NULL, &serial_load_attributes);
+	assert(serial_load);
+	osThreadId_t i2c_load =
+		osThreadNew(vI2CLoad, pv_params, &i2c_load_attributes);
+	assert(i2c_load);
+
+	/* Only count periods that ran entirely under load */
+	osDelay(TASK_PERIOD(PEDALS));
+	task_sched_reset_stats(TASK_PEDALS);
+	osDelay(JITTER_TEST_DURATION);
+	task_sched_get_stats(TASK_PEDALS, &stats);
+
+	/* Let the serial ring drain before reporting */
+	loaded = false;
+	osDelay(JITTER_TEST_SETTLE);
+
+	uint32_t period = TASK_PERIOD(PEDALS) * 1000; /* us */
+	uint32_t min = task_sched_cycles_to_us(stats.min_period);
+	uint32_t max = task_sched_cycles_to_us(stats.max_period);
+
+	serial_print("Pedal period min %lu us max %lu us over %lu releases\r\n",
+		     min, max, stats.releases);
+
+	/* A missing release would show up as a period twice as long */
+	if (stats.releases > 1 && min + JITTER_TEST_TOLERANCE >= period &&
+	    max <= period + JITTER_TEST_TOLERANCE)
+		serial_print("Jitter test passed\r\n");
+	else
+		serial_print("Jitter test failed\r\n");
+
+	osThreadExit();
+}
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file log.c
+ * @brief Deferred logging.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "log.h"
+
+#ifndef LOG_TEXT
+#include "serial_monitor.h"
+#include "timebase.h"
+
+#define LOG_HEADER_LEN 6 /* bytes, id and timestamp */
+#define LOG_RECORD_LEN (LOG_HEADER_LEN + LOG_MAX_ARGS * sizeof(uint32_t))
+
+/* COBS adds a byte per 254, plus the start marker and the terminating 0 */
+#define LOG_FRAME_LEN (1 + LOG_RECORD_LEN + LOG_RECORD_LEN / 254 + 1 + 1)
+
+/**
+ * @brief COBS encode a record, so it contains no 0 bytes.
+ *
+ * @param src The record
+ * @param len Length of the record
+ * @param dst Buffer of at least len + len / 254 + 1 bytes
+ * @return size_t Length of the encoding
+ */
+static size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst)
+{
+	size_t code_at = 0;
+	size_t out = 1;
+	uint8_t code = 1;
+
+	for (size_t i = 0; i < len; i++) {
+		if (src[i]) {
+			dst[out++] = src[i];
+			code++;
+		}
+
+		if (!src[i] || code == 0xFF) {
+			dst[code_at] = code;
+			code_at = out++;
+			code = 1;
+		}
+	}
+
+	dst[code_at] = code;
+	return out;
+}
+
+int log_write(uint16_t id, const uint32_t *args, uint32_t num_args)
+{
+	uint8_t record[LOG_RECORD_LEN];
+	uint8_t frame[LOG_FRAME_LEN];
+
+	if (num_args > LOG_MAX_ARGS)
+		num_args = LOG_MAX_ARGS;
+
+	/* Works before the scheduler starts and from interrupts */
+	uint32_t timestamp = now_us();
+
+	record[0] = id & 0xFF;
+	record[1] = (id >> 8) & 0xFF;
+	record[2] = timestamp & 0xFF;
+	record[3] = (timestamp >> 8) & 0xFF;
+	record[4] = (timestamp >> 16) & 0xFF;
+	record[5] = (timestamp >> 24) & 0xFF;
+	memcpy(&record[LOG_HEADER_LEN], args, num_args * sizeof(uint32_t));
+
+	size_t len = LOG_HEADER_LEN + num_args * sizeof(uint32_t);
+	frame[0] = LOG_RECORD_START;
+	len = 1 + cobs_encode(record, len, &frame[1]);
+	frame[len++] = 0;
+
+	return serial_write(frame, len);
+}
+
+#endif
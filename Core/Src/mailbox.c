@@ -0,0 +1,54 @@
+/**
+ * @file mailbox.c
+ * @brief Fixed size message passing between tasks and from interrupts, one kernel call to send and one to receive.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "mailbox.h"
+#include <assert.h>
+
+void mailbox_init(mailbox_t *mailbox, const char *name, uint8_t *buf,
+		  uint32_t len, uint32_t msg_size)
+{
+	mailbox->queue =
+		xQueueCreateStatic(len, msg_size, buf, &mailbox->cb);
+	assert(mailbox->queue);
+	vQueueAddToRegistry(mailbox->queue, name);
+}
+
+int mailbox_post(mailbox_t *mailbox, const void *msg)
+{
+	if (xPortIsInsideInterrupt())
+		return mailbox_post_from_isr(mailbox, msg);
+
+	if (!mailbox->queue)
+		return -1;
+
+	return xQueueSendToBack(mailbox->queue, msg, 0) == pdPASS ? 0 : -1;
+}
+
+int mailbox_post_from_isr(mailbox_t *mailbox, const void *msg)
+{
+	BaseType_t woken = pdFALSE;
+
+	if (!mailbox->queue)
+		return -1;
+
+	BaseType_t ret = xQueueSendToBackFromISR(mailbox->queue, msg, &woken);
+	portYIELD_FROM_ISR(woken);
+
+	return ret == pdPASS ? 0 : -1;
+}
+
+uint32_t mailbox_space(mailbox_t *mailbox)
+{
+	return uxQueueSpacesAvailable(mailbox->queue);
+}
+
+bool mailbox_wait(mailbox_t *mailbox, void *msg, uint32_t timeout)
+{
+	return xQueueReceive(mailbox->queue, msg, timeout) == pdPASS;
+}
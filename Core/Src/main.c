@@ -40,9 +40,22 @@
 #include "dti.h"
 #include "steeringio.h"
 #include "pedals.h"
+#include "clock_profile.h"
+#include "task_sched.h"
+#include "rtos_stats.h"
+#include "trace_dump.h"
+#include "supervisor.h"
+#include "console.h"
+#include "xcp_can.h"
+#include "params.h"
+#include "flash.h"
+#include "blackbox.h"
+#include "timebase.h"
+#include "timesync.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
+typedef StaticTask_t osStaticThreadDef_t;
 /* USER CODE BEGIN PTD */
 
 /* USER CODE END PTD */
@@ -62,6 +75,7 @@ ADC_HandleTypeDef hadc1;
 ADC_HandleTypeDef hadc3;
 DMA_HandleTypeDef hdma_adc1;
 DMA_HandleTypeDef hdma_adc3;
+DMA_HandleTypeDef hdma_usart3_tx;
 
 CAN_HandleTypeDef hcan1;
 
@@ -70,13 +84,22 @@ I2C_HandleTypeDef hi2c2;
 
 IWDG_HandleTypeDef hiwdg;
 
+TIM_HandleTypeDef htim2;
+TIM_HandleTypeDef htim3;
+TIM_HandleTypeDef htim7;
+
 UART_HandleTypeDef huart3;
 
 /* Definitions for defaultTask */
 osThreadId_t defaultTaskHandle;
+uint32_t defaultTaskBuffer[ 128 ];
+osStaticThreadDef_t defaultTaskControlBlock;
 const osThreadAttr_t defaultTask_attributes = {
   .name = "defaultTask",
-  .stack_size = 128 * 4,
+  .cb_mem = &defaultTaskControlBlock,
+  .cb_size = sizeof(defaultTaskControlBlock),
+  .stack_mem = &defaultTaskBuffer[0],
+  .stack_size = sizeof(defaultTaskBuffer),
   .priority = (osPriority_t) osPriorityNormal,
 };
 /* USER CODE BEGIN PV */
@@ -95,6 +118,9 @@ static void MX_ADC1_Init(void);
 static void MX_USART3_UART_Init(void);
 static void MX_ADC3_Init(void);
 static void MX_IWDG_Init(void);
+static void MX_TIM2_Init(void);
+static void MX_TIM3_Init(void);
+static void MX_TIM7_Init(void);
 void StartDefaultTask(void *argument);
 
 /* USER CODE BEGIN PFP */
@@ -112,16 +138,14 @@ void StartDefaultTask(void *argument);
 
 PUTCHAR_PROTOTYPE
 {
-  HAL_UART_Transmit(&huart3, (uint8_t *)&ch, 1, HAL_MAX_DELAY);
+  uint8_t c = ch;
+  serial_write(&c, 1);
   return ch;
 }
 
+/* printf goes through the same DMA ring as serial_print, so it never blocks */
 int _write(int file, char* ptr, int len) {
-  int DataIdx;
-
-  for (DataIdx = 0; DataIdx < len; DataIdx++) {
-    __io_putchar( *ptr++ );
-  }
+  serial_write(ptr, len);
   return len;
 }
 /* USER CODE END 0 */
@@ -164,20 +188,32 @@ int main(void)
   MX_USART3_UART_Init();
   MX_ADC3_Init();
   MX_IWDG_Init();
+  MX_TIM3_Init();
+  MX_TIM7_Init();
+  MX_TIM2_Init();
   /* USER CODE BEGIN 2 */
 
+  /* Every timestamp comes from here, so start it before anything records one */
+  timebase_init(&htim2);
+
   /* Create Interfaces to Represent Relevant Hardware */
-  mpu_t *mpu  = init_mpu(&hi2c1, &hadc3, &hadc1, GPIOC, GPIOB);
+  mpu_t *mpu  = init_mpu(&hi2c1, &hadc3, &hadc1, &htim3, GPIOC, GPIOB);
   assert(mpu);
   pdu_t *pdu  = init_pdu(&hi2c2);
   assert(pdu);
   dti_t *mc   = dti_init();
   assert(mc);
-  steeringio_t *wheel = steeringio_init();
+  steeringio_t *wheel = steeringio_init(&htim7);
   assert(wheel);
   init_can1(&hcan1);
+  xcp_can_init();
   bms_init();
 
+  /* Peripheral timings are derived from the clock profile, make sure they landed */
+  assert(!clock_profile_check(&hcan1));
+
+  task_sched_init();
+
   printf("\r\n\n\nInit Success...\r\n\n\n");
 
   /* USER CODE END 2 */
@@ -186,7 +222,7 @@ int main(void)
   osKernelInitialize();
 
   /* USER CODE BEGIN RTOS_MUTEX */
-
+  /* add mutexes, ... */
   /* USER CODE END RTOS_MUTEX */
 
   /* USER CODE BEGIN RTOS_SEMAPHORES */
@@ -195,9 +231,15 @@ int main(void)
 
   /* USER CODE BEGIN RTOS_TIMERS */
   /* start timers, add new ones, ... */
+  timesync_init();
   /* USER CODE END RTOS_TIMERS */
 
   /* USER CODE BEGIN RTOS_QUEUES */
+  fault_init();
+  serial_monitor_init(&huart3);
+  state_machine_init();
+  flash_init();
+  params_init();
   /* USER CODE END RTOS_QUEUES */
 
   /* Create the thread(s) */
@@ -207,17 +249,19 @@ int main(void)
   /* USER CODE BEGIN RTOS_THREADS */
 
   /* Monitors */
-  non_func_data_args_t *nfd_args = malloc(sizeof(non_func_data_args_t));
-  nfd_args->mpu = mpu;
-  nfd_args->pdu = pdu;
-  non_functional_data_thead = osThreadNew(vNonFunctionalDataCollection, nfd_args, &non_functional_data_attributes);
+  static non_func_data_args_t nfd_args;
+  nfd_args.mpu = mpu;
+  nfd_args.pdu = pdu;
+  non_functional_data_thead = osThreadNew(vNonFunctionalDataCollection, &nfd_args, &non_functional_data_attributes);
   assert(non_functional_data_thead);
 
-  data_collection_args_t* data_args = malloc(sizeof(data_collection_args_t));
-  data_args->pdu = pdu;
-  data_args->wheel = wheel;
-  data_collection_thread = osThreadNew(vDataCollection, data_args, &data_collection_attributes);
+  static data_collection_args_t data_args;
+  data_args.pdu = pdu;
+  data_args.wheel = wheel;
+  data_collection_thread = osThreadNew(vDataCollection, &data_args, &data_collection_attributes);
   assert(data_collection_thread);
+  steeringio_thread = osThreadNew(vSteeringIO, wheel, &steeringio_attributes);
+  assert(steeringio_thread);
   // temp_monitor_handle = osThreadNew(vTempMonitor, mpu, &temp_monitor_attributes);
   // assert(temp_monitor_handle);
   //imu_monitor_handle = osThreadNew(vIMUMonitor, mpu, &imu_monitor_attributes);
@@ -230,8 +274,6 @@ int main(void)
   assert(can_dispatch_handle);
   can_receive_thread = osThreadNew(vCanReceive, mc, &can_receive_attributes);
   assert(can_receive_thread);
-  serial_monitor_handle = osThreadNew(vSerialMonitor, NULL, &serial_monitor_attributes);
-  assert(serial_monitor_handle);
 
   /* Control Logic */
   fault_handle = osThreadNew(vFaultHandler, NULL, &fault_handle_attributes);
@@ -240,18 +282,41 @@ int main(void)
   rtds_thread = osThreadNew(vRTDS, pdu, &rtds_attributes);
   assert(rtds_thread);
 
-  pedals_args_t *pedals_args = malloc(sizeof(pedals_args_t));
-  pedals_args->mpu = mpu;
-  pedals_args->mc = mc;
-  pedals_args->pdu = pdu;
-  process_pedals_thread = osThreadNew(vProcessPedals, pedals_args, &process_pedals_attributes);
+  static pedals_args_t pedals_args;
+  pedals_args.mpu = mpu;
+  pedals_args.mc = mc;
+  pedals_args.pdu = pdu;
+  process_pedals_thread = osThreadNew(vProcessPedals, &pedals_args, &process_pedals_attributes);
   assert(process_pedals_thread);
 
-  sm_director_args_t *sm_args = malloc(sizeof(sm_director_args_t));
-  sm_args->pdu = pdu;
-  sm_args->mc = mc;
-  sm_director_handle = osThreadNew(vStateMachineDirector, sm_args, &sm_director_attributes);
+  static sm_director_args_t sm_args;
+  sm_args.pdu = pdu;
+  sm_args.mc = mc;
+  sm_director_handle = osThreadNew(vStateMachineDirector, &sm_args, &sm_director_attributes);
   assert(sm_director_handle);
+
+  rtos_stats_handle = osThreadNew(vRtosStats, NULL, &rtos_stats_attributes);
+  assert(rtos_stats_handle);
+
+  trace_dump_handle = osThreadNew(vTraceDump, NULL, &trace_dump_attributes);
+  assert(trace_dump_handle);
+
+  blackbox_handle = osThreadNew(vBlackbox, NULL, &blackbox_attributes);
+  assert(blackbox_handle);
+
+  supervisor_handle = osThreadNew(vSupervisor, &hiwdg, &supervisor_attributes);
+  assert(supervisor_handle);
+
+  console_handle = osThreadNew(vConsole, NULL, &console_attributes);
+  assert(console_handle);
+
+#ifdef TASK_SCHED_JITTER_TEST
+  static jitter_test_args_t jitter_args;
+  jitter_args.mpu = mpu;
+  jitter_args.pdu = pdu;
+  jitter_test_handle = osThreadNew(vJitterTest, &jitter_args, &jitter_test_attributes);
+  assert(jitter_test_handle);
+#endif
   /* USER CODE END RTOS_THREADS */
 
   /* USER CODE BEGIN RTOS_EVENTS */
@@ -294,7 +359,20 @@ void SystemClock_Config(void)
   RCC_OscInitStruct.HSIState = RCC_HSI_ON;
   RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
   RCC_OscInitStruct.LSIState = RCC_LSI_ON;
+#if CLOCK_PROFILE == CLOCK_PROFILE_HSI_16
   RCC_OscInitStruct.PLL.PLLState = RCC_PLL_NONE;
+#else
+#ifdef CLOCK_HSE_STATE
+  RCC_OscInitStruct.OscillatorType |= RCC_OSCILLATORTYPE_HSE;
+  RCC_OscInitStruct.HSEState = CLOCK_HSE_STATE;
+#endif
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLSource = CLOCK_PLL_SOURCE;
+  RCC_OscInitStruct.PLL.PLLM = CLOCK_PLL_M;
+  RCC_OscInitStruct.PLL.PLLN = CLOCK_PLL_N;
+  RCC_OscInitStruct.PLL.PLLP = CLOCK_PLL_P;
+  RCC_OscInitStruct.PLL.PLLQ = CLOCK_PLL_Q;
+#endif
   if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
   {
     Error_Handler();
@@ -304,12 +382,17 @@ void SystemClock_Config(void)
   */
   RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
                               |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+#if CLOCK_PROFILE == CLOCK_PROFILE_HSI_16
   RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_HSI;
+#else
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+#endif
   RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
-  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+  RCC_ClkInitStruct.APB1CLKDivider = CLOCK_APB1_DIV;
+  RCC_ClkInitStruct.APB2CLKDivider = CLOCK_APB2_DIV;
 
-  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK)
+  /* Wait states are raised before the clock switch and the ART keeps them mostly hidden */
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, CLOCK_FLASH_LATENCY) != HAL_OK)
   {
     Error_Handler();
   }
@@ -336,13 +419,13 @@ static void MX_ADC1_Init(void)
   /** Configure the global features of the ADC (Clock, Resolution, Data Alignment and number of conversion)
   */
   hadc1.Instance = ADC1;
-  hadc1.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV6;
+  hadc1.Init.ClockPrescaler = CLOCK_ADC_PRESCALER;
   hadc1.Init.Resolution = ADC_RESOLUTION_12B;
-  hadc1.Init.ScanConvMode = ENABLE;
-  hadc1.Init.ContinuousConvMode = ENABLE;
+  hadc1.Init.ScanConvMode = DISABLE;
+  hadc1.Init.ContinuousConvMode = DISABLE;
   hadc1.Init.DiscontinuousConvMode = DISABLE;
-  hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
-  hadc1.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+  hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  hadc1.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T3_TRGO;
   hadc1.Init.DataAlign = ADC_DATAALIGN_RIGHT;
   hadc1.Init.NbrOfConversion = 1;
   hadc1.Init.DMAContinuousRequests = ENABLE;
@@ -356,7 +439,7 @@ static void MX_ADC1_Init(void)
   */
   sConfig.Channel = ADC_CHANNEL_8;
   sConfig.Rank = 1;
-  sConfig.SamplingTime = ADC_SAMPLETIME_3CYCLES;
+  sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
   if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK)
   {
     Error_Handler();
@@ -388,7 +471,7 @@ static void MX_ADC3_Init(void)
   /** Configure the global features of the ADC (Clock, Resolution, Data Alignment and number of conversion)
   */
   hadc3.Instance = ADC3;
-  hadc3.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV6;
+  hadc3.Init.ClockPrescaler = CLOCK_ADC_PRESCALER;
   hadc3.Init.Resolution = ADC_RESOLUTION_12B;
   hadc3.Init.ScanConvMode = ENABLE;
   hadc3.Init.ContinuousConvMode = ENABLE;
@@ -408,7 +491,7 @@ static void MX_ADC3_Init(void)
   */
   sConfig.Channel = ADC_CHANNEL_2;
   sConfig.Rank = 1;
-  sConfig.SamplingTime = ADC_SAMPLETIME_3CYCLES;
+  sConfig.SamplingTime = CLOCK_PEDAL_SAMPLETIME;
   if (HAL_ADC_ConfigChannel(&hadc3, &sConfig) != HAL_OK)
   {
     Error_Handler();
@@ -442,6 +525,41 @@ static void MX_ADC3_Init(void)
   }
   /* USER CODE BEGIN ADC3_Init 2 */
 
+  /* Convert the accel pedals again as an auto injected group so the analog
+   * watchdog can watch both of them without touching the brake channels */
+  ADC_InjectionConfTypeDef sConfigInjected = {0};
+  sConfigInjected.InjectedChannel = ADC_CHANNEL_3;
+  sConfigInjected.InjectedRank = 1;
+  sConfigInjected.InjectedNbrOfConversion = 2;
+  sConfigInjected.InjectedSamplingTime = CLOCK_PEDAL_SAMPLETIME;
+  sConfigInjected.ExternalTrigInjecConvEdge = ADC_EXTERNALTRIGINJECCONVEDGE_NONE;
+  sConfigInjected.ExternalTrigInjecConv = ADC_INJECTED_SOFTWARE_START;
+  sConfigInjected.AutoInjectedConv = ENABLE;
+  sConfigInjected.InjectedDiscontinuousConvMode = DISABLE;
+  sConfigInjected.InjectedOffset = 0;
+  if (HAL_ADCEx_InjectedConfigChannel(&hadc3, &sConfigInjected) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  sConfigInjected.InjectedChannel = ADC_CHANNEL_2;
+  sConfigInjected.InjectedRank = 2;
+  if (HAL_ADCEx_InjectedConfigChannel(&hadc3, &sConfigInjected) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* Pedal open and short circuit detection */
+  ADC_AnalogWDGConfTypeDef AnalogWDGConfig = {0};
+  AnalogWDGConfig.WatchdogMode = ADC_ANALOGWATCHDOG_ALL_INJEC;
+  AnalogWDGConfig.HighThreshold = PEDAL_OPEN_CIRCUIT_THRESH;
+  AnalogWDGConfig.LowThreshold = PEDAL_SHORT_CIRCUIT_THRESH;
+  AnalogWDGConfig.ITMode = ENABLE;
+  if (HAL_ADC_AnalogWDGConfig(&hadc3, &AnalogWDGConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
   /* USER CODE END ADC3_Init 2 */
 
 }
@@ -462,11 +580,11 @@ static void MX_CAN1_Init(void)
 
   /* USER CODE END CAN1_Init 1 */
   hcan1.Instance = CAN1;
-  hcan1.Init.Prescaler = 2;
+  hcan1.Init.Prescaler = CLOCK_CAN_PRESCALER;
   hcan1.Init.Mode = CAN_MODE_NORMAL;
   hcan1.Init.SyncJumpWidth = CAN_SJW_1TQ;
-  hcan1.Init.TimeSeg1 = CAN_BS1_13TQ;
-  hcan1.Init.TimeSeg2 = CAN_BS2_2TQ;
+  hcan1.Init.TimeSeg1 = CLOCK_CAN_BS1;
+  hcan1.Init.TimeSeg2 = CLOCK_CAN_BS2;
   hcan1.Init.TimeTriggeredMode = DISABLE;
   hcan1.Init.AutoBusOff = ENABLE;
   hcan1.Init.AutoWakeUp = DISABLE;
@@ -579,6 +697,138 @@ static void MX_IWDG_Init(void)
 
 }
 
+/**
+  * @brief TIM2 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM2_Init(void)
+{
+
+  /* USER CODE BEGIN TIM2_Init 0 */
+
+  /* USER CODE END TIM2_Init 0 */
+
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM2_Init 1 */
+
+  /* USER CODE END TIM2_Init 1 */
+  htim2.Instance = TIM2;
+  htim2.Init.Prescaler = CLOCK_APB1_TIM_HZ / CLOCK_TIMEBASE_HZ - 1;
+  htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim2.Init.Period = 4294967295;
+  htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+  if (HAL_TIM_ConfigClockSource(&htim2, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim2, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM2_Init 2 */
+
+  /* USER CODE END TIM2_Init 2 */
+
+}
+
+/**
+  * @brief TIM3 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM3_Init(void)
+{
+
+  /* USER CODE BEGIN TIM3_Init 0 */
+
+  /* USER CODE END TIM3_Init 0 */
+
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM3_Init 1 */
+
+  /* USER CODE END TIM3_Init 1 */
+  htim3.Instance = TIM3;
+  htim3.Init.Prescaler = CLOCK_APB1_TIM_HZ / CLOCK_LV_TIM_HZ - 1;
+  htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim3.Init.Period = 1000-1;
+  htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+  if (HAL_TIM_ConfigClockSource(&htim3, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim3, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM3_Init 2 */
+
+  /* USER CODE END TIM3_Init 2 */
+
+}
+
+/**
+  * @brief TIM7 Initialization Function
+  * @param None
+  * @retval None
+  */
+static void MX_TIM7_Init(void)
+{
+
+  /* USER CODE BEGIN TIM7_Init 0 */
+
+  /* USER CODE END TIM7_Init 0 */
+
+  TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+  /* USER CODE BEGIN TIM7_Init 1 */
+
+  /* USER CODE END TIM7_Init 1 */
+  htim7.Instance = TIM7;
+  htim7.Init.Prescaler = CLOCK_APB1_TIM_HZ / STEERING_DEBOUNCE_TIM_HZ - 1;
+  htim7.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim7.Init.Period = 100-1;
+  htim7.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim7) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_OnePulse_Init(&htim7, TIM_OPMODE_SINGLE) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+  if (HAL_TIMEx_MasterConfigSynchronization(&htim7, &sMasterConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN TIM7_Init 2 */
+
+  /* USER CODE END TIM7_Init 2 */
+
+}
+
 /**
   * @brief USART3 Initialization Function
   * @param None
@@ -619,8 +869,14 @@ static void MX_DMA_Init(void)
 {
 
   /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
   __HAL_RCC_DMA2_CLK_ENABLE();
 
+  /* DMA interrupt init */
+  /* DMA1_Stream3_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream3_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+
 }
 
 /**
@@ -652,19 +908,19 @@ static void MX_GPIO_Init(void)
 
   /*Configure GPIO pins : PA4 PA5 PA6 PA7 */
   GPIO_InitStruct.Pin = GPIO_PIN_4|GPIO_PIN_5|GPIO_PIN_6|GPIO_PIN_7;
-  GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING_FALLING;
   GPIO_InitStruct.Pull = GPIO_PULLUP;
   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
-  /*Configure GPIO pin : PC4 */
-  GPIO_InitStruct.Pin = GPIO_PIN_4;
+  /*Configure GPIO pins : PC4 PC5 */
+  GPIO_InitStruct.Pin = GPIO_PIN_4|GPIO_PIN_5;
   GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
   GPIO_InitStruct.Pull = GPIO_PULLUP;
   HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
 
   /*Configure GPIO pin : PB1 */
   GPIO_InitStruct.Pin = GPIO_PIN_1;
-  GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING_FALLING;
   GPIO_InitStruct.Pull = GPIO_PULLUP;
   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
@@ -690,12 +946,40 @@ static void MX_GPIO_Init(void)
   GPIO_InitStruct.Alternate = GPIO_AF10_OTG_FS;
   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+  /* EXTI interrupt init*/
+  HAL_NVIC_SetPriority(EXTI1_IRQn, 11, 0);
+  HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+
+  HAL_NVIC_SetPriority(EXTI4_IRQn, 11, 0);
+  HAL_NVIC_EnableIRQ(EXTI4_IRQn);
+
+  HAL_NVIC_SetPriority(EXTI9_5_IRQn, 11, 0);
+  HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
+
 /* USER CODE BEGIN MX_GPIO_Init_2 */
 /* USER CODE END MX_GPIO_Init_2 */
 }
 
 /* USER CODE BEGIN 4 */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  /* Every EXTI line is a steering wheel input */
+  steeringio_edge_isr(GPIO_Pin);
+}
 
+void HAL_ADC_LevelOutOfWindowCallback(ADC_HandleTypeDef *hadc)
+{
+  if (hadc->Instance == ADC3) {
+    pedal_watchdog_isr(hadc);
+  }
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM7) {
+    steeringio_debounce_isr();
+  }
+}
 /* USER CODE END 4 */
 
 /* USER CODE BEGIN Header_StartDefaultTask */
@@ -712,8 +996,7 @@ void StartDefaultTask(void *argument)
   /* Infinite loop */
   for(;;) {
 
-    /* Pet watchdog */
-    HAL_IWDG_Refresh(&hiwdg);
+    /* The watchdog is refreshed by the supervisor */
     /* Toggle LED at certain frequency */
     printf(".\r\n..\r\n");
     HAL_GPIO_TogglePin(GPIOC, GPIO_PIN_8);
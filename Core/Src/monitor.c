@@ -16,6 +16,13 @@
 #include "timer.h"
 #include "pedals.h"
 #include "cerb_utils.h"
+#include "task_sched.h"
+#include "ccmram.h"
+#include "supervisor.h"
+#include "log.h"
+#include "signals.h"
+#include "params.h"
+#include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -23,8 +30,7 @@
 
 #define TSMS_DEBOUNCE_PERIOD 500 /* ms */
 
-static bool tsms = false;
-osMutexId_t tsms_mutex;
+#define FUNC_STATE_CHANGED_FLAG 1U
 
 /**
  * @brief Read the open cell voltage of the LV batteries and send a CAN message with the result.
@@ -40,16 +46,11 @@ void read_lv_sense(void *arg)
 
 	read_lv_voltage(mpu, &v_int);
 
-	/* Convert from raw ADC reading to voltage level */
-
-	// scale up then truncate
-	// convert to out of 24 volts
-	// since 12 bits / 4096
-	// Magic number bc idk the resistors on the voltage divider
-	float v_dec = v_int * 8.967;
-
-	// get final voltage
-	v_int = (uint32_t)(v_dec * 10.0);
+	/* Convert from oversampled ADC reading to voltage level */
+	int64_t v_cal = (((int64_t)v_int * params.lv_sense_gain) >> 16) +
+			params.lv_sense_offset;
+	v_int = v_cal > 0 ? (uint32_t)v_cal : 0;
+	signal_publish(SIGNAL_LV_VOLTAGE, (signal_value_t){ .u = v_int });
 
 	memcpy(msg.data, &v_int, msg.len);
 	if (queue_can_msg(msg)) {
@@ -104,42 +105,44 @@ void read_fuse_data(void *arg)
 }
 
 osThreadId_t non_functional_data_thead;
+static StaticTask_t non_functional_data_cb CCM_BSS(non_functional_data_cb);
+static uint32_t non_functional_data_stack[2048 / sizeof(uint32_t)]
+	CCM_BSS(non_functional_data_stack);
 const osThreadAttr_t non_functional_data_attributes = {
 	.name = "NonFunctionalDataCollection",
-	.stack_size = 2048,
-	.priority = (osPriority_t)osPriorityBelowNormal,
+	.cb_mem = &non_functional_data_cb,
+	.cb_size = sizeof(non_functional_data_cb),
+	.stack_mem = non_functional_data_stack,
+	.stack_size = sizeof(non_functional_data_stack),
+	.priority = TASK_PRIORITY(NON_FUNCTIONAL),
 };
 void vNonFunctionalDataCollection(void *pv_params)
 {
 	non_func_data_args_t *args = (non_func_data_args_t *)pv_params;
 	mpu_t *mpu = args->mpu;
 	pdu_t *pdu = args->pdu;
-	free(args);
+
+	uint32_t next_release = osKernelGetTickCount();
 
 	for (;;) {
+		task_sched_release(TASK_NON_FUNCTIONAL);
 		read_lv_sense(mpu);
 		read_fuse_data(pdu);
 
-		/* delay for 1000 ms (1k ticks at 1000 Hz tickrate) */
-		osDelay(1000);
+		next_release += TASK_PERIOD(NON_FUNCTIONAL);
+		osDelayUntil(next_release);
 	}
 }
 
 bool get_tsms()
 {
-	bool temp;
-	osMutexAcquire(tsms_mutex, osWaitForever);
-	temp = tsms;
-	osMutexRelease(tsms_mutex);
-	return temp;
+	return signal_get(SIGNAL_TSMS).b;
 }
 
 void tsms_debounce_cb(void *arg)
 {
 	/* Set TSMS state to new debounced value */
-	osMutexAcquire(tsms_mutex, osWaitForever);
-	tsms = *((bool *)arg);
-	osMutexRelease(tsms_mutex);
+	signal_publish(SIGNAL_TSMS, (signal_value_t){ .b = *((bool *)arg) });
 	/* Tell NERO allaboutit */
 	send_nero_msg();
 }
@@ -148,8 +151,9 @@ void tsms_debounce_cb(void *arg)
  * @brief Read the TSMS signal and debounce it.
  * 
  * @param pdu Pointer to struct representing the PDU.
+ * @param active Whether the car is in an active state.
  */
-void read_tsms(pdu_t *pdu)
+void read_tsms(pdu_t *pdu, bool active)
 {
 	static nertimer_t timer;
 	fault_data_t fault_data = { .id = FUSE_MONITOR_FAULT,
@@ -170,51 +174,22 @@ void read_tsms(pdu_t *pdu)
 		debounce(!tsms_reading, &timer, TSMS_DEBOUNCE_PERIOD,
 			 &tsms_debounce_cb, &tsms_reading);
 
-	if (get_active() && get_tsms() == false) {
+	if (active && get_tsms() == false) {
 		set_home_mode();
 	}
 }
 
-/**
- * @brief Read the buttons of the steering wheel, debounce them, and send a CAN message containing the raw data.
- * 
- * @param wheel Pointer to struct defining wheel interface
- */
-void steeringio_monitor(steeringio_t *wheel)
-{
-	can_msg_t msg = { .id = 0x680, .len = 8, .data = { 0 } };
-	fault_data_t fault_data = { .id = BUTTONS_MONITOR_FAULT,
-				    .severity = DEFCON5 };
-
-	uint8_t button_1 = !HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_4);
-	uint8_t button_2 = !HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_5);
-	uint8_t button_3 = !HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_6);
-	uint8_t button_4 = !HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_7);
-	uint8_t button_5 = !HAL_GPIO_ReadPin(GPIOC, GPIO_PIN_4);
-	uint8_t button_6 = HAL_GPIO_ReadPin(GPIOC, GPIO_PIN_5);
-	uint8_t button_7 = HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_0);
-	uint8_t button_8 = !HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_1);
-
-	uint8_t button_data = (button_1 << 7) | (button_2 << 6) |
-			      (button_3 << 5) | (button_4 << 4) |
-			      (button_5 << 3) | (button_6 << 2) |
-			      (button_7 << 1) | (button_8);
-
-	steeringio_update(wheel, button_data);
-
-	/* Set the first byte to be the first 8 buttons with each bit representing the pin status */
-	msg.data[0] = button_data;
-	if (queue_can_msg(msg)) {
-		fault_data.diag = "Failed to send steering buttons can message";
-		queue_fault(&fault_data);
-	}
-}
-
 osThreadId_t data_collection_thread;
+static StaticTask_t data_collection_cb CCM_BSS(data_collection_cb);
+static uint32_t data_collection_stack[2048 / sizeof(uint32_t)]
+	CCM_BSS(data_collection_stack);
 const osThreadAttr_t data_collection_attributes = {
 	.name = "DataCollection",
-	.stack_size = 2048,
-	.priority = (osPriority_t)osPriorityBelowNormal,
+	.cb_mem = &data_collection_cb,
+	.cb_size = sizeof(data_collection_cb),
+	.stack_mem = data_collection_stack,
+	.stack_size = sizeof(data_collection_stack),
+	.priority = TASK_PRIORITY(DATA_COLLECTION),
 };
 
 void vDataCollection(void *pv_params)
@@ -222,28 +197,44 @@ void vDataCollection(void *pv_params)
 	data_collection_args_t *args = (data_collection_args_t *)pv_params;
 	pdu_t *pdu = args->pdu;
 	steeringio_t *wheel = args->wheel;
-	free(args);
 
-	static const uint8_t delay = 20;
+	/* Subscribed before the first read, so no transition is missed */
+	assert(!signal_subscribe(SIGNAL_FUNC_STATE, FUNC_STATE_CHANGED_FLAG));
+	bool active = get_active();
 
-	tsms_mutex = osMutexNew(NULL);
+	supervisor_register(TASK_DATA_COLLECTION);
+	uint32_t next_release = osKernelGetTickCount();
 
 	for (;;) {
-		read_tsms(pdu);
-		osDelay(delay);
+		task_sched_release(TASK_DATA_COLLECTION);
+
+		if (osThreadFlagsClear(FUNC_STATE_CHANGED_FLAG) &
+		    FUNC_STATE_CHANGED_FLAG)
+			active = get_active();
+		read_tsms(pdu, active);
 
-		steeringio_monitor(wheel);
-		osDelay(delay);
+		/* Every other steering input is interrupt driven */
+		steeringio_poll_shared_lines(wheel);
+
+		task_sched_complete(TASK_DATA_COLLECTION);
+		next_release += TASK_PERIOD(DATA_COLLECTION);
+		osDelayUntil(next_release);
 	}
 }
 
 /* Unused -----------------------------------------------*/
 
 osThreadId_t temp_monitor_handle;
+static StaticTask_t temp_monitor_cb CCM_BSS(temp_monitor_cb);
+static uint32_t temp_monitor_stack[32 * 8 / sizeof(uint32_t)]
+	CCM_BSS(temp_monitor_stack);
 const osThreadAttr_t temp_monitor_attributes = {
 	.name = "TempMonitor",
-	.stack_size = 32 * 8,
-	.priority = (osPriority_t)osPriorityHigh1,
+	.cb_mem = &temp_monitor_cb,
+	.cb_size = sizeof(temp_monitor_cb),
+	.stack_mem = temp_monitor_stack,
+	.stack_size = sizeof(temp_monitor_stack),
+	.priority = TASK_PRIORITY(TEMP_MONITOR),
 };
 
 void vTempMonitor(void *pv_params)
@@ -255,8 +246,10 @@ void vTempMonitor(void *pv_params)
 			       .data = { 0 } };
 
 	mpu_t *mpu = (mpu_t *)pv_params;
+	uint32_t next_release = osKernelGetTickCount();
 
 	for (;;) {
+		task_sched_release(TASK_TEMP_MONITOR);
 		/* Take measurement */
 		uint16_t temp = 0;
 		uint16_t humidity = 0;
@@ -265,7 +258,7 @@ void vTempMonitor(void *pv_params)
 			queue_fault(&fault_data);
 		}
 
-		serial_print("MPU Board Temperature:\t%d\r\n", temp);
+		LOG("MPU Board Temperature:\t%d\r\n", temp);
 
 		temp_msg.data[0] = temp & 0xFF;
 		temp_msg.data[1] = (temp >> 8) & 0xFF;
@@ -278,16 +271,22 @@ void vTempMonitor(void *pv_params)
 			queue_fault(&fault_data);
 		}
 
-		/* Yield to other tasks */
-		osDelay(TEMP_SENS_SAMPLE_DELAY);
+		next_release += TASK_PERIOD(TEMP_MONITOR);
+		osDelayUntil(next_release);
 	}
 }
 
 osThreadId_t shutdown_monitor_handle;
+static StaticTask_t shutdown_monitor_cb CCM_BSS(shutdown_monitor_cb);
+static uint32_t shutdown_monitor_stack[64 * 8 / sizeof(uint32_t)]
+	CCM_BSS(shutdown_monitor_stack);
 const osThreadAttr_t shutdown_monitor_attributes = {
 	.name = "ShutdownMonitor",
-	.stack_size = 64 * 8,
-	.priority = (osPriority_t)osPriorityHigh2,
+	.cb_mem = &shutdown_monitor_cb,
+	.cb_size = sizeof(shutdown_monitor_cb),
+	.stack_mem = shutdown_monitor_stack,
+	.stack_size = sizeof(shutdown_monitor_stack),
+	.priority = TASK_PRIORITY(SHUTDOWN_MONITOR),
 };
 
 void vShutdownMonitor(void *pv_params)
@@ -306,7 +305,10 @@ void vShutdownMonitor(void *pv_params)
 		uint8_t shut_2;
 	} shutdown_data;
 
+	uint32_t next_release = osKernelGetTickCount();
+
 	for (;;) {
+		task_sched_release(TASK_SHUTDOWN_MONITOR);
 		shutdown_buf = 0;
 
 		if (read_shutdown(pdu, shutdown_loop)) {
@@ -335,15 +337,22 @@ void vShutdownMonitor(void *pv_params)
 			queue_fault(&fault_data);
 		}
 
-		osDelay(SHUTDOWN_MONITOR_DELAY);
+		next_release += TASK_PERIOD(SHUTDOWN_MONITOR);
+		osDelayUntil(next_release);
 	}
 }
 
 osThreadId_t imu_monitor_handle;
+static StaticTask_t imu_monitor_cb CCM_BSS(imu_monitor_cb);
+static uint32_t imu_monitor_stack[32 * 8 / sizeof(uint32_t)]
+	CCM_BSS(imu_monitor_stack);
 const osThreadAttr_t imu_monitor_attributes = {
 	.name = "IMUMonitor",
-	.stack_size = 32 * 8,
-	.priority = (osPriority_t)osPriorityHigh,
+	.cb_mem = &imu_monitor_cb,
+	.cb_size = sizeof(imu_monitor_cb),
+	.stack_mem = imu_monitor_stack,
+	.stack_size = sizeof(imu_monitor_stack),
+	.priority = TASK_PRIORITY(IMU_MONITOR),
 };
 
 void vIMUMonitor(void *pv_params)
@@ -359,8 +368,10 @@ void vIMUMonitor(void *pv_params)
 				   .data = { 0 } };
 
 	mpu_t *mpu = (mpu_t *)pv_params;
+	uint32_t next_release = osKernelGetTickCount();
 
 	for (;;) {
+		task_sched_release(TASK_IMU_MONITOR);
 		// serial_print("IMU Task\r\n");
 		/* Take measurement */
 		uint16_t accel_data[3] = { 0 };
@@ -413,7 +424,7 @@ void vIMUMonitor(void *pv_params)
 			queue_fault(&fault_data);
 		}
 
-		/* Yield to other tasks */
-		osDelay(IMU_SAMPLE_DELAY);
+		next_release += TASK_PERIOD(IMU_MONITOR);
+		osDelayUntil(next_release);
 	}
 }
\ No newline at end of file
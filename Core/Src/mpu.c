@@ -11,32 +11,45 @@
 
 #define ADC_TIMEOUT 2 /* ms */
 
-static osMutexAttr_t mpu_i2c_mutex_attr;
-static osMutexAttr_t mpu_adc_mutex_attr;
+static mpu_t mpu_data;
+static sht30_t temp_sensor_data;
+static lsm6dso_t imu_data;
+
+static StaticSemaphore_t mpu_i2c_mutex_cb;
+static const osMutexAttr_t mpu_i2c_mutex_attr = {
+	.name = "MpuI2CMutex",
+	.cb_mem = &mpu_i2c_mutex_cb,
+	.cb_size = sizeof(mpu_i2c_mutex_cb),
+};
+static StaticSemaphore_t mpu_adc_mutex_cb;
+static const osMutexAttr_t mpu_adc_mutex_attr = {
+	.name = "MpuAdcMutex",
+	.cb_mem = &mpu_adc_mutex_cb,
+	.cb_size = sizeof(mpu_adc_mutex_cb),
+};
 
 mpu_t *init_mpu(I2C_HandleTypeDef *hi2c, ADC_HandleTypeDef *pedals_adc,
-		ADC_HandleTypeDef *lv_adc, GPIO_TypeDef *led_gpio,
-		GPIO_TypeDef *watchdog_gpio)
+		ADC_HandleTypeDef *lv_adc, TIM_HandleTypeDef *lv_tim,
+		GPIO_TypeDef *led_gpio, GPIO_TypeDef *watchdog_gpio)
 {
 	assert(hi2c);
 	assert(pedals_adc);
 	assert(lv_adc);
+	assert(lv_tim);
 	assert(led_gpio);
 	assert(watchdog_gpio);
 
-	/* Create MPU struct */
-	mpu_t *mpu = malloc(sizeof(mpu_t));
-	assert(mpu);
+	mpu_t *mpu = &mpu_data;
 
 	mpu->hi2c = hi2c;
 	mpu->pedals_adc = pedals_adc;
 	mpu->lv_adc = lv_adc;
+	mpu->lv_tim = lv_tim;
 	mpu->led_gpio = led_gpio;
 	mpu->watchdog_gpio = watchdog_gpio;
 
 	/* Initialize the Onboard Temperature Sensor */
-	mpu->temp_sensor = malloc(sizeof(sht30_t));
-	assert(mpu->temp_sensor);
+	mpu->temp_sensor = &temp_sensor_data;
 	mpu->temp_sensor->i2c_handle = hi2c;
 	assert(!sht30_init(mpu->temp_sensor)); /* This is always connected */
 
@@ -44,12 +57,14 @@ mpu_t *init_mpu(I2C_HandleTypeDef *hi2c, ADC_HandleTypeDef *pedals_adc,
 				  sizeof(mpu->pedal_dma_buf) /
 					  sizeof(uint32_t)));
 
-	assert(!HAL_ADC_Start_DMA(mpu->lv_adc, &mpu->lv_dma_buf,
+	/* Buffer is zeroed so a read before it first fills is low, not garbage */
+	memset(mpu->lv_dma_buf, 0, sizeof(mpu->lv_dma_buf));
+	assert(!HAL_ADC_Start_DMA(mpu->lv_adc, mpu->lv_dma_buf,
 				  sizeof(mpu->lv_dma_buf) / sizeof(uint32_t)));
+	assert(!HAL_TIM_Base_Start(mpu->lv_tim));
 
 	/* Initialize the IMU */
-	mpu->imu = malloc(sizeof(lsm6dso_t));
-	assert(mpu->imu);
+	mpu->imu = &imu_data;
 	//assert(!lsm6dso_init(mpu->imu, mpu->hi2c)); /* This is always connected */
 
 	/* Create Mutexes */
@@ -112,7 +127,13 @@ int8_t pet_watchdog(mpu_t *mpu)
 
 void read_lv_voltage(mpu_t *mpu, uint32_t *lv_buf)
 {
-	memcpy(lv_buf, &mpu->lv_dma_buf, sizeof(mpu->lv_dma_buf));
+	uint32_t sum = 0;
+
+	/* DMA keeps writing while this runs, which only slides the window */
+	for (uint8_t i = 0; i < LV_OVERSAMPLE_COUNT; i++)
+		sum += mpu->lv_dma_buf[i];
+
+	*lv_buf = sum >> LV_OVERSAMPLE_BITS;
 }
 
 void read_pedals(mpu_t *mpu, uint32_t pedal_buf[4])
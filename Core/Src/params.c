@@ -0,0 +1,391 @@
+/**
+ * @file params.c
+ * @brief Control parameters that can be tuned at runtime and saved to flash.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "params.h"
+#include "can_handler.h"
+#include "cmsis_os.h"
+#include "flash.h"
+#include "state_machine.h"
+#include "stm32f4xx_hal.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Saved parameters are appended to one of two 16 KB flash sectors as
+ * records, so a sector is only erased once it is full. Loading takes the
+ * valid record with the highest sequence number from either sector. When the
+ * current sector is full, the next record goes at the start of the other
+ * one, which is erased first, so the last good record survives losing power
+ * at any point.
+ *
+ * The sectors are kept out of the program by STM32F405RGTx_FLASH.ld.
+ */
+#define PARAMS_SECTOR_LEN 0x4000 /* Bytes */
+#define PARAMS_MAGIC	  0x50415231 /* "PAR1" */
+
+static const struct {
+	uint32_t addr;
+	uint32_t sector;
+} flash_sectors[2] = {
+	{ 0x08004000, FLASH_SECTOR_1 },
+	{ 0x08008000, FLASH_SECTOR_2 },
+};
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seq;
+	params_t values;
+	uint32_t crc; /* Of everything before it */
+} param_record_t;
+
+_Static_assert(sizeof(param_record_t) % sizeof(uint32_t) == 0,
+	       "Parameter records must be whole words");
+
+typedef enum { PARAM_FLOAT, PARAM_INT } param_type_t;
+
+typedef struct {
+	const char *name;
+	size_t offset;
+	param_type_t type;
+	float def;
+	float min;
+	float max;
+} param_info_t;
+
+#define PARAM_TYPE(type) \
+	_Generic((type)0, float: PARAM_FLOAT, int32_t: PARAM_INT)
+#define PARAM_INFO(id, field, type, def, min, max) \
+	{ #field, offsetof(params_t, field), PARAM_TYPE(type), def, min, max },
+static const param_info_t info[NUM_PARAMS] = { PARAM_TABLE(PARAM_INFO) };
+
+#define PARAM_SIZE(id, field, type, def, min, max)                  \
+	_Static_assert(sizeof(type) == sizeof(uint32_t),            \
+		       "Parameter " #field " must be written in one store");
+PARAM_TABLE(PARAM_SIZE)
+
+#define PARAM_DEFAULT(id, field, type, def, min, max) .field = def,
+static const params_t defaults = { PARAM_TABLE(PARAM_DEFAULT) };
+
+params_t params;
+
+/* Where changes are made until they are committed */
+static params_t staged;
+
+/*
+ * The last committed set, which is all the control loop and flash ever see.
+ * It is guarded by a sequence counter that is odd while it is being written,
+ * so the control loop never blocks on it and never applies a torn copy.
+ */
+static params_t committed;
+static volatile uint32_t committed_seq;
+static uint32_t applied_seq;
+
+/* Where the next record goes */
+static uint32_t record_sector;
+static uint32_t record_offset;
+static uint32_t record_seq;
+
+/* Held by whoever is changing the staged or committed set, or saving */
+static osMutexId_t params_mutex;
+static StaticSemaphore_t params_mutex_cb;
+static const osMutexAttr_t params_mutex_attributes = {
+	.name = "ParamsMutex",
+	.cb_mem = &params_mutex_cb,
+	.cb_size = sizeof(params_mutex_cb),
+};
+
+static uint32_t crc32(const void *data, size_t len)
+{
+	const uint8_t *bytes = data;
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (size_t i = 0; i < len; i++) {
+		crc ^= bytes[i];
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+
+	return ~crc;
+}
+
+/**
+ * @brief Copy a whole parameter set a word at a time, so no field is ever seen half written.
+ */
+static void copy_params(params_t *dst, const params_t *src)
+{
+	volatile uint32_t *to = (volatile uint32_t *)dst;
+	const volatile uint32_t *from = (const volatile uint32_t *)src;
+
+	for (size_t i = 0; i < sizeof(params_t) / sizeof(uint32_t); i++)
+		to[i] = from[i];
+}
+
+static float read_param(const params_t *set, param_id_t id)
+{
+	const void *field = (const uint8_t *)set + info[id].offset;
+
+	if (info[id].type == PARAM_INT)
+		return *(const volatile int32_t *)field;
+	return *(const volatile float *)field;
+}
+
+static int write_param(params_t *set, param_id_t id, float value)
+{
+	void *field = (uint8_t *)set + info[id].offset;
+
+	/* Also rejects NaN */
+	if (!(value >= info[id].min && value <= info[id].max))
+		return -1;
+
+	if (info[id].type == PARAM_INT) {
+		if (value != truncf(value))
+			return -1;
+		*(volatile int32_t *)field = (int32_t)value;
+	} else {
+		*(volatile float *)field = value;
+	}
+
+	return 0;
+}
+
+static bool record_valid(const param_record_t *record)
+{
+	return record->magic == PARAMS_MAGIC &&
+	       record->version == PARAMS_VERSION &&
+	       record->crc == crc32(record, offsetof(param_record_t, crc));
+}
+
+/**
+ * @brief Find the newest saved record, and where the next one should go.
+ *
+ * @return const param_record_t* The newest valid record, or NULL if there are none
+ */
+static const param_record_t *find_newest_record(void)
+{
+	const param_record_t *newest = NULL;
+
+	for (uint32_t sector = 0; sector < 2; sector++) {
+		uint32_t offset = 0;
+
+		/* Records are appended, so the first erased word is the end */
+		while (offset + sizeof(param_record_t) <= PARAMS_SECTOR_LEN) {
+			const param_record_t *record =
+				(const param_record_t *)(flash_sectors[sector]
+								 .addr +
+							 offset);
+			if (record->magic == FLASH_ERASED_WORD)
+				break;
+			offset += sizeof(param_record_t);
+
+			if (!record_valid(record) ||
+			    (newest && record->seq <= newest->seq))
+				continue;
+
+			newest = record;
+			record_sector = sector;
+			record_offset = offset;
+			record_seq = record->seq + 1;
+		}
+	}
+
+	return newest;
+}
+
+void params_init(void)
+{
+	copy_params(&staged, &defaults);
+
+	const param_record_t *record = find_newest_record();
+	if (record) {
+		/* Keep the default of anything saved out of its current limits */
+		for (param_id_t id = 0; id < NUM_PARAMS; id++)
+			write_param(&staged, id,
+				    read_param(&record->values, id));
+	}
+
+	copy_params(&committed, &staged);
+	copy_params(&params, &staged);
+
+	params_mutex = osMutexNew(&params_mutex_attributes);
+	assert(params_mutex);
+}
+
+void params_apply(void)
+{
+	uint32_t seq = __atomic_load_n(&committed_seq, __ATOMIC_ACQUIRE);
+
+	/* Nothing new, or a commit is being written and will be picked up next time */
+	if (seq == applied_seq || (seq & 1))
+		return;
+
+	params_t next;
+	copy_params(&next, &committed);
+
+	/* A commit started during the copy, so it may be torn */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&committed_seq, __ATOMIC_RELAXED) != seq)
+		return;
+
+	copy_params(&params, &next);
+	applied_seq = seq;
+}
+
+float param_get(param_id_t id)
+{
+	return read_param(&staged, id);
+}
+
+int param_set(param_id_t id, float value)
+{
+	osMutexAcquire(params_mutex, osWaitForever);
+	int ret = write_param(&staged, id, value);
+	osMutexRelease(params_mutex);
+
+	return ret;
+}
+
+void params_defaults(void)
+{
+	osMutexAcquire(params_mutex, osWaitForever);
+	copy_params(&staged, &defaults);
+	osMutexRelease(params_mutex);
+}
+
+void params_commit(void)
+{
+	osMutexAcquire(params_mutex, osWaitForever);
+
+	__atomic_fetch_add(&committed_seq, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	copy_params(&committed, &staged);
+	__atomic_fetch_add(&committed_seq, 1, __ATOMIC_RELEASE);
+
+	osMutexRelease(params_mutex);
+}
+
+int params_save(void)
+{
+	if (get_active())
+		return -1;
+
+	osMutexAcquire(params_mutex, osWaitForever);
+
+	param_record_t record = { .magic = PARAMS_MAGIC,
+				  .version = PARAMS_VERSION,
+				  .seq = record_seq };
+	copy_params(&record.values, &committed);
+	record.crc = crc32(&record, offsetof(param_record_t, crc));
+
+	uint32_t addr = flash_sectors[record_sector].addr + record_offset;
+	bool fits = record_offset + sizeof(record) <= PARAMS_SECTOR_LEN &&
+		    flash_erased(addr, sizeof(record));
+	int ret = fits ? flash_program(addr, &record, sizeof(record)) : -1;
+
+	/* Full, or something half written is in the way: start over in the other sector */
+	if (ret) {
+		uint32_t sector = !record_sector;
+
+		addr = flash_sectors[sector].addr;
+		if (!flash_erase(flash_sectors[sector].sector))
+			ret = flash_program(addr, &record, sizeof(record));
+		if (!ret) {
+			record_sector = sector;
+			record_offset = 0;
+		}
+	}
+
+	if (!ret) {
+		record_offset += sizeof(record);
+		record_seq++;
+	}
+
+	osMutexRelease(params_mutex);
+
+	return ret ? -2 : 0;
+}
+
+int param_find(const char *name)
+{
+	for (param_id_t id = 0; id < NUM_PARAMS; id++) {
+		if (!strcmp(name, info[id].name))
+			return id;
+	}
+
+	return -1;
+}
+
+const char *param_name(param_id_t id)
+{
+	return info[id].name;
+}
+
+void param_limits(param_id_t id, float *min, float *max)
+{
+	*min = info[id].min;
+	*max = info[id].max;
+}
+
+static bool overlaps(const void *addr, uint32_t len, const params_t *set)
+{
+	uintptr_t start = (uintptr_t)addr;
+	uintptr_t set_start = (uintptr_t)set;
+
+	return start < set_start + sizeof(*set) && set_start < start + len;
+}
+
+bool params_overlaps(const void *addr, uint32_t len)
+{
+	return overlaps(addr, len, &params) || overlaps(addr, len, &staged) ||
+	       overlaps(addr, len, &committed);
+}
+
+void handle_param_request(can_msg_t msg)
+{
+	param_id_t id = msg.data[1];
+	bool ok = id < NUM_PARAMS || (msg.data[0] != PARAM_GET &&
+				      msg.data[0] != PARAM_SET);
+	float value;
+	memcpy(&value, &msg.data[2], sizeof(value));
+
+	if (ok) {
+		switch (msg.data[0]) {
+		case PARAM_GET:
+			break;
+		case PARAM_SET:
+			ok = !param_set(id, value);
+			break;
+		case PARAM_COMMIT:
+			params_commit();
+			break;
+		case PARAM_SAVE:
+			ok = !params_save();
+			break;
+		case PARAM_DEFAULTS:
+			params_defaults();
+			break;
+		default:
+			ok = false;
+			break;
+		}
+	}
+
+	can_msg_t response = { .id = CANID_PARAM_RESPONSE,
+			       .len = 7,
+			       .data = { msg.data[0], msg.data[1] } };
+	value = id < NUM_PARAMS ? param_get(id) : 0;
+	memcpy(&response.data[2], &value, sizeof(value));
+	response.data[6] = !ok;
+
+	/* The requester retries if the response is lost */
+	queue_can_msg(response);
+}
@@ -1,6 +1,8 @@
 #include "pdu.h"
 #include "serial_monitor.h"
 #include "fault.h"
+#include "task_sched.h"
+#include "ccmram.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,7 +20,16 @@
 #define CTRL_ADDR     PCA_I2C_ADDR_2
 #define RTDS_DURATION 1750 /* ms at 1kHz tick rate */
 
-static osMutexAttr_t pdu_mutex_attributes;
+static pdu_t pdu_data;
+static pca9539_t shutdown_expander_data;
+static pca9539_t ctrl_expander_data;
+
+static StaticSemaphore_t pdu_mutex_cb;
+static const osMutexAttr_t pdu_mutex_attributes = {
+	.name = "PduMutex",
+	.cb_mem = &pdu_mutex_cb,
+	.cb_size = sizeof(pdu_mutex_cb),
+};
 
 static uint8_t sound_rtds(pdu_t *pdu)
 {
@@ -62,10 +73,14 @@ static uint8_t rtds_shutoff(void *pv_params)
 }
 
 osThreadId_t rtds_thread;
+static StaticTask_t rtds_cb CCM_BSS(rtds_cb);
+static uint32_t rtds_stack[512 / sizeof(uint32_t)] CCM_BSS(rtds_stack);
 const osThreadAttr_t rtds_attributes = { .name = "RtdsThread",
-					 .stack_size = 512,
-					 /* The task will run infrequently */
-					 .priority = osPriorityRealtime7 };
+					 .cb_mem = &rtds_cb,
+					 .cb_size = sizeof(rtds_cb),
+					 .stack_mem = rtds_stack,
+					 .stack_size = sizeof(rtds_stack),
+					 .priority = TASK_PRIORITY(RTDS) };
 
 void vRTDS(void *arg)
 {
@@ -92,15 +107,12 @@ pdu_t *init_pdu(I2C_HandleTypeDef *hi2c)
 {
 	assert(hi2c);
 
-	/* Create PDU struct */
-	pdu_t *pdu = malloc(sizeof(pdu_t));
-	assert(pdu);
+	pdu_t *pdu = &pdu_data;
 
 	pdu->hi2c = hi2c;
 
 	/* Initialize Shutdown GPIO Expander */
-	pdu->shutdown_expander = malloc(sizeof(pca9539_t));
-	assert(pdu->shutdown_expander);
+	pdu->shutdown_expander = &shutdown_expander_data;
 	// pca9539_init(pdu->shutdown_expander, pdu->hi2c, SHUTDOWN_ADDR);
 	// if (status != HAL_OK) {
 	// 	printf("\n\rshutdown init fail\n\r");
@@ -128,8 +140,7 @@ pdu_t *init_pdu(I2C_HandleTypeDef *hi2c)
 	// }
 
 	/* Initialize Control GPIO Expander */
-	pdu->ctrl_expander = malloc(sizeof(pca9539_t));
-	assert(pdu->ctrl_expander);
+	pdu->ctrl_expander = &ctrl_expander_data;
 	pca9539_init(pdu->ctrl_expander, pdu->hi2c, CTRL_ADDR);
 
 	// write everything OFF, FAULT 1 is off
@@ -143,8 +154,6 @@ pdu_t *init_pdu(I2C_HandleTypeDef *hi2c)
 		pca9539_write_reg(pdu->ctrl_expander, PCA_DIRECTION_0_REG, buf);
 	if (status != HAL_OK) {
 		printf("\n\rcntrl init fail\n\r");
-		free(pdu->ctrl_expander);
-		free(pdu);
 		return NULL;
 	}
 	// pin 0 to the right
@@ -153,8 +162,6 @@ pdu_t *init_pdu(I2C_HandleTypeDef *hi2c)
 		pca9539_write_reg(pdu->ctrl_expander, PCA_DIRECTION_1_REG, buf);
 	if (status != HAL_OK) {
 		printf("\n\rcntrl init fail\n\r");
-		free(pdu->ctrl_expander);
-		free(pdu);
 		return NULL;
 	}
 
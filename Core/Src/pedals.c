@@ -21,60 +21,71 @@
 #include "bms.h"
 #include "emrax.h"
 #include "monitor.h"
+#include "cerb_math.h"
+#include "task_sched.h"
+#include "ccmram.h"
+#include "supervisor.h"
+#include "probe.h"
+#include "params.h"
+#include "xcp.h"
+#include "signals.h"
+#include "blackbox.h"
+#include "timebase.h"
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
-#include <math.h>
 #include <stdlib.h>
 
 /* DO NOT ATTEMPT TO SEND TORQUE COMMANDS LOWER THAN THIS VALUE */
 #define MIN_COMMAND_FREQ  60 /* Hz */
 #define MAX_COMMAND_DELAY 1000 / MIN_COMMAND_FREQ /* ms */
 
-static float torque_limit_percentage = 1.0;
+static float torque_limit_percentage = 1.0f;
 
 /* Parameters for the pedal monitoring task */
-#define MAX_ADC_VAL_12b	  4096
-#define PEDAL_DIFF_THRESH 30
-#define PEDAL_FAULT_TIME  500 /* ms */
+#define PEDAL_FAULT_TIME 500 /* ms */
 
-static bool brake_state = false;
-osMutexId_t brake_mutex;
+#define FUNC_STATE_CHANGED_FLAG 2U
+
+static StaticTimer_t send_pedal_data_timer_cb;
+static const osTimerAttr_t send_pedal_data_timer_attributes = {
+	.name = "SendPedalData",
+	.cb_mem = &send_pedal_data_timer_cb,
+	.cb_size = sizeof(send_pedal_data_timer_cb),
+};
 
 enum { ACCELPIN_2, ACCELPIN_1, BRAKEPIN_1, BRAKEPIN_2 };
 
+/* Accel pedal window violation caught by the ADC analog watchdog */
+static struct {
+	volatile bool tripped;
+	volatile bool open_circuit; /* Short circuit if false */
+	volatile uint32_t tripped_at; /* timebase_local(), us */
+} pedal_wdg;
+
+/* Latest processed pedal readings, kept in memory so XCP can measure them */
+static volatile struct {
+	uint16_t accel1_norm; /* % */
+	uint16_t accel2_norm; /* % */
+	uint16_t accel; /* % */
+	uint16_t brake; /* Raw ADC */
+} pedal_values;
+
 void increase_torque_limit()
 {
-	if (torque_limit_percentage + 0.1 > 1) {
-		torque_limit_percentage = 1;
-	} else {
-		torque_limit_percentage += 0.1;
-	}
+	torque_limit_percentage =
+		clampf(torque_limit_percentage + 0.1f, 0.0f, 1.0f);
 }
 
 void decrease_torque_limit()
 {
-	if (torque_limit_percentage - 1 < 0) {
-		torque_limit_percentage = 0;
-	} else {
-		torque_limit_percentage -= 0.1;
-	}
-}
-
-void set_brake_state(bool new_brake_state)
-{
-	osMutexAcquire(brake_mutex, osWaitForever);
-	brake_state = new_brake_state;
-	osMutexRelease(brake_mutex);
+	torque_limit_percentage =
+		clampf(torque_limit_percentage - 0.1f, 0.0f, 1.0f);
 }
 
 bool get_brake_state()
 {
-	bool temp;
-	osMutexAcquire(brake_mutex, osWaitForever);
-	temp = brake_state;
-	osMutexRelease(brake_mutex);
-	return temp;
+	return signal_get(SIGNAL_BRAKE).b;
 }
 
 /**
@@ -104,48 +115,84 @@ void pedal_fault_cb(void *arg)
 	queue_fault(&fault_data);
 }
 
+void pedal_watchdog_isr(ADC_HandleTypeDef *hadc)
+{
+	/* The watchdog fires on every conversion while out of window, so leave it to the task from here */
+	__HAL_ADC_DISABLE_IT(hadc, ADC_IT_AWD);
+
+	uint32_t accel1 = HAL_ADCEx_InjectedGetValue(hadc, ADC_INJECTED_RANK_1);
+	uint32_t accel2 = HAL_ADCEx_InjectedGetValue(hadc, ADC_INJECTED_RANK_2);
+
+	pedal_wdg.open_circuit = accel1 > PEDAL_OPEN_CIRCUIT_THRESH ||
+				 accel2 > PEDAL_OPEN_CIRCUIT_THRESH;
+	pedal_wdg.tripped_at = timebase_local();
+	pedal_wdg.tripped = true;
+}
+
 /**
- * @brief Determine if there has been a pedal fault based on pedal sensor data.
+ * @brief Confirm an open or short circuit caught by the pedal ADC analog watchdog. The fault is raised if the pedals stay out of window for the whole fault time, and again every fault time while they stay out.
+ * 
+ * @param hadc Pointer to the pedal ADC
+ */
+static void check_pedal_watchdog(ADC_HandleTypeDef *hadc)
+{
+	if (!pedal_wdg.tripped)
+		return;
+
+	/* Hardware sets the flag again on every conversion that is still out of window */
+	bool out_of_window = __HAL_ADC_GET_FLAG(hadc, ADC_FLAG_AWD);
+	__HAL_ADC_CLEAR_FLAG(hadc, ADC_FLAG_AWD);
+
+	if (!out_of_window) {
+		/* Pedals came back in range before the fault time, so rearm */
+		pedal_wdg.tripped = false;
+		__HAL_ADC_ENABLE_IT(hadc, ADC_IT_AWD);
+		return;
+	}
+
+	if (timebase_local() - pedal_wdg.tripped_at < PEDAL_FAULT_TIME * 1000)
+		return;
+
+	/* Raise it once per fault time rather than every pass, which is still often enough to keep it from clearing */
+	pedal_wdg.tripped_at = timebase_local();
+
+	if (pedal_wdg.open_circuit)
+		pedal_fault_cb(
+			"Pedal open circuit fault - max acceleration value");
+	else
+		pedal_fault_cb(
+			"Pedal short circuit fault - no acceleration value");
+}
+
+/**
+ * @brief Determine if the accel pedal sensors disagree. Open and short circuits are caught by the ADC analog watchdog.
  * 
  * @param accel1 Raw accel pedal 1 travel reading
  * @param accel2 Raw accel pedal 2 travel reading
  */
 void calc_pedal_faults(uint16_t accel1, uint16_t accel2)
 {
-	/* oc = Open Circuit */
-	static nertimer_t oc_fault_timer;
-
-	/* sc = Short Circuit */
-	static nertimer_t sc_fault_timer;
+	PROBE_START(CALC_PEDAL_FAULTS);
 
 	/* Pedal difference too large fault */
 	static nertimer_t diff_fault_timer;
 
-	/* Pedal open circuit fault */
-	bool open_circuit = accel1 > (MAX_ADC_VAL_12b - 20) ||
-			    accel2 > (MAX_ADC_VAL_12b - 20);
-	debounce(open_circuit, &oc_fault_timer, PEDAL_FAULT_TIME,
-		 &pedal_fault_cb,
-		 "Pedal open circuit fault - max acceleration value");
-
-	/* Pedal short circuit fault */
-	bool short_circuit = accel1 < 500 || accel2 < 500;
-	debounce(short_circuit, &sc_fault_timer, PEDAL_FAULT_TIME,
-		 &pedal_fault_cb,
-		 "Pedal short circuit fault - no acceleration value");
-
 	/* Normalize pedal values to be from 0-100 */
 	uint16_t accel1_norm =
-		adjust_pedal_val(accel1, ACCEL1_OFFSET, ACCEL1_MAX_VAL);
+		adjust_pedal_val(accel1, params.accel1_offset,
+				 params.accel1_max);
 	uint16_t accel2_norm =
-		adjust_pedal_val(accel2, ACCEL2_OFFSET, ACCEL2_MAX_VAL);
+		adjust_pedal_val(accel2, params.accel2_offset,
+				 params.accel2_max);
 
 	/* Pedal difference fault evaluation */
 	bool pedals_too_diff = abs(accel1_norm - accel2_norm) >
-			       PEDAL_DIFF_THRESH;
+			       params.pedal_diff_thresh;
 	debounce(pedals_too_diff, &diff_fault_timer, PEDAL_FAULT_TIME,
 		 &pedal_fault_cb,
 		 "Pedal fault - pedal values are too different");
+
+	PROBE_END(CALC_PEDAL_FAULTS);
 }
 
 /**
@@ -196,13 +243,13 @@ bool calc_bspd_prefault(float accel_val, float brake_val)
 	to the motor(s). Re-enable when accelerator has less than 5% pedal travel. */
 
 	/* BSPD braking theshold is arbitrary */
-	if (brake_val > 700 && accel_val > 0.25) {
+	if (brake_val > 700 && accel_val > 0.25f) {
 		motor_disabled = true;
 		queue_fault(&fault_data);
 	}
 
 	if (motor_disabled) {
-		if (accel_val < 0.05) {
+		if (accel_val < 0.05f) {
 			motor_disabled = false;
 		} else {
 			dti_set_torque(0);
@@ -215,11 +262,11 @@ bool calc_bspd_prefault(float accel_val, float brake_val)
 static void linear_accel_to_torque(float accel)
 {
 	/* Sometimes, the pedal travel jumps to 1% even if it is not pressed. */
-	if (fabs(accel - 0.01) < 0.001) {
+	if (nearf(accel, 0.01f, 0.001f)) {
 		accel = 0;
 	}
 	/* Linearly map acceleration to torque */
-	int16_t torque = (int16_t)(accel * MAX_TORQUE);
+	int16_t torque = (int16_t)(accel * params.torque_limit);
 	dti_set_torque(torque);
 }
 
@@ -232,24 +279,25 @@ static void linear_accel_to_torque(float accel)
  */
 static int16_t derate_torque(float mph, float accel)
 {
-	static int16_t torque_accumulator[ACCUMULATOR_SIZE];
+	static int16_t torque_accumulator[ACCUMULATOR_SIZE]
+		CCM_BSS(torque_accumulator);
 	/* index in moving average */
 	static uint8_t index = 0;
 
 	int16_t torque;
 
 	/* If we are going too fast, we don't want to apply any torque to the moving average */
-	if (mph > PIT_MAX_SPEED) {
+	if (mph > params.pit_max_speed) {
 		torque = 0;
 	} else {
 		/* Highest torque % in pit mode */
-		static const float max_torque_percent = 0.3;
+		static const float max_torque_percent = 0.3f;
 		/* Linearly derate torque from 30% to 0% as speed increases */
 		float torque_derating_factor =
 			max_torque_percent -
-			(max_torque_percent / PIT_MAX_SPEED);
+			(max_torque_percent / params.pit_max_speed);
 		accel *= torque_derating_factor;
-		torque = MAX_TORQUE * accel;
+		torque = (int16_t)(params.torque_limit * accel);
 	}
 
 	/* Add value to moving average */
@@ -270,7 +318,7 @@ static int16_t derate_torque(float mph, float accel)
  * @param mph Current speed of the car.
  * @param accel % pedal travel of the accelerator pedal.
  */
-static void handle_pit(float mph, float accel)
+static void handle_pit(dti_t *mc, float mph, float accel, float brake)
 {
 	dti_set_torque(derate_torque(mph, accel));
 }
@@ -281,11 +329,21 @@ static void handle_pit(float mph, float accel)
  * @param mph Current speed of the car.
  * @param accel % pedal travel of the accelerator pedal.
  */
-static void handle_reverse(float mph, float accel)
+static void handle_reverse(dti_t *mc, float mph, float accel, float brake)
 {
 	dti_set_torque(-1 * derate_torque(mph, accel));
 }
 
+static void handle_performance(dti_t *mc, float mph, float accel, float brake)
+{
+	linear_accel_to_torque(accel);
+}
+
+static void handle_stopped(dti_t *mc, float mph, float accel, float brake)
+{
+	dti_set_torque(0);
+}
+
 /* Comment out to use single pedal mode */
 //#define USE_BRAKE_REGEN 1
 
@@ -298,12 +356,12 @@ void brake_pedal_regen(float brake_val)
 {
 	// The brake travel ADC value at which we want maximum regen
 	static const float travel_scaling_max = 1000;
+	float max_current = params.regen_limit;
 	// % of max brake pressure * ac current limit
-	float brake_current =
-		(brake_val / travel_scaling_max) * MAX_REGEN_CURRENT;
-	if (brake_current > MAX_REGEN_CURRENT) {
+	float brake_current = (brake_val / travel_scaling_max) * max_current;
+	if (brake_current > max_current) {
 		// clamp for safety
-		brake_current = MAX_REGEN_CURRENT;
+		brake_current = max_current;
 	}
 
 	// current must be delivered to DTI as a multiple of 10
@@ -317,15 +375,17 @@ void brake_pedal_regen(float brake_val)
  */
 void accel_pedal_regen_torque(float accel_val)
 {
+	float max_torque = params.torque_limit;
+	float threshold = params.accel_threshold;
+
 	/* Coefficient to map accel pedal travel % to the max torque */
-	static const float coeff = MAX_TORQUE / (1 - ACCELERATION_THRESHOLD);
+	float coeff = max_torque / (1 - threshold);
 
 	/* Makes acceleration pedal more sensitive since domain is compressed but range is the same */
-	uint16_t torque =
-		coeff * accel_val - (accel_val * ACCELERATION_THRESHOLD);
+	uint16_t torque = coeff * accel_val - (accel_val * threshold);
 
-	if (torque > MAX_TORQUE) {
-		torque = MAX_TORQUE;
+	if (torque > max_torque) {
+		torque = max_torque;
 	}
 
 	dti_set_torque(torque);
@@ -338,12 +398,15 @@ void accel_pedal_regen_torque(float accel_val)
  */
 void accel_pedal_regen_braking(float accel_val)
 {
+	float max_current = params.regen_limit;
+	float threshold = params.regen_threshold;
+
 	/* Calculate AC current target for regenerative braking */
-	float regen_current = (MAX_REGEN_CURRENT / REGEN_THRESHOLD) *
-			      (REGEN_THRESHOLD - accel_val);
+	float regen_current = (max_current / threshold) *
+			      (threshold - accel_val);
 
-	if (regen_current > MAX_REGEN_CURRENT) {
-		regen_current = MAX_REGEN_CURRENT;
+	if (regen_current > max_current) {
+		regen_current = max_current;
 	}
 
 	/* Send regen current to motor controller */
@@ -361,21 +424,21 @@ void accel_pedal_regen_braking(float accel_val)
  */
 void handle_endurance(dti_t *mc, float mph, float accel_val, float brake_val)
 {
+	PROBE_START(HANDLE_ENDURANCE);
+
 #ifdef USE_BRAKE_REGEN
-	if (brake_val > 650 && (mph * 1.609) > 5) {
+	if (brake_val > 650 && (mph * MPH_TO_KMH_F) > 5) {
 		brake_pedal_regen(brake_val);
 	} else {
 		// accelerating, limit torque
 		linear_accel_to_torque(accel_val, torque);
 	}
 #else
-	/* Factor for converting MPH to KMH */
-	static const float MPH_TO_KMH = 1.609;
-
 	/* Pedal is in acceleration range. Set forward torque target. */
-	if (accel_val >= ACCELERATION_THRESHOLD) {
+	if (accel_val >= params.accel_threshold) {
 		accel_pedal_regen_torque(accel_val);
-	} else if (mph * MPH_TO_KMH > 2 && accel_val <= REGEN_THRESHOLD) {
+	} else if (mph * MPH_TO_KMH_F > 2 &&
+		   accel_val <= params.regen_threshold) {
 		accel_pedal_regen_braking(accel_val);
 	} else {
 		/* Pedal travel is between thresholds, so there should not be acceleration or braking */
@@ -383,13 +446,33 @@ void handle_endurance(dti_t *mc, float mph, float accel_val, float brake_val)
 	}
 
 #endif
+
+	PROBE_END(HANDLE_ENDURANCE);
 }
 
+/* How to turn pedal travel into a torque command in each functional state */
+typedef void (*drive_handler_t)(dti_t *mc, float mph, float accel,
+				float brake);
+static const drive_handler_t drive_handlers[MAX_FUNC_STATES] = {
+	[READY] = handle_stopped,
+	[F_PIT] = handle_pit,
+	[F_PERFORMANCE] = handle_performance,
+	[F_EFFICIENCY] = handle_endurance,
+	[REVERSE] = handle_reverse,
+	[FAULTED] = handle_stopped,
+};
+
 osThreadId_t process_pedals_thread;
+static StaticTask_t process_pedals_cb CCM_BSS(process_pedals_cb);
+static uint32_t process_pedals_stack[128 * 8 / sizeof(uint32_t)]
+	CCM_BSS(process_pedals_stack);
 const osThreadAttr_t process_pedals_attributes = {
 	.name = "PedalMonitor",
-	.stack_size = 128 * 8,
-	.priority = (osPriority_t)osPriorityRealtime,
+	.cb_mem = &process_pedals_cb,
+	.cb_size = sizeof(process_pedals_cb),
+	.stack_mem = process_pedals_stack,
+	.stack_size = sizeof(process_pedals_stack),
+	.priority = TASK_PRIORITY(PEDALS),
 };
 
 void vProcessPedals(void *pv_params)
@@ -398,75 +481,104 @@ void vProcessPedals(void *pv_params)
 	mpu_t *mpu = args->mpu;
 	dti_t *mc = args->mc;
 	pdu_t *pdu = args->pdu;
-	free(args);
 
 	uint32_t adc_data[4];
 	osTimerId_t send_pedal_data_timer =
-		osTimerNew(&send_pedal_data, osTimerPeriodic, adc_data, NULL);
+		osTimerNew(&send_pedal_data, osTimerPeriodic, adc_data,
+			   &send_pedal_data_timer_attributes);
+	assert(send_pedal_data_timer);
 
 	/* Send CAN messages with raw pedal readings, we do not care if it fails*/
 	osTimerStart(send_pedal_data_timer, 100);
 
-	/* Mutexes for setting and getting pedal values and brake state */
-	brake_mutex = osMutexNew(NULL);
-
-	const uint16_t delay_time = 10; /* ms */
 	/* End application if we try to update motor at freq below this value */
-	assert(delay_time < MAX_COMMAND_DELAY);
+	assert(TASK_PERIOD(PEDALS) < MAX_COMMAND_DELAY);
+
+	/* Subscribed before the first read, so no transition is missed */
+	assert(!signal_subscribe(SIGNAL_FUNC_STATE, FUNC_STATE_CHANGED_FLAG));
+	func_state_t func_state = get_func_state();
+	drive_handler_t drive = drive_handlers[func_state];
+
+	supervisor_register(TASK_PEDALS);
+	uint32_t next_release = osKernelGetTickCount();
 
 	for (;;) {
+		task_sched_release(TASK_PEDALS);
+
+		/* Tuning changes land between iterations, never part way through one */
+		params_apply();
+
+		/* The director flags every transition, only look the state up then */
+		if (osThreadFlagsClear(FUNC_STATE_CHANGED_FLAG) &
+		    FUNC_STATE_CHANGED_FLAG) {
+			func_state = get_func_state();
+			drive = drive_handlers[func_state];
+		}
+
 		read_pedals(mpu, adc_data);
 
 		uint32_t accel1_raw = adc_data[ACCELPIN_1];
 		uint32_t accel2_raw = adc_data[ACCELPIN_2];
 
+		check_pedal_watchdog(mpu->pedals_adc);
 		calc_pedal_faults(accel1_raw, accel2_raw);
 
 		/* Normalize pedal values to be from 0-100 */
 		uint16_t accel1_norm = adjust_pedal_val(
-			accel1_raw, ACCEL1_OFFSET, ACCEL1_MAX_VAL);
+			accel1_raw, params.accel1_offset, params.accel1_max);
 		uint16_t accel2_norm = adjust_pedal_val(
-			accel2_raw, ACCEL2_OFFSET, ACCEL2_MAX_VAL);
+			accel2_raw, params.accel2_offset, params.accel2_max);
 
 		/* Combine normalized values from both accel pedal sensors */
 		uint16_t accel_val = (uint16_t)(accel1_norm + accel2_norm) / 2;
 		uint16_t brake_val =
 			(adc_data[BRAKEPIN_1] + adc_data[BRAKEPIN_2]) / 2;
 
+		pedal_values.accel1_norm = accel1_norm;
+		pedal_values.accel2_norm = accel2_norm;
+		pedal_values.accel = accel_val;
+		pedal_values.brake = brake_val;
+		signal_publish(SIGNAL_PEDAL, (signal_value_t){ .u = accel_val });
+
 		/* Turn brakelight on or off */
 		write_brakelight(pdu, brake_val > PEDAL_BRAKE_THRESH);
-		set_brake_state(brake_val > PEDAL_BRAKE_THRESH);
+		signal_publish(SIGNAL_BRAKE, (signal_value_t){
+						     .b = brake_val >
+							  PEDAL_BRAKE_THRESH });
 
 		/* 0.0 - 1.0 */
-		float accelerator_value = (float)accel_val / 100.0;
-
-		if (calc_bspd_prefault(accelerator_value, brake_val)) {
-			/* Prefault triggered */
-			osDelay(delay_time);
-			continue;
-		}
+		float accelerator_value = (float)accel_val / 100.0f;
 
 		float mph = dti_get_mph(mc);
-		func_state_t func_state = get_func_state();
-
-		switch (func_state) {
-		case F_EFFICIENCY:
-			handle_endurance(mc, mph, accelerator_value, brake_val);
-			break;
-		case F_PERFORMANCE:
-			linear_accel_to_torque(accelerator_value);
-			break;
-		case F_PIT:
-			handle_pit(mph, accelerator_value);
-			break;
-		case REVERSE:
-			handle_reverse(mph, accelerator_value);
-			break;
-		default:
-			dti_set_torque(0);
-			break;
-		}
-
-		osDelay(delay_time);
+		bool prefault = calc_bspd_prefault(accelerator_value, brake_val);
+
+		/* No torque is commanded while the BSPD prefault is triggered */
+		if (!prefault)
+			drive(mc, mph, accelerator_value, brake_val);
+
+		blackbox_sample_t sample = {
+			.time = now_us(),
+			.adc = { adc_data[ACCELPIN_2], adc_data[ACCELPIN_1],
+				 adc_data[BRAKEPIN_1], adc_data[BRAKEPIN_2] },
+			.accel1 = accel1_norm,
+			.accel2 = accel2_norm,
+			.accel = accel_val,
+			.func_state = func_state,
+			.brake = brake_val,
+			.flags = (prefault ? BLACKBOX_BSPD_PREFAULT : 0) |
+				 (brake_val > PEDAL_BRAKE_THRESH ?
+					  BLACKBOX_BRAKE :
+					  0),
+			.mph = mph,
+		};
+		dti_get_command(&sample.torque, &sample.current);
+		blackbox_record(&sample);
+
+		/* Sample the DAQ lists once everything this iteration computed is in memory */
+		xcp_event(XCP_EVENT_PEDALS);
+
+		task_sched_complete(TASK_PEDALS);
+		next_release += TASK_PERIOD(PEDALS);
+		osDelayUntil(next_release);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+/**
+ * @file probe.c
+ * @brief Execution time probes for hot functions.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "probe.h"
+
+#ifdef PROBE_ENABLE
+#include "can_handler.h"
+#include "cerberus_conf.h"
+#include "serial_monitor.h"
+#include "task_sched.h"
+#include <stdbool.h>
+
+#define PROBE_NAME(name) #name,
+static const char *probe_names[NUM_PROBES] = { PROBE_TABLE(PROBE_NAME) };
+
+#define PROBE_CLEAR(name) { .min = UINT32_MAX },
+probe_t probes[NUM_PROBES] = { PROBE_TABLE(PROBE_CLEAR) };
+
+/* Largest value of a 24 bit field in a dump frame */
+#define PROBE_CYCLES_MAX 0xFFFFFF
+
+void probe_reset(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	for (probe_id_t id = 0; id < NUM_PROBES; id++)
+		probes[id] = (probe_t){ .min = UINT32_MAX };
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief Take a copy of a probe, and optionally clear it in the same critical section so no passes are lost.
+ */
+static void probe_snapshot(probe_id_t id, probe_t *snapshot, bool reset)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*snapshot = probes[id];
+	if (reset)
+		probes[id] = (probe_t){ .min = UINT32_MAX };
+	__set_PRIMASK(primask);
+}
+
+static void put_cycles(uint8_t *data, uint32_t cycles)
+{
+	if (cycles > PROBE_CYCLES_MAX)
+		cycles = PROBE_CYCLES_MAX;
+
+	data[0] = cycles & 0xFF;
+	data[1] = (cycles >> 8) & 0xFF;
+	data[2] = (cycles >> 16) & 0xFF;
+}
+
+void probe_dump(bool reset)
+{
+	for (probe_id_t id = 0; id < NUM_PROBES; id++) {
+		probe_t probe;
+		probe_snapshot(id, &probe, reset);
+
+		uint32_t min = probe.count ? probe.min : 0;
+		uint32_t avg = probe.count ? probe.total / probe.count : 0;
+
+		/* Telemetry, we do not care if it fails */
+		can_msg_t msg = { .id = CANID_PROBE_DUMP,
+				  .len = 8,
+				  .data = { 0 } };
+		msg.data[0] = id;
+		msg.data[1] = probe.count & 0xFF;
+		msg.data[2] = (probe.count >> 8) & 0xFF;
+		msg.data[3] = (probe.count >> 16) & 0xFF;
+		msg.data[4] = (probe.count >> 24) & 0xFF;
+		put_cycles(&msg.data[5], avg);
+		queue_can_msg(msg);
+
+		msg.data[0] = id | 0x80;
+		put_cycles(&msg.data[1], min);
+		put_cycles(&msg.data[4], probe.max);
+		msg.data[7] = 0;
+		queue_can_msg(msg);
+
+		serial_print(
+			"%-18s count %lu min %lu avg %lu max %lu cycles, max %lu us\r\n",
+			probe_names[id], probe.count, min, avg, probe.max,
+			task_sched_cycles_to_us(probe.max));
+	}
+}
+
+void handle_probe_request(can_msg_t msg)
+{
+	switch (msg.data[0]) {
+	case PROBE_DUMP:
+		probe_dump(false);
+		break;
+	case PROBE_DUMP_AND_RESET:
+		probe_dump(true);
+		break;
+	case PROBE_RESET:
+		probe_reset();
+		break;
+	default:
+		break;
+	}
+}
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file queue_stats.c
+ * @brief High water marks of every message queue.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "queue_stats.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+
+/* Indexed by queue number, which is the queue's index plus one */
+uint32_t queue_stats_high_water[QUEUE_STATS_MAX_QUEUES + 1];
+
+static QueueHandle_t queues[QUEUE_STATS_MAX_QUEUES];
+static uint32_t num_queues;
+
+void queue_stats_created(void *queue, uint32_t item_size)
+{
+	/* Queues are created during init, and the timer queue inside a kernel critical section, so nothing races this */
+	if (!item_size || num_queues >= QUEUE_STATS_MAX_QUEUES)
+		return;
+
+	queues[num_queues] = queue;
+	vQueueSetQueueNumber(queue, ++num_queues);
+}
+
+uint32_t queue_stats_num_queues(void)
+{
+	return num_queues;
+}
+
+void queue_stats_get(uint32_t index, queue_stats_t *stats)
+{
+	QueueHandle_t queue = queues[index];
+
+	stats->handle = queue;
+	stats->name = pcQueueGetName(queue);
+	stats->waiting = uxQueueMessagesWaiting(queue);
+	stats->length = stats->waiting + uxQueueSpacesAvailable(queue);
+	stats->high_water = queue_stats_high_water[index + 1];
+}
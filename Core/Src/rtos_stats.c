@@ -0,0 +1,157 @@
+/**
+ * @file rtos_stats.c
+ * @brief Per task CPU load, stack headroom and heap telemetry, built on the FreeRTOS run time stats.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "rtos_stats.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "can_handler.h"
+#include "cerberus_conf.h"
+#include "serial_monitor.h"
+#include "task_sched.h"
+#include "ccmram.h"
+
+static TaskStatus_t tasks[RTOS_STATS_MAX_TASKS];
+
+/* Run time counters at the last report, to get the load over each report period */
+static struct {
+	TaskHandle_t handle;
+	uint32_t run_time;
+} last[RTOS_STATS_MAX_TASKS];
+static UBaseType_t num_last;
+
+/**
+ * @brief Get how many cycles a task ran for since the last report.
+ *
+ * @param task Task status from the current snapshot
+ * @return uint32_t CPU cycles
+ */
+static uint32_t run_time_since_last(const TaskStatus_t *task)
+{
+	for (UBaseType_t i = 0; i < num_last; i++) {
+		/* The counter wraps every ~25 s at 168 MHz, which unsigned subtraction handles as long as reports are more frequent */
+		if (last[i].handle == task->xHandle)
+			return task->ulRunTimeCounter - last[i].run_time;
+	}
+
+	/* Created since the last report */
+	return task->ulRunTimeCounter;
+}
+
+/**
+ * @brief Sort a snapshot by task number, so tasks keep their CAN mux between reports.
+ */
+static void sort_by_task_number(TaskStatus_t *snapshot, UBaseType_t num_tasks)
+{
+	for (UBaseType_t i = 1; i < num_tasks; i++) {
+		TaskStatus_t task = snapshot[i];
+		UBaseType_t j = i;
+		while (j > 0 && snapshot[j - 1].xTaskNumber > task.xTaskNumber) {
+			snapshot[j] = snapshot[j - 1];
+			j--;
+		}
+		snapshot[j] = task;
+	}
+}
+
+osThreadId_t rtos_stats_handle;
+static StaticTask_t rtos_stats_cb CCM_BSS(rtos_stats_cb);
+static uint32_t rtos_stats_stack[128 * 8 / sizeof(uint32_t)]
+	CCM_BSS(rtos_stats_stack);
+const osThreadAttr_t rtos_stats_attributes = {
+	.name = "RtosStats",
+	.cb_mem = &rtos_stats_cb,
+	.cb_size = sizeof(rtos_stats_cb),
+	.stack_mem = rtos_stats_stack,
+	.stack_size = sizeof(rtos_stats_stack),
+	.priority = TASK_PRIORITY(RTOS_STATS),
+};
+
+void vRtosStats(void *pv_params)
+{
+	uint32_t reports = 0;
+	uint32_t next_release = osKernelGetTickCount();
+
+	for (;;) {
+		task_sched_release(TASK_RTOS_STATS);
+
+		UBaseType_t num_tasks = uxTaskGetSystemState(
+			tasks, RTOS_STATS_MAX_TASKS, NULL);
+		sort_by_task_number(tasks, num_tasks);
+
+		TaskHandle_t idle = xTaskGetIdleTaskHandle();
+		uint32_t load[RTOS_STATS_MAX_TASKS];
+		uint64_t total = 0;
+		uint32_t idle_load = 0;
+
+		for (UBaseType_t i = 0; i < num_tasks; i++) {
+			load[i] = run_time_since_last(&tasks[i]);
+			total += load[i];
+		}
+
+		/* Per mille of the CPU time since the last report */
+		for (UBaseType_t i = 0; i < num_tasks; i++) {
+			load[i] = total ? (uint64_t)load[i] * 1000 / total : 0;
+			if (tasks[i].xHandle == idle)
+				idle_load = load[i];
+
+			last[i].handle = tasks[i].xHandle;
+			last[i].run_time = tasks[i].ulRunTimeCounter;
+		}
+		num_last = num_tasks;
+
+		uint32_t min_free_heap = xPortGetMinimumEverFreeHeapSize();
+		uint32_t free_heap = xPortGetFreeHeapSize();
+		uint32_t dropped = serial_dropped();
+
+		/* Telemetry, we do not care if it fails */
+		can_msg_t msg = { .id = CANID_RTOS_STATS, .len = 8, .data = { 0 } };
+		msg.data[1] = idle_load / 10;
+		msg.data[2] = min_free_heap & 0xFF;
+		msg.data[3] = (min_free_heap >> 8) & 0xFF;
+		msg.data[4] = free_heap & 0xFF;
+		msg.data[5] = (free_heap >> 8) & 0xFF;
+		msg.data[6] = num_tasks;
+		msg.data[7] = dropped > UINT8_MAX ? UINT8_MAX : dropped;
+		queue_can_msg(msg);
+
+		for (UBaseType_t i = 0; i < num_tasks; i++) {
+			uint32_t stack_left = tasks[i].usStackHighWaterMark *
+					      sizeof(StackType_t); /* bytes */
+
+			msg.data[0] = i + 1;
+			msg.data[1] = tasks[i].xTaskNumber;
+			msg.data[2] = load[i] & 0xFF;
+			msg.data[3] = (load[i] >> 8) & 0xFF;
+			msg.data[4] = stack_left & 0xFF;
+			msg.data[5] = (stack_left >> 8) & 0xFF;
+			msg.data[6] = tasks[i].uxBasePriority;
+			msg.data[7] = tasks[i].pcTaskName[0];
+			queue_can_msg(msg);
+		}
+
+		if (++reports % RTOS_STATS_SERIAL_EVERY == 0) {
+			serial_print(
+				"Idle %lu.%lu%% heap free %lu min %lu serial dropped %lu\r\n",
+				idle_load / 10, idle_load % 10, free_heap,
+				min_free_heap, dropped);
+			for (UBaseType_t i = 0; i < num_tasks; i++) {
+				uint32_t stack_left =
+					tasks[i].usStackHighWaterMark *
+					sizeof(StackType_t); /* bytes */
+				serial_print(
+					"%-16s %3lu.%lu%% stack left %lu\r\n",
+					tasks[i].pcTaskName, load[i] / 10,
+					load[i] % 10, stack_left);
+			}
+		}
+
+		next_release += TASK_PERIOD(RTOS_STATS);
+		osDelayUntil(next_release);
+	}
+}
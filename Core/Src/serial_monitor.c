@@ -1,21 +1,136 @@
 #include "serial_monitor.h"
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
-#include "cerb_utils.h"
 
-#define PRINTF_QUEUE_SIZE 25 /* Strings */
+#define SERIAL_RING_LEN	 4096 /* Bytes, must be a power of 2 */
 #define PRINTF_BUFFER_LEN 128 /* Characters */
-#define NEW_MESSAGE_FLAG  0x00000001U
+#define SERIAL_RX_LEN	 64 /* Bytes, must be a power of 2 */
 
-osMessageQueueId_t printf_queue;
-osThreadId_t serial_monitor_handle;
-const osThreadAttr_t serial_monitor_attributes = {
-	.name = "SerialMonitor",
-	.stack_size = 32 * 32,
-	.priority = (osPriority_t)osPriorityHigh,
-};
+_Static_assert((SERIAL_RING_LEN & (SERIAL_RING_LEN - 1)) == 0,
+	       "Serial ring length must be a power of 2");
+_Static_assert((SERIAL_RX_LEN & (SERIAL_RX_LEN - 1)) == 0,
+	       "Serial receive ring length must be a power of 2");
+
+/* Read by the DMA, so it has to stay out of CCM RAM */
+static uint8_t uart_dma_ring[SERIAL_RING_LEN];
+
+/*
+ * Free running byte counts, the ring offset is the count modulo the length.
+ * Producers claim space by moving reserved, copy into it, and the last one
+ * out moves committed up to cover everything that has been copied. The DMA
+ * sends from sent up to committed.
+ */
+static volatile uint32_t reserved;
+static volatile uint32_t committed;
+static volatile uint32_t sent;
+static volatile uint32_t writers; /* Producers between reserving and committing */
+static volatile uint32_t dropped;
+
+static volatile bool tx_busy; /* Held by whoever is starting or running a DMA transfer */
+static uint32_t tx_len; /* Bytes in the running transfer */
+static UART_HandleTypeDef *uart;
+
+/* Received bytes, written by the interrupt and read by one task */
+static uint8_t rx_ring[SERIAL_RX_LEN];
+static volatile uint32_t rx_head;
+static volatile uint32_t rx_tail;
+static osThreadId_t rx_reader;
+static uint32_t rx_flag;
+
+/**
+ * @brief Start a DMA transfer of the committed bytes if none is running. Transfers stop at the end of the ring, the completion interrupt starts the rest.
+ */
+static void serial_kick(void)
+{
+	for (;;) {
+		if (!uart || __atomic_test_and_set(&tx_busy, __ATOMIC_ACQUIRE))
+			return;
+
+		uint32_t start = sent;
+		uint32_t offset = start & (SERIAL_RING_LEN - 1);
+		uint32_t len = committed - start;
+		if (len > SERIAL_RING_LEN - offset)
+			len = SERIAL_RING_LEN - offset;
+
+		/* Set before the transfer starts, it can complete before the call returns */
+		tx_len = len;
+		if (len && HAL_UART_Transmit_DMA(uart, &uart_dma_ring[offset],
+						 len) == HAL_OK)
+			return;
+
+		tx_len = 0;
+		__atomic_clear(&tx_busy, __ATOMIC_RELEASE);
+
+		/* A producer may have committed and seen the transfer still busy */
+		if (len || committed == sent)
+			return;
+	}
+}
+
+/**
+ * @brief Finish a write. Only the last producer out publishes, at which point everything reserved before it has been copied.
+ */
+static void serial_commit(void)
+{
+	for (;;) {
+		uint32_t end = __atomic_load_n(&reserved, __ATOMIC_ACQUIRE);
+		uint32_t last = 1;
+
+		if (!__atomic_compare_exchange_n(&writers, &last, 0, false,
+						 __ATOMIC_ACQ_REL,
+						 __ATOMIC_RELAXED)) {
+			/* Someone else is still copying, they will publish */
+			__atomic_fetch_sub(&writers, 1, __ATOMIC_RELEASE);
+			return;
+		}
+
+		/* Only ever move forward, another producer may have published further already */
+		uint32_t done = __atomic_load_n(&committed, __ATOMIC_RELAXED);
+		while ((int32_t)(end - done) > 0 &&
+		       !__atomic_compare_exchange_n(&committed, &done, end, true,
+						    __ATOMIC_RELEASE,
+						    __ATOMIC_RELAXED))
+			;
+
+		/* An interrupt may have reserved and copied between reading reserved and publishing */
+		if (__atomic_load_n(&reserved, __ATOMIC_ACQUIRE) == end)
+			return;
+		__atomic_fetch_add(&writers, 1, __ATOMIC_ACQUIRE);
+	}
+}
+
+int serial_write(const void *data, size_t len)
+{
+	if (len == 0)
+		return 0;
+
+	__atomic_fetch_add(&writers, 1, __ATOMIC_ACQUIRE);
+
+	uint32_t start = __atomic_load_n(&reserved, __ATOMIC_RELAXED);
+	do {
+		if (start + len - sent > SERIAL_RING_LEN) {
+			serial_commit();
+			__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			return -1;
+		}
+	} while (!__atomic_compare_exchange_n(&reserved, &start, start + len,
+					      true, __ATOMIC_ACQ_REL,
+					      __ATOMIC_RELAXED));
+
+	uint32_t offset = start & (SERIAL_RING_LEN - 1);
+	size_t first = SERIAL_RING_LEN - offset;
+	if (first > len)
+		first = len;
+	memcpy(&uart_dma_ring[offset], data, first);
+	memcpy(uart_dma_ring, (const uint8_t *)data + first, len - first);
+
+	serial_commit();
+	serial_kick();
+
+	return 0;
+}
 
 /*
  * Referenced https://github.com/esp8266/Arduino/blob/master/cores/esp8266/Print.cpp
@@ -24,49 +139,101 @@ const osThreadAttr_t serial_monitor_attributes = {
 int serial_print(const char *format, ...)
 {
 	va_list arg;
-	char *buffer = malloc(sizeof(char) * PRINTF_BUFFER_LEN);
-	if (buffer == NULL)
-		return -1;
+	char buffer[PRINTF_BUFFER_LEN];
 
 	/* Format Variadic Args into string */
 	va_start(arg, format);
-	size_t len = vsnprintf(buffer, PRINTF_BUFFER_LEN, format, arg);
+	int len = vsnprintf(buffer, PRINTF_BUFFER_LEN, format, arg);
 	va_end(arg);
 
 	/* Check to make sure we don't overflow buffer */
-	if (len > PRINTF_BUFFER_LEN - 1) {
-		free(buffer);
+	if (len < 0 || len > PRINTF_BUFFER_LEN - 1)
 		return -2;
-	}
 
-	/* If string can't be queued */
+	return serial_write(buffer, len);
+}
 
-	osStatus_t stat = queue_and_set_flag(
-		printf_queue, &buffer, serial_monitor_handle, NEW_MESSAGE_FLAG);
-	if (stat) {
-		free(buffer);
-		return -3;
-	}
+uint32_t serial_dropped(void)
+{
+	return dropped;
+}
 
-	return 0;
+int serial_read(uint8_t *byte)
+{
+	uint32_t tail = rx_tail;
+	if (tail == __atomic_load_n(&rx_head, __ATOMIC_ACQUIRE))
+		return 0;
+
+	*byte = rx_ring[tail & (SERIAL_RX_LEN - 1)];
+	__atomic_store_n(&rx_tail, tail + 1, __ATOMIC_RELEASE);
+	return 1;
 }
 
-void vSerialMonitor(void *pv_params)
+void serial_set_reader(osThreadId_t thread, uint32_t flag)
 {
-	char *message;
+	rx_flag = flag;
+	rx_reader = thread;
+}
+
+void serial_monitor_rx_isr(void)
+{
+	if (!uart)
+		return;
 
-	printf_queue =
-		osMessageQueueNew(PRINTF_QUEUE_SIZE, sizeof(char *), NULL);
+	/*
+	 * Reading DR clears RXNE along with any error flags, so the HAL handler
+	 * that runs after this is left with only the transmit side to deal with
+	 */
+	bool received = false;
+	while (__HAL_UART_GET_FLAG(uart, UART_FLAG_RXNE)) {
+		uint8_t byte = uart->Instance->DR;
+		uint32_t head = rx_head;
 
-	for (;;) {
-		osThreadFlagsWait(NEW_MESSAGE_FLAG, osFlagsWaitAny,
-				  osWaitForever);
-
-		/* Get message to print */
-		while (osMessageQueueGet(printf_queue, &message, NULL, 0U) ==
-		       osOK) {
-			printf(message);
-			free(message);
+		/* Drop bytes rather than overwrite ones the reader has not seen */
+		if (head - rx_tail < SERIAL_RX_LEN) {
+			rx_ring[head & (SERIAL_RX_LEN - 1)] = byte;
+			__atomic_store_n(&rx_head, head + 1, __ATOMIC_RELEASE);
 		}
+		received = true;
+	}
+
+	if (received && rx_reader)
+		osThreadFlagsSet(rx_reader, rx_flag);
+}
+
+void serial_monitor_init(UART_HandleTypeDef *huart)
+{
+	uart = huart;
+
+	/* Receive straight off the data register, the HAL's receive calls would fight the DMA transfers over the handle lock */
+	__HAL_UART_ENABLE_IT(huart, UART_IT_RXNE);
+
+	/* Anything printed during boot has been waiting in the ring */
+	serial_kick();
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if (huart != uart)
+		return;
+
+	sent += tx_len;
+	__atomic_clear(&tx_busy, __ATOMIC_RELEASE);
+	serial_kick();
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if (huart != uart)
+		return;
+
+	/* The HAL turns receive interrupts off on an error */
+	__HAL_UART_ENABLE_IT(huart, UART_IT_RXNE);
+
+	/* A failed transfer never completes, skip what it held so output keeps moving */
+	if (huart->ErrorCode & HAL_UART_ERROR_DMA) {
+		sent += tx_len;
+		__atomic_clear(&tx_busy, __ATOMIC_RELEASE);
+		serial_kick();
 	}
 }
@@ -0,0 +1,146 @@
+/**
+ * @file signals.c
+ * @brief Latest value of state shared between tasks, published and read without locking.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "signals.h"
+#include "cerb_utils.h"
+#include <stdio.h>
+
+/*
+ * Each signal keeps two copies of its value. The producer writes the copy
+ * readers are not using, then bumps the version to switch them over, so a
+ * reader that preempts the producer always sees a whole value. A reader that
+ * is preempted by the producer sees the version change and copies again.
+ */
+typedef struct {
+	struct {
+		signal_value_t value;
+		uint32_t time;
+	} slots[2]; /* slots[version % 2] is the latest */
+	uint32_t version;
+
+	osThreadId_t subscribers[SIGNAL_MAX_SUBSCRIBERS];
+	uint32_t flags[SIGNAL_MAX_SUBSCRIBERS];
+	uint32_t num_subscribers;
+} signal_t;
+
+static signal_t signals[NUM_SIGNALS];
+
+typedef enum { TYPE_b, TYPE_i, TYPE_u, TYPE_f } signal_type_t;
+
+#define SIGNAL_INFO(id, member) { #id, TYPE_##member },
+static const struct {
+	const char *name;
+	signal_type_t type;
+} info[NUM_SIGNALS] = { SIGNAL_TABLE(SIGNAL_INFO) };
+
+/**
+ * @brief Compare two values of a signal, only looking at the bytes its type uses.
+ */
+static bool same_value(signal_id_t id, signal_value_t a, signal_value_t b)
+{
+	if (info[id].type == TYPE_b)
+		return a.b == b.b;
+	return a.u == b.u;
+}
+
+void signal_publish(signal_id_t id, signal_value_t value)
+{
+	signal_t *signal = &signals[id];
+	uint32_t version = signal->version;
+	bool changed = !version ||
+		       !same_value(id, signal->slots[version % 2].value, value);
+
+	signal->slots[(version + 1) % 2].value = value;
+	signal->slots[(version + 1) % 2].time = osKernelGetTickCount();
+	__atomic_store_n(&signal->version, version + 1, __ATOMIC_RELEASE);
+
+	if (!changed)
+		return;
+
+	uint32_t num_subscribers =
+		__atomic_load_n(&signal->num_subscribers, __ATOMIC_ACQUIRE);
+	for (uint32_t i = 0; i < num_subscribers; i++)
+		osThreadFlagsSet(signal->subscribers[i], signal->flags[i]);
+}
+
+void signal_read(signal_id_t id, signal_sample_t *sample)
+{
+	signal_t *signal = &signals[id];
+	uint32_t version = __atomic_load_n(&signal->version, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		sample->value = signal->slots[version % 2].value;
+		sample->time = signal->slots[version % 2].time;
+		sample->version = version;
+
+		/* Keep the slot reads ahead of checking the version again */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		uint32_t now = __atomic_load_n(&signal->version,
+					       __ATOMIC_RELAXED);
+		if (now == version)
+			return;
+		version = now;
+	}
+}
+
+uint32_t signal_age(signal_id_t id)
+{
+	signal_sample_t sample;
+	signal_read(id, &sample);
+
+	if (!sample.version)
+		return UINT32_MAX;
+
+	return osKernelGetTickCount() - sample.time;
+}
+
+int signal_subscribe(signal_id_t id, uint32_t flags)
+{
+	signal_t *signal = &signals[id];
+	int ret = -1;
+
+	/* Subscribers to the same signal could race each other for a slot */
+	int32_t lock = osKernelLock();
+	uint32_t i = signal->num_subscribers;
+	if (i < SIGNAL_MAX_SUBSCRIBERS) {
+		signal->subscribers[i] = osThreadGetId();
+		signal->flags[i] = flags;
+		/* Only counted once it is filled in, the producer does not lock */
+		__atomic_store_n(&signal->num_subscribers, i + 1,
+				 __ATOMIC_RELEASE);
+		ret = 0;
+	}
+	osKernelRestoreLock(lock);
+
+	return ret;
+}
+
+const char *signal_name(signal_id_t id)
+{
+	return info[id].name;
+}
+
+void signal_format(signal_id_t id, signal_value_t value, char *buf,
+		   uint32_t len)
+{
+	switch (info[id].type) {
+	case TYPE_b:
+		snprintf(buf, len, "%s", value.b ? "true" : "false");
+		break;
+	case TYPE_i:
+		snprintf(buf, len, "%ld", (long)value.i);
+		break;
+	case TYPE_u:
+		snprintf(buf, len, "%lu", (unsigned long)value.u);
+		break;
+	case TYPE_f:
+		format_float(buf, len, value.f);
+		break;
+	}
+}
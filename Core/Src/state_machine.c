@@ -8,16 +8,23 @@
 #include "nero.h"
 #include "queues.h"
 #include "pedals.h"
+#include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "cerb_utils.h"
+#include "task_sched.h"
+#include "ccmram.h"
+#include "log.h"
+#include "mailbox.h"
+#include "signals.h"
 
 #define STATE_TRANS_QUEUE_SIZE 4
-#define STATE_TRANSITION_FLAG  1U
 
-/* Internal State of Vehicle */
-static state_t cerberus_state;
+/* Internal State of Vehicle, only written by the director task */
+static state_t cerberus_state = { .functional = READY,
+				  .nero = { .nero_index = 0,
+					    .home_mode = true } };
 
 typedef struct {
 	enum { FUNCTIONAL, NERO } id;
@@ -25,96 +32,254 @@ typedef struct {
 		func_state_t functional;
 		nero_state_t nero;
 	} state;
+	uint32_t requested; /* CPU cycles */
 } state_req_t;
 
+/* Handled requests, only written by the director task */
+static state_trace_t state_trace[STATE_TRACE_LEN];
+static uint32_t state_trace_count;
+
+static const char *result_names[NUM_TRANSITION_RESULTS] = {
+	[TRANSITION_OK] = "ok",
+	[TRANSITION_NOT_ALLOWED] = "not allowed",
+	[TRANSITION_MOVING] = "moving",
+	[TRANSITION_BRAKE_OFF] = "brake off",
+	[TRANSITION_TSMS_OFF] = "tsms off",
+	[TRANSITION_FAULT_ACTIVE] = "fault active",
+};
+
 osThreadId_t sm_director_handle;
+static StaticTask_t sm_director_cb CCM_BSS(sm_director_cb);
+static uint32_t sm_director_stack[128 * 8 / sizeof(uint32_t)]
+	CCM_BSS(sm_director_stack);
 const osThreadAttr_t sm_director_attributes = {
 	.name = "State Machine Director",
-	.stack_size = 128 * 8,
-	.priority = (osPriority_t)osPriorityRealtime7,
+	.cb_mem = &sm_director_cb,
+	.cb_size = sizeof(sm_director_cb),
+	.stack_mem = sm_director_stack,
+	.stack_size = sizeof(sm_director_stack),
+	.priority = TASK_PRIORITY(STATE_MACHINE),
 };
 
-static osMessageQueueId_t state_trans_queue;
+static mailbox_t state_trans_mailbox;
+static uint8_t state_trans_mailbox_buf[MAILBOX_BUF_SIZE(STATE_TRANS_QUEUE_SIZE,
+							state_req_t)];
 
 func_state_t get_func_state()
 {
-	return cerberus_state.functional;
+	return signal_get(SIGNAL_FUNC_STATE).u;
+}
+
+bool is_active_state(func_state_t functional)
+{
+	return functional == F_EFFICIENCY || functional == F_PERFORMANCE ||
+	       functional == F_PIT || functional == REVERSE;
 }
 
 bool get_active()
 {
-	return cerberus_state.functional == F_EFFICIENCY ||
-	       cerberus_state.functional == F_PERFORMANCE ||
-	       cerberus_state.functional == F_PIT ||
-	       cerberus_state.functional == REVERSE;
+	/* Read once so a transition can't land between the comparisons */
+	return is_active_state(get_func_state());
 }
 
 nero_state_t get_nero_state()
 {
-	return cerberus_state.nero;
+	/* Wider than a word, so the copy could be torn by the director */
+	int32_t lock = osKernelLock();
+	nero_state_t nero = cerberus_state.nero;
+	osKernelRestoreLock(lock);
+
+	return nero;
 }
 
-static int transition_functional_state(func_state_t new_state, pdu_t *pdu,
-				       dti_t *mc)
+/**
+ * @brief Publish a new NERO state without readers seeing half of it.
+ */
+static void set_nero_state(nero_state_t nero)
 {
-	/* Catching state transitions */
-	switch (new_state) {
-	case READY:
-		/* Make sure wheels are not spinning before changing modes */
-		if (dti_get_mph(mc) > 1)
-			return 1;
-
-		/* Turn off high power peripherals */
-		// write_fan_battbox(pdu, false);
-		write_pump(pdu, false);
-		write_fault(pdu, false);
-		serial_print("READY\r\n");
-		break;
-	case F_PIT:
-	case F_PERFORMANCE:
-	case F_EFFICIENCY:
-		/* Entering active state from home mode */
-		if (cerberus_state.functional != REVERSE) {
-			/* Check that motor is not spinning before changing modes */
-			if (dti_get_mph(mc) > 1)
-				return 2;
-			/* Only turn on motor if brakes engaged and tsms is on */
-			if (!get_brake_state() || !get_tsms()) {
-				return 3;
-			}
-			osThreadFlagsSet(rtds_thread, SOUND_RTDS_FLAG);
-		}
+	int32_t lock = osKernelLock();
+	cerberus_state.nero = nero;
+	osKernelRestoreLock(lock);
+}
+
+/*
+ * Functional transitions. The director takes the first row whose from and to
+ * masks hold the current and requested state, checks its guards in order and
+ * then runs its actions in order. A request that matches no row is refused.
+ */
+enum { NO_CAR_FAULT, STOPPED, BRAKE_ENGAGED, TSMS_ON, NUM_GUARDS };
+enum {
+	SOUND_RTDS,
+	PUMP_ON,
+	PUMP_OFF,
+	FAULT_LIGHT_ON,
+	FAULT_LIGHT_OFF,
+	NERO_OFF,
+	NUM_ACTIONS
+};
+
+typedef struct {
+	uint32_t from; /* Mask of states */
+	uint32_t to; /* Mask of states */
+	uint32_t guards; /* Mask of guards, checked in order */
+	uint32_t actions; /* Mask of actions, run in order */
+	const char *log; /* Logged once the transition is made, or NULL */
+} transition_t;
+
+#define STATE(state)   (1U << (state))
+#define ANY_STATE      (STATE(MAX_FUNC_STATES) - 1)
+#define ACTIVE_STATES  (STATE(F_PIT) | STATE(F_PERFORMANCE) | STATE(F_EFFICIENCY))
+#define GUARD(guard)   (1U << (guard))
+#define ACTION(action) (1U << (action))
+
+static const transition_t transitions[] = {
+	/* Make sure wheels are not spinning before changing modes, and never leave FAULTED while the fault is still raised */
+	{ ANY_STATE, STATE(READY), GUARD(NO_CAR_FAULT) | GUARD(STOPPED),
+	  ACTION(PUMP_OFF) | ACTION(FAULT_LIGHT_OFF), "READY\r\n" },
+	/* Leaving reverse, the motor is already live */
+	{ STATE(REVERSE), ACTIVE_STATES, GUARD(NO_CAR_FAULT),
+	  ACTION(PUMP_ON) | ACTION(FAULT_LIGHT_OFF), "ACTIVE STATE\r\n" },
+	/* Entering active state from home mode, only turn on the motor if it is stopped, brakes are engaged and TSMS is on */
+	{ ANY_STATE & ~STATE(REVERSE), ACTIVE_STATES,
+	  GUARD(NO_CAR_FAULT) | GUARD(STOPPED) | GUARD(BRAKE_ENGAGED) |
+		  GUARD(TSMS_ON),
+	  ACTION(SOUND_RTDS) | ACTION(PUMP_ON) | ACTION(FAULT_LIGHT_OFF),
+	  "ACTIVE STATE\r\n" },
+	/* Can only enter reverse mode if already in pit mode */
+	{ STATE(F_PIT), STATE(REVERSE), 0, 0, NULL },
+	{ ANY_STATE, STATE(FAULTED), 0,
+	  ACTION(PUMP_OFF) | ACTION(FAULT_LIGHT_ON) | ACTION(NERO_OFF),
+	  "FAULTED\r\n" },
+};
+
+#define NUM_TRANSITIONS (sizeof(transitions) / sizeof(transitions[0]))
+
+static bool guard_no_car_fault(const sm_director_args_t *args)
+{
+	return !fault_car_active();
+}
+
+static bool guard_stopped(const sm_director_args_t *args)
+{
+	return dti_get_mph(args->mc) <= 1;
+}
+
+static bool guard_brake_engaged(const sm_director_args_t *args)
+{
+	return get_brake_state();
+}
 
-		/* Turn on high power peripherals */
-		// write_fan_battbox(pdu, true);
-		write_pump(pdu, true);
-		write_fault(pdu, false);
-		serial_print("ACTIVE STATE\r\n");
+static bool guard_tsms_on(const sm_director_args_t *args)
+{
+	return get_tsms();
+}
+
+static const struct {
+	bool (*check)(const sm_director_args_t *args);
+	transition_result_t reason; /* Given if the check fails */
+} guards[NUM_GUARDS] = {
+	[NO_CAR_FAULT] = { guard_no_car_fault, TRANSITION_FAULT_ACTIVE },
+	[STOPPED] = { guard_stopped, TRANSITION_MOVING },
+	[BRAKE_ENGAGED] = { guard_brake_engaged, TRANSITION_BRAKE_OFF },
+	[TSMS_ON] = { guard_tsms_on, TRANSITION_TSMS_OFF },
+};
+
+static void run_action(uint32_t action, const sm_director_args_t *args)
+{
+	switch (action) {
+	case SOUND_RTDS:
+		osThreadFlagsSet(rtds_thread, SOUND_RTDS_FLAG);
+		break;
+	case PUMP_ON:
+		// write_fan_battbox(args->pdu, true);
+		write_pump(args->pdu, true);
 		break;
-	case REVERSE:
-		/* Can only enter reverse mode if already in pit mode */
-		if (cerberus_state.functional != F_PIT)
-			return 4;
+	case PUMP_OFF:
+		// write_fan_battbox(args->pdu, false);
+		write_pump(args->pdu, false);
 		break;
-	case FAULTED:
-		/* Turn off high power peripherals */
-		// write_fan_battbox(pdu, true);
-		write_pump(pdu, false);
-		write_fault(pdu, true);
-		cerberus_state.nero =
-			(nero_state_t){ .nero_index = OFF, .home_mode = false };
-		serial_print("FAULTED\r\n");
+	case FAULT_LIGHT_ON:
+		write_fault(args->pdu, true);
 		break;
-	default:
-		// Do Nothing
+	case FAULT_LIGHT_OFF:
+		write_fault(args->pdu, false);
+		break;
+	case NERO_OFF:
+		set_nero_state((nero_state_t){ .nero_index = OFF,
+					       .home_mode = false });
 		break;
 	}
+}
+
+static transition_result_t
+transition_functional_state(func_state_t new_state,
+			    const sm_director_args_t *args)
+{
+	const transition_t *transition = NULL;
+
+	for (uint32_t i = 0; i < NUM_TRANSITIONS; i++) {
+		if ((transitions[i].from & STATE(cerberus_state.functional)) &&
+		    (transitions[i].to & STATE(new_state))) {
+			transition = &transitions[i];
+			break;
+		}
+	}
+
+	if (!transition)
+		return TRANSITION_NOT_ALLOWED;
+
+	for (uint32_t guard = 0; guard < NUM_GUARDS; guard++) {
+		if ((transition->guards & GUARD(guard)) &&
+		    !guards[guard].check(args))
+			return guards[guard].reason;
+	}
+
+	for (uint32_t action = 0; action < NUM_ACTIONS; action++) {
+		if (transition->actions & ACTION(action))
+			run_action(action, args);
+	}
+
+	if (transition->log)
+		LOG("%s", transition->log);
 
 	cerberus_state.functional = new_state;
-	return 0;
+	signal_publish(SIGNAL_FUNC_STATE, (signal_value_t){ .u = new_state });
+	return TRANSITION_OK;
+}
+
+/**
+ * @brief Work out the functional transition a NERO request asks for.
+ *
+ * @return func_state_t The functional state to enter, or MAX_FUNC_STATES if there is none
+ */
+static func_state_t nero_event(nero_state_t current, nero_state_t new_state)
+{
+	// Wasn't in home mode and still are not in home mode (Infer a Select Request)
+	if (!current.home_mode && !new_state.home_mode) {
+		// Only Check if we are in pit mode to toggle direction
+		if (current.nero_index == PIT) {
+			if (cerberus_state.functional == REVERSE)
+				return F_PIT;
+			if (cerberus_state.functional == F_PIT)
+				return REVERSE;
+		}
+	}
+
+	// Selecting a mode on NERO
+	if (current.home_mode && !new_state.home_mode) {
+		if (new_state.nero_index < DEBUG && new_state.nero_index > OFF)
+			return (func_state_t)new_state.nero_index;
+	}
+
+	// Entering home mode
+	if (!current.home_mode && new_state.home_mode)
+		return READY;
+
+	return MAX_FUNC_STATES;
 }
 
-static int transition_nero_state(nero_state_t new_state, pdu_t *pdu, dti_t *mc)
+static transition_result_t
+transition_nero_state(nero_state_t new_state, const sm_director_args_t *args)
 {
 	nero_state_t current_nero_state = get_nero_state();
 
@@ -128,52 +293,44 @@ static int transition_nero_state(nero_state_t new_state, pdu_t *pdu, dti_t *mc)
 	if (new_state.nero_index >= MAX_NERO_STATES)
 		new_state.nero_index = MAX_NERO_STATES - 1;
 
-	// Wasn't in home mode and still are not in home mode (Infer a Select Request)
-	if (!current_nero_state.home_mode && !new_state.home_mode) {
-		// Only Check if we are in pit mode to toggle direction
-		if (current_nero_state.nero_index == PIT) {
-			if (get_func_state() == REVERSE) {
-				if (transition_functional_state(F_PIT, pdu, mc))
-					return 1;
-			} else if (get_func_state() == F_PIT) {
-				if (transition_functional_state(REVERSE, pdu,
-								mc))
-					return 1;
-			}
-		}
+	func_state_t event = nero_event(current_nero_state, new_state);
+	if (event != MAX_FUNC_STATES) {
+		transition_result_t result =
+			transition_functional_state(event, args);
+		if (result)
+			return result;
 	}
 
-	// Selecting a mode on NERO
-	if (current_nero_state.home_mode && !new_state.home_mode) {
-		if (new_state.nero_index < DEBUG &&
-		    new_state.nero_index > OFF) {
-			if (transition_functional_state(new_state.nero_index,
-							pdu, mc))
-				return 1;
-		}
-	}
-
-	// Entering home mode
-	if (!current_nero_state.home_mode && new_state.home_mode) {
-		if (transition_functional_state(READY, pdu, mc))
-			return 1;
-	}
-
-	cerberus_state.nero = new_state;
+	set_nero_state(new_state);
 	/* Notify NERO */
 	send_nero_msg();
 
-	return 0;
+	return TRANSITION_OK;
 }
 
-static int queue_state_transition(state_req_t new_state)
+/**
+ * @brief Record a handled request in the transition trace.
+ */
+static void trace_transition(const state_req_t *req, uint32_t from,
+			     uint32_t to, transition_result_t result)
 {
-	if (!state_trans_queue) {
-		return 1;
-	}
+	state_trace_t *entry =
+		&state_trace[state_trace_count % STATE_TRACE_LEN];
+
+	entry->latency =
+		task_sched_cycles_to_us(DWT->CYCCNT - req->requested);
+	entry->nero = req->id == NERO;
+	entry->from = from;
+	entry->to = to;
+	entry->result = result;
+	__atomic_store_n(&state_trace_count, state_trace_count + 1,
+			 __ATOMIC_RELEASE);
+}
 
-	return queue_and_set_flag(state_trans_queue, &new_state,
-				  sm_director_handle, STATE_TRANSITION_FLAG);
+static int queue_state_transition(state_req_t new_state)
+{
+	new_state.requested = DWT->CYCCNT;
+	return mailbox_post(&state_trans_mailbox, &new_state);
 }
 
 /* HANDLE USER INPUT */
@@ -220,44 +377,90 @@ int set_home_mode()
 				.home_mode = true } });
 }
 
+int request_func_state(func_state_t new_state)
+{
+	if (new_state >= MAX_FUNC_STATES)
+		return -1;
+
+	return queue_state_transition((state_req_t){
+		.id = FUNCTIONAL, .state.functional = new_state });
+}
+
+int request_nero_state(nero_state_t new_state)
+{
+	if (new_state.nero_index >= MAX_NERO_STATES)
+		return -1;
+
+	return queue_state_transition(
+		(state_req_t){ .id = NERO, .state.nero = new_state });
+}
+
 int fault()
 {
 	return queue_state_transition(
 		(state_req_t){ .id = FUNCTIONAL, .state.functional = FAULTED });
 }
 
-void vStateMachineDirector(void *pv_params)
+uint32_t state_trace_num()
 {
-	cerberus_state.functional = READY;
-	cerberus_state.nero.nero_index = 0;
-	cerberus_state.nero.home_mode = true;
+	uint32_t count = __atomic_load_n(&state_trace_count, __ATOMIC_ACQUIRE);
 
-	state_trans_queue = osMessageQueueNew(STATE_TRANS_QUEUE_SIZE,
-					      sizeof(state_req_t), NULL);
+	return count < STATE_TRACE_LEN ? count : STATE_TRACE_LEN;
+}
 
+void state_trace_get(uint32_t n, state_trace_t *entry)
+{
+	/* The director could overwrite the entry part way through the copy */
+	int32_t lock = osKernelLock();
+	uint32_t count = state_trace_count;
+	uint32_t oldest = count < STATE_TRACE_LEN ? 0 : count - STATE_TRACE_LEN;
+	*entry = state_trace[(oldest + n) % STATE_TRACE_LEN];
+	osKernelRestoreLock(lock);
+}
+
+const char *transition_result_name(transition_result_t result)
+{
+	return result_names[result];
+}
+
+void state_machine_init()
+{
+	signal_publish(SIGNAL_FUNC_STATE,
+		       (signal_value_t){ .u = cerberus_state.functional });
+	mailbox_init(&state_trans_mailbox, "StateTransQueue",
+		     state_trans_mailbox_buf, STATE_TRANS_QUEUE_SIZE,
+		     sizeof(state_req_t));
+}
+
+void vStateMachineDirector(void *pv_params)
+{
 	state_req_t new_state_req;
 
-	sm_director_args_t *args = (sm_director_args_t *)pv_params;
-	pdu_t *pdu = args->pdu;
-	dti_t *mc = args->mc;
-	free(args);
+	const sm_director_args_t *args = (sm_director_args_t *)pv_params;
 
 	/* Write to GPIO expander to set initial state */
-	write_pump(pdu, false);
-	write_fault(pdu, false);
+	write_pump(args->pdu, false);
+	write_fault(args->pdu, false);
 
 	for (;;) {
-		osThreadFlagsWait(STATE_TRANSITION_FLAG, osFlagsWaitAny,
-				  osWaitForever);
-		while (osMessageQueueGet(state_trans_queue, &new_state_req,
-					 NULL, osWaitForever) == osOK) {
-			if (new_state_req.id == NERO)
-				transition_nero_state(new_state_req.state.nero,
-						      pdu, mc);
-			else if (new_state_req.id == FUNCTIONAL)
-				transition_functional_state(
-					new_state_req.state.functional, pdu,
-					mc);
+		if (mailbox_wait(&state_trans_mailbox, &new_state_req,
+				 osWaitForever)) {
+			transition_result_t result;
+			uint32_t from, to;
+
+			if (new_state_req.id == NERO) {
+				from = get_nero_state().nero_index;
+				to = new_state_req.state.nero.nero_index;
+				result = transition_nero_state(
+					new_state_req.state.nero, args);
+			} else {
+				from = cerberus_state.functional;
+				to = new_state_req.state.functional;
+				result = transition_functional_state(
+					new_state_req.state.functional, args);
+			}
+
+			trace_transition(&new_state_req, from, to, result);
 		}
 	}
 }
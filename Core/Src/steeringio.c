@@ -1,5 +1,6 @@
 #include "steeringio.h"
 #include "can.h"
+#include "can_handler.h"
 #include "cerberus_conf.h"
 #include "cmsis_os.h"
 #include <assert.h>
@@ -7,38 +8,79 @@
 #include <string.h>
 #include "state_machine.h"
 #include "serial_monitor.h"
+#include "fault.h"
 #include "nero.h"
 #include "stdio.h"
-#include "cerb_utils.h"
 #include "pedals.h"
+#include "task_sched.h"
+#include "ccmram.h"
+#include "probe.h"
+#include "log.h"
+#include "timebase.h"
 
-#define CAN_QUEUE_SIZE 5 /* messages */
+/* PC4 and PC5 share EXTI lines 4 and 5 with PA4 and PA5, so they are polled instead */
+#define SHARED_LINES_GPIO_Port GPIOC
+#define SHARED_LINES_Pins      (GPIO_PIN_4 | GPIO_PIN_5)
 
-static osMutexAttr_t steeringio_data_mutex_attributes;
+static steeringio_t steeringio_data;
 
-static void debounce_cb(void *arg);
+static StaticSemaphore_t steeringio_data_mutex_cb;
+static const osMutexAttr_t steeringio_data_mutex_attributes = {
+	.name = "SteeringIOMutex",
+	.cb_mem = &steeringio_data_mutex_cb,
+	.cb_size = sizeof(steeringio_data_mutex_cb),
+};
+
+/* Wheel being serviced by the EXTI and debounce timer interrupts */
+static steeringio_t *isr_wheel;
 
 enum { NOT_PRESSED, PRESSED };
 
-typedef struct debounce_cb_args_t {
-	steeringio_t *wheel;
-	steeringio_button_t button;
-} debounce_cb_args_t;
+/**
+ * @brief Sample every steering wheel input.
+ *
+ * @return uint8_t Buffer where each bit is a raw button status.
+ */
+static uint8_t read_buttons(void)
+{
+	uint8_t button_1 = !HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_4);
+	uint8_t button_2 = !HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_5);
+	uint8_t button_3 = !HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_6);
+	uint8_t button_4 = !HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_7);
+	uint8_t button_5 = !HAL_GPIO_ReadPin(GPIOC, GPIO_PIN_4);
+	uint8_t button_6 = HAL_GPIO_ReadPin(GPIOC, GPIO_PIN_5);
+	/* PB0 is the LV sense input, so this always reads 0 while it is analog */
+	uint8_t button_7 = HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_0);
+	uint8_t button_8 = !HAL_GPIO_ReadPin(GPIOB, GPIO_PIN_1);
 
-steeringio_t *steeringio_init()
+	return (button_1 << 7) | (button_2 << 6) | (button_3 << 5) |
+	       (button_4 << 4) | (button_5 << 3) | (button_6 << 2) |
+	       (button_7 << 1) | (button_8);
+}
+
+steeringio_t *steeringio_init(TIM_HandleTypeDef *debounce_tim)
 {
-	steeringio_t *steeringio = malloc(sizeof(steeringio_t));
-	assert(steeringio);
+	assert(debounce_tim);
+
+	steeringio_t *steeringio = &steeringio_data;
 
 	steeringio->button_mutex =
 		osMutexNew(&steeringio_data_mutex_attributes);
 	assert(steeringio->button_mutex);
 
-	/* Create debounce utilities */
-	for (uint8_t i = 0; i < MAX_STEERING_BUTTONS; i++) {
-		steeringio->debounce_timers[i] = malloc(sizeof(nertimer_t));
-		assert(steeringio->debounce_timers[i]);
-	}
+	steeringio->debounce_tim = debounce_tim;
+	steeringio->confirmed_data = read_buttons();
+	steeringio->shared_lines_state =
+		SHARED_LINES_GPIO_Port->IDR & SHARED_LINES_Pins;
+
+	/* Window ends after the debounce period */
+	uint32_t window = STEERING_WHEEL_DEBOUNCE * STEERING_DEBOUNCE_TIM_HZ /
+			  1000; /* ticks */
+	__HAL_TIM_SET_AUTORELOAD(debounce_tim, window - 1);
+	__HAL_TIM_CLEAR_FLAG(debounce_tim, TIM_FLAG_UPDATE);
+	__HAL_TIM_ENABLE_IT(debounce_tim, TIM_IT_UPDATE);
+
+	isr_wheel = steeringio;
 
 	return steeringio;
 }
@@ -57,6 +99,83 @@ bool get_steeringio_button(steeringio_t *wheel, steeringio_button_t button)
 	return ret;
 }
 
+void steeringio_edge_isr(uint16_t pin)
+{
+	steeringio_t *wheel = isr_wheel;
+	if (!wheel)
+		return;
+
+	uint8_t head = wheel->edge_head;
+	uint8_t next = (head + 1) & (STEERING_EDGE_QUEUE_SIZE - 1);
+
+	if (next == wheel->edge_tail) {
+		/* Queue full, the task will still see the confirmed state */
+		wheel->dropped_edges++;
+	} else {
+		wheel->edges[head].timestamp = timebase_local();
+		wheel->edges[head].pin = pin;
+		/* Entry must be written before it is published */
+		__DMB();
+		wheel->edge_head = next;
+	}
+
+	/* (Re)start the debounce window */
+	__HAL_TIM_SET_COUNTER(wheel->debounce_tim, 0);
+	__HAL_TIM_ENABLE(wheel->debounce_tim);
+}
+
+void steeringio_debounce_isr(void)
+{
+	steeringio_t *wheel = isr_wheel;
+	if (!wheel)
+		return;
+
+	/* No edges for a full debounce period, so the inputs have settled */
+	uint8_t button_data = read_buttons();
+
+	/* Input bounced back to where it started */
+	if (button_data == wheel->confirmed_data)
+		return;
+
+	wheel->confirmed_data = button_data;
+	osThreadFlagsSet(steeringio_thread, STEERING_CONFIRMED_FLAG);
+}
+
+void steeringio_poll_shared_lines(steeringio_t *wheel)
+{
+	uint16_t state = SHARED_LINES_GPIO_Port->IDR & SHARED_LINES_Pins;
+	uint16_t changed = state ^ wheel->shared_lines_state;
+
+	if (!changed)
+		return;
+
+	wheel->shared_lines_state = state;
+	/* Go through the EXTI interrupt so the ISR stays the only producer */
+	__HAL_GPIO_EXTI_GENERATE_SWIT(changed);
+}
+
+/**
+ * @brief Pop the oldest edge off of the edge queue.
+ *
+ * @param wheel Pointer to struct defining steering wheel interface.
+ * @param edge Pointer to location the edge will be copied to.
+ * @return bool True if an edge was popped, false if the queue was empty.
+ */
+static bool pop_edge(steeringio_t *wheel, steeringio_edge_t *edge)
+{
+	uint8_t tail = wheel->edge_tail;
+
+	if (tail == wheel->edge_head)
+		return false;
+
+	*edge = wheel->edges[tail];
+	/* Entry must be read before the slot is handed back */
+	__DMB();
+	wheel->edge_tail = (tail + 1) & (STEERING_EDGE_QUEUE_SIZE - 1);
+
+	return true;
+}
+
 static void paddle_left_cb()
 {
 	if (get_func_state() == F_EFFICIENCY) {
@@ -72,107 +191,129 @@ static void paddle_right_cb()
 }
 
 /**
- * @brief Callback after a button has been debounced.
- * 
- * @param arg Pointer to debounce_cb_args_t
+ * @brief Handle a button that has just been pressed.
+ *
+ * @param button The button that was pressed
  */
-static void debounce_cb(void *arg)
+static void button_pressed(steeringio_button_t button)
 {
-	debounce_cb_args_t *args = (debounce_cb_args_t *)arg;
-	if (!args)
-		return;
-
-	steeringio_button_t button = args->button;
-
-	if (!button)
-		return;
-
-	steeringio_t *wheel = args->wheel;
-
-	if (wheel->raw_buttons[button] && !wheel->debounced[button]) {
-		wheel->debounced[button] = true;
-		switch (button) {
-		case STEERING_PADDLE_LEFT:
-			paddle_left_cb();
-			break;
-		case STEERING_PADDLE_RIGHT:
-			paddle_right_cb();
-			break;
-		case NERO_BUTTON_UP:
-			serial_print("Up button pressed \r\n");
-			decrement_nero_index();
-			break;
-		case NERO_BUTTON_DOWN:
-			serial_print("Down button pressed \r\n");
-			increment_nero_index();
-			break;
-		case NERO_BUTTON_LEFT:
-			// doesnt effect cerb for now
-			break;
-		case NERO_BUTTON_RIGHT:
-			// doesnt effect cerb for now
-			break;
-		case NERO_BUTTON_SELECT:
-			printf("Select button pressed \r\n");
-			select_nero_index();
-			break;
-		case NERO_HOME:
-			serial_print("Home button pressed \r\n");
-			set_home_mode();
-			break;
-		default:
-			break;
-		}
-	} else if (!wheel->raw_buttons[button]) {
-		/* Button is no longer pressed, so it can be pressed again */
-		wheel->debounced[button] = false;
+	switch (button) {
+	case STEERING_PADDLE_LEFT:
+		paddle_left_cb();
+		break;
+	case STEERING_PADDLE_RIGHT:
+		paddle_right_cb();
+		break;
+	case NERO_BUTTON_UP:
+		LOG("Up button pressed \r\n");
+		decrement_nero_index();
+		break;
+	case NERO_BUTTON_DOWN:
+		LOG("Down button pressed \r\n");
+		increment_nero_index();
+		break;
+	case NERO_BUTTON_LEFT:
+		// doesnt effect cerb for now
+		break;
+	case NERO_BUTTON_RIGHT:
+		// doesnt effect cerb for now
+		break;
+	case NERO_BUTTON_SELECT:
+		LOG("Select button pressed \r\n");
+		select_nero_index();
+		break;
+	case NERO_HOME:
+		LOG("Home button pressed \r\n");
+		set_home_mode();
+		break;
+	default:
+		break;
 	}
 }
 
 /**
- * @brief Debounce every button input and update the state of the steering wheel.
- * 
+ * @brief Update the state of the steering wheel and handle any new presses.
+ *
  * @param wheel Pointer to struct defining steering wheel interface.
- * @param button_data Buffer containing button data where each bit is a button.
+ * @param button_data Buffer containing debounced button data where each bit is a button.
  */
 void steeringio_update(steeringio_t *wheel, uint8_t button_data)
 {
-	/* Copy message data to wheelio buffer */
-	osMutexAcquire(wheel->button_mutex, osWaitForever);
-	/* Data is formatted with each bit within the first byte representing a button and the first two bits of the second byte representing the paddle shifters */
+	PROBE_START(STEERINGIO_UPDATE);
+
+	bool buttons[MAX_STEERING_BUTTONS];
 
-	/* Update raw buttons */
+	/* Data is formatted with each bit within the first byte representing a button and the first two bits of the second byte representing the paddle shifters */
 	for (uint8_t i = 0; i < MAX_STEERING_BUTTONS - 2; i++) {
-		wheel->raw_buttons[i] = (button_data >> i) & 0x01;
+		buttons[i] = (button_data >> i) & 0x01;
 	}
 
-	/* Update raw paddle shifters */
-	wheel->raw_buttons[STEERING_PADDLE_LEFT] =
+	/* Update paddle shifters */
+	buttons[STEERING_PADDLE_LEFT] =
 		NOT_PRESSED; //(wheel_data[1] >> 0) & 0x01;
-	wheel->raw_buttons[STEERING_PADDLE_RIGHT] =
+	buttons[STEERING_PADDLE_RIGHT] =
 		NOT_PRESSED; //(wheel_data[1] >> 1) & 0x01;
 
-	/* Debounce buttons */
+	osMutexAcquire(wheel->button_mutex, osWaitForever);
 	for (uint8_t i = 0; i < MAX_STEERING_BUTTONS; i++) {
-		debounce_cb_args_t *debounce_args =
-			malloc(sizeof(debounce_cb_args_t));
-		debounce_args->wheel = wheel;
-		debounce_args->button = i;
-
-		if (wheel->raw_buttons[i])
-			debounce(wheel->raw_buttons[i],
-				 wheel->debounce_timers[i],
-				 STEERING_WHEEL_DEBOUNCE, &debounce_cb,
-				 debounce_args);
-
-		/* Debounce that the button has been unpressed */
-		else
-			debounce(!wheel->raw_buttons[i],
-				 wheel->debounce_timers[i],
-				 STEERING_WHEEL_DEBOUNCE, &debounce_cb,
-				 debounce_args);
-
-		free(debounce_args);
+		/* Only act on presses, a button must be released before it can be pressed again */
+		bool pressed = buttons[i] && !wheel->debounced_buttons[i];
+		wheel->debounced_buttons[i] = buttons[i];
+
+		if (pressed)
+			button_pressed(i);
 	}
 	osMutexRelease(wheel->button_mutex);
+
+	PROBE_END(STEERINGIO_UPDATE);
+}
+
+osThreadId_t steeringio_thread;
+static StaticTask_t steeringio_cb CCM_BSS(steeringio_cb);
+static uint32_t steeringio_stack[128 * 8 / sizeof(uint32_t)]
+	CCM_BSS(steeringio_stack);
+const osThreadAttr_t steeringio_attributes = {
+	.name = "SteeringIO",
+	.cb_mem = &steeringio_cb,
+	.cb_size = sizeof(steeringio_cb),
+	.stack_mem = steeringio_stack,
+	.stack_size = sizeof(steeringio_stack),
+	.priority = TASK_PRIORITY(STEERINGIO),
+};
+
+void vSteeringIO(void *pv_params)
+{
+	steeringio_t *wheel = (steeringio_t *)pv_params;
+
+	fault_data_t fault_data = { .id = BUTTONS_MONITOR_FAULT,
+				    .severity = DEFCON5 };
+	can_msg_t msg = { .id = STEERING_CANID_IO, .len = 8, .data = { 0 } };
+	steeringio_edge_t edge;
+
+	for (;;) {
+		osThreadFlagsWait(STEERING_CONFIRMED_FLAG, osFlagsWaitAny,
+				  osWaitForever);
+
+		uint8_t button_data = wheel->confirmed_data;
+
+		/* Edges since the last confirmed change, oldest first */
+		uint32_t first_edge = timebase_local();
+		bool have_edge = false;
+		while (pop_edge(wheel, &edge)) {
+			if (!have_edge)
+				first_edge = edge.timestamp;
+			have_edge = true;
+		}
+		wheel->press_latency = timebase_local() - first_edge;
+
+		steeringio_update(wheel, button_data);
+
+		/* Set the first byte to be the first 8 buttons with each bit representing the pin status */
+		msg.data[0] = button_data;
+		if (queue_can_msg(msg)) {
+			fault_data.diag =
+				"Failed to send steering buttons can message";
+			queue_fault(&fault_data);
+		}
+	}
 }
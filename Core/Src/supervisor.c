@@ -0,0 +1,122 @@
+/**
+ * @file supervisor.c
+ * @brief Deadline monitor and watchdog supervisor.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "supervisor.h"
+#include "fault.h"
+#include "ccmram.h"
+#include "log.h"
+#include <stdbool.h>
+
+_Static_assert(NUM_SCHED_TASKS <= 32, "Registered tasks are kept in a bitmask");
+
+#define TASK_SCHED_NAME(name, period, deadline, arg) #name,
+static const char *task_names[NUM_SCHED_TASKS] = { TASK_SCHED_TABLE(
+	TASK_SCHED_NAME, 0) };
+
+#define TASK_SCHED_PERIOD(name, period, deadline, arg) period,
+static const uint32_t periods[NUM_SCHED_TASKS] = { TASK_SCHED_TABLE(
+	TASK_SCHED_PERIOD, 0) }; /* ms */
+
+static volatile uint32_t registered; /* One bit per task */
+static uint32_t registered_at[NUM_SCHED_TASKS]; /* ms */
+
+void supervisor_register(task_id_t task)
+{
+	int32_t lock = osKernelLock();
+	/* Counts as the first check in */
+	registered_at[task] = osKernelGetTickCount();
+	registered |= 1U << task;
+	osKernelRestoreLock(lock);
+}
+
+osThreadId_t supervisor_handle;
+static StaticTask_t supervisor_cb CCM_BSS(supervisor_cb);
+static uint32_t supervisor_stack[128 * 4 / sizeof(uint32_t)]
+	CCM_BSS(supervisor_stack);
+const osThreadAttr_t supervisor_attributes = {
+	.name = "Supervisor",
+	.cb_mem = &supervisor_cb,
+	.cb_size = sizeof(supervisor_cb),
+	.stack_mem = supervisor_stack,
+	.stack_size = sizeof(supervisor_stack),
+	.priority = TASK_PRIORITY(SUPERVISOR),
+};
+
+void vSupervisor(void *pv_params)
+{
+	IWDG_HandleTypeDef *hiwdg = (IWDG_HandleTypeDef *)pv_params;
+
+	fault_data_t fault_data = { .id = DEADLINE_MISS_FAULT,
+				    .severity = DEFCON3 };
+
+	/* Only fault once per stall or run of overruns */
+	uint32_t stuck = 0;
+	uint32_t overrunning = 0;
+
+	uint32_t next_release = osKernelGetTickCount();
+
+	for (;;) {
+		task_sched_release(TASK_SUPERVISOR);
+
+		uint32_t now = osKernelGetTickCount();
+		bool healthy = true;
+
+		for (task_id_t task = 0; task < NUM_SCHED_TASKS; task++) {
+			uint32_t bit = 1U << task;
+			if (!(registered & bit))
+				continue;
+
+			task_sched_stats_t stats;
+			task_sched_get_stats(task, &stats);
+
+			uint32_t interval = periods[task] ? periods[task] :
+							    SUPERVISOR_HEARTBEAT;
+			uint32_t last_checkin = stats.last_complete ?
+							stats.last_complete :
+							registered_at[task];
+			uint32_t silent = now - last_checkin; /* ms */
+
+			if (silent > interval * SUPERVISOR_MISSED_CHECKINS) {
+				healthy = false;
+				if (!(stuck & bit)) {
+					LOG("%s has not checked in for %lu ms\r\n",
+					    task_names[task], silent);
+					fault_data.diag =
+						"Task stopped checking in";
+					queue_fault(&fault_data);
+				}
+				stuck |= bit;
+			} else {
+				stuck &= ~bit;
+			}
+
+			if (stats.overruns_in_row >= SUPERVISOR_OVERRUN_LIMIT) {
+				if (!(overrunning & bit)) {
+					LOG("%s missed %lu deadlines in a row, max execution %lu us\r\n",
+					    task_names[task], stats.overruns_in_row,
+					    task_sched_cycles_to_us(stats.max_exec));
+					fault_data.diag =
+						"Task missed its deadline";
+					queue_fault(&fault_data);
+				}
+				overrunning |= bit;
+			} else {
+				overrunning &= ~bit;
+			}
+		}
+
+		/* A stuck task stops the refreshes, and the IWDG resets the MCU */
+		if (healthy)
+			HAL_IWDG_Refresh(hiwdg);
+
+		task_sched_complete(TASK_SUPERVISOR);
+		next_release += TASK_PERIOD(SUPERVISOR);
+		osDelayUntil(next_release);
+	}
+}
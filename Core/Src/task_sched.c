@@ -0,0 +1,102 @@
+/**
+ * @file task_sched.c
+ * @brief Release time tracking for the periodic tasks.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "task_sched.h"
+#include "stm32f4xx.h"
+#include <string.h>
+
+/* The timer service task is created by the kernel, so its priority has to be set in FreeRTOSConfig.h */
+_Static_assert(configTIMER_TASK_PRIORITY == TASK_PRIORITY(TIMER_SERVICE),
+	       "configTIMER_TASK_PRIORITY does not match the task table");
+
+static task_sched_stats_t stats[NUM_SCHED_TASKS];
+
+#define TASK_SCHED_DEADLINE(name, period, deadline, arg) deadline,
+static const uint32_t deadlines[NUM_SCHED_TASKS] = { TASK_SCHED_TABLE(
+	TASK_SCHED_DEADLINE, 0) }; /* ms */
+
+void task_sched_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	for (task_id_t task = 0; task < NUM_SCHED_TASKS; task++)
+		task_sched_reset_stats(task);
+}
+
+void task_sched_release(task_id_t task)
+{
+	uint32_t now = DWT->CYCCNT;
+	task_sched_stats_t *task_stats = &stats[task];
+
+	/* Stats can be reset from another task */
+	int32_t lock = osKernelLock();
+
+	if (task_stats->releases) {
+		/* Unsigned subtraction handles the counter wrapping */
+		uint32_t period = now - task_stats->last_release;
+		if (period < task_stats->min_period)
+			task_stats->min_period = period;
+		if (period > task_stats->max_period)
+			task_stats->max_period = period;
+	}
+
+	task_stats->last_release = now;
+	task_stats->releases++;
+
+	osKernelRestoreLock(lock);
+}
+
+void task_sched_complete(task_id_t task)
+{
+	uint32_t now = DWT->CYCCNT;
+	uint32_t deadline = deadlines[task] * (SystemCoreClock / 1000); /* cycles */
+	task_sched_stats_t *task_stats = &stats[task];
+
+	int32_t lock = osKernelLock();
+
+	uint32_t exec = now - task_stats->last_release;
+	if (exec > task_stats->max_exec)
+		task_stats->max_exec = exec;
+
+	if (exec > deadline) {
+		task_stats->overruns++;
+		task_stats->overruns_in_row++;
+	} else {
+		task_stats->overruns_in_row = 0;
+	}
+
+	task_stats->last_complete = osKernelGetTickCount();
+
+	osKernelRestoreLock(lock);
+}
+
+void task_sched_get_stats(task_id_t task, task_sched_stats_t *task_stats)
+{
+	int32_t lock = osKernelLock();
+	*task_stats = stats[task];
+	osKernelRestoreLock(lock);
+}
+
+void task_sched_reset_stats(task_id_t task)
+{
+	int32_t lock = osKernelLock();
+	/* Keep the last check in, so the supervisor doesn't see a reset as a stall */
+	uint32_t last_complete = stats[task].last_complete;
+	memset(&stats[task], 0, sizeof(task_sched_stats_t));
+	stats[task].min_period = UINT32_MAX;
+	stats[task].last_complete = last_complete;
+	osKernelRestoreLock(lock);
+}
+
+uint32_t task_sched_cycles_to_us(uint32_t cycles)
+{
+	return cycles / (SystemCoreClock / 1000000);
+}
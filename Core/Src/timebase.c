@@ -0,0 +1,19 @@
+/**
+ * @file timebase.c
+ * @brief Microsecond timebase shared by every timestamp the car records.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "timebase.h"
+#include <assert.h>
+
+volatile uint32_t timebase_offset;
+
+void timebase_init(TIM_HandleTypeDef *htim)
+{
+	assert(htim->Instance == TIMEBASE_TIM);
+	assert(!HAL_TIM_Base_Start(htim));
+}
@@ -0,0 +1,172 @@
+/**
+ * @file timesync.c
+ * @brief Time sync over CAN, as the master or a slave.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "timesync.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "can_handler.h"
+#include "cerberus_conf.h"
+#include "clock_profile.h"
+#include "cmsis_os.h"
+#include "timebase.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/* A standard 8 byte data frame without stuff bits, start of frame to end of frame */
+#define SYNC_FRAME_BITS 108
+#define SYNC_FRAME_US	(SYNC_FRAME_BITS * CLOCK_TIMEBASE_HZ / CLOCK_CAN_BITRATE)
+
+static timesync_status_t status;
+
+#ifndef TIMESYNC_SLAVE
+
+static void put_time(can_msg_t *msg, uint32_t time)
+{
+	msg->data[4] = time >> 24;
+	msg->data[5] = time >> 16;
+	msg->data[6] = time >> 8;
+	msg->data[7] = time;
+}
+
+static uint8_t sequence;
+
+static StaticTimer_t sync_timer_cb;
+static const osTimerAttr_t sync_timer_attributes = {
+	.name = "TimeSync",
+	.cb_mem = &sync_timer_cb,
+	.cb_size = sizeof(sync_timer_cb),
+};
+
+static void send_sync(void *arg)
+{
+	can_msg_t msg = { .id = CANID_TIME_SYNC,
+			  .len = 8,
+			  .data = { TIMESYNC_SYNC, sequence++ } };
+	put_time(&msg, now_us());
+	queue_can_msg(msg);
+}
+
+void timesync_init(void)
+{
+	status.master = true;
+	status.synced = true;
+
+	osTimerId_t sync_timer = osTimerNew(send_sync, osTimerPeriodic, NULL,
+					    &sync_timer_attributes);
+	assert(sync_timer);
+	assert(!osTimerStart(sync_timer, TIMESYNC_PERIOD));
+}
+
+void timesync_sent(const can_msg_t *msg, uint32_t sent)
+{
+	can_msg_t fup = { .id = CANID_TIME_SYNC,
+			  .len = 8,
+			  .data = { TIMESYNC_FUP, msg->data[1] } };
+	put_time(&fup, sent + SYNC_FRAME_US);
+	queue_can_msg(fup);
+
+	status.syncs++;
+	status.last = sent;
+}
+
+/* The master only sends */
+void timesync_received_from_isr(const can_msg_t *msg, uint32_t local)
+{
+}
+
+void timesync_handle(const can_msg_t *msg)
+{
+}
+
+void timesync_get_status(timesync_status_t *out)
+{
+	*out = status;
+}
+
+#else
+
+static uint32_t get_time(const can_msg_t *msg)
+{
+	return ((uint32_t)msg->data[4] << 24) | (msg->data[5] << 16) |
+	       (msg->data[6] << 8) | msg->data[7];
+}
+
+/* The last SYNC received, waiting for its FUP */
+static struct {
+	uint32_t local;
+	uint8_t sequence;
+	bool valid;
+} received;
+
+/* Local time of the last sync, which keeps counting when bus time is stepped */
+static uint32_t last_local;
+
+void timesync_init(void)
+{
+}
+
+void timesync_received_from_isr(const can_msg_t *msg, uint32_t local)
+{
+	if (msg->data[0] != TIMESYNC_SYNC)
+		return;
+
+	received.local = local;
+	received.sequence = msg->data[1];
+	received.valid = true;
+}
+
+static bool in_sync(void)
+{
+	return status.synced &&
+	       timebase_local() - last_local < TIMESYNC_TIMEOUT * 1000;
+}
+
+void timesync_handle(const can_msg_t *msg)
+{
+	if (msg->data[0] != TIMESYNC_FUP)
+		return;
+
+	/* The receive interrupt records the next SYNC */
+	taskENTER_CRITICAL();
+	bool valid = received.valid && received.sequence == msg->data[1];
+	uint32_t local = received.local;
+	received.valid = false;
+	taskEXIT_CRITICAL();
+
+	/* A lost SYNC or FUP skips a round */
+	if (!valid)
+		return;
+
+	int32_t error = get_time(msg) - (local + timebase_offset);
+
+	/* Step out a large error, but only slew a small one so time never jumps back by much */
+	if (!in_sync() || abs(error) > TIMESYNC_STEP_US)
+		timebase_offset += error;
+	else
+		timebase_offset += error / 2;
+
+	status.synced = true;
+	status.syncs++;
+	status.error = error;
+	status.last = now_us();
+	last_local = local;
+}
+
+/* Slaves never send a SYNC */
+void timesync_sent(const can_msg_t *msg, uint32_t sent)
+{
+}
+
+void timesync_get_status(timesync_status_t *out)
+{
+	*out = status;
+	out->synced = in_sync();
+}
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * @file trace.c
+ * @brief Kernel event trace recorder.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "trace.h"
+#include "ccmram.h"
+#include "stm32f4xx.h"
+#include "timebase.h"
+#include <stddef.h>
+
+static trace_event_t events[TRACE_BUFFER_LEN] CCM_BSS(trace_events);
+
+/* Events recorded since the buffer was last cleared */
+static uint32_t head;
+static volatile bool frozen;
+static volatile bool paused;
+
+static uint8_t current_task;
+static const char *task_names[TRACE_MAX_TASKS];
+
+void trace_record(trace_event_type_t type, uint16_t arg)
+{
+	if (frozen || paused)
+		return;
+
+	/* Called from interrupts and from inside the kernel, so only masking everything is safe */
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	trace_event_t *event = &events[head & (TRACE_BUFFER_LEN - 1)];
+	event->timestamp = now_us();
+	event->type = type;
+	event->task = current_task;
+	event->arg = arg;
+	head++;
+
+	__set_PRIMASK(primask);
+}
+
+void trace_task_switched_in(uint32_t task, uint32_t priority)
+{
+	current_task = task;
+	trace_record(TRACE_TASK_SWITCHED_IN, priority);
+}
+
+void trace_task_created(uint32_t task, const char *name)
+{
+	/* The name lives in the task's control block */
+	if (task < TRACE_MAX_TASKS)
+		task_names[task] = name;
+}
+
+void trace_isr_enter(void)
+{
+	trace_record(TRACE_ISR_ENTER, __get_IPSR());
+}
+
+void trace_isr_exit(void)
+{
+	trace_record(TRACE_ISR_EXIT, __get_IPSR());
+}
+
+void trace_freeze(void)
+{
+	trace_record(TRACE_FREEZE, 0);
+	frozen = true;
+}
+
+void trace_resume(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	head = 0;
+	frozen = false;
+	__set_PRIMASK(primask);
+}
+
+void trace_pause(bool pause)
+{
+	paused = pause;
+}
+
+uint32_t trace_num_events(void)
+{
+	return head < TRACE_BUFFER_LEN ? head : TRACE_BUFFER_LEN;
+}
+
+void trace_get_event(uint32_t n, trace_event_t *event)
+{
+	/* Once the buffer has wrapped, the oldest event is the next one to be overwritten */
+	uint32_t oldest = head < TRACE_BUFFER_LEN ? 0 : head;
+	*event = events[(oldest + n) & (TRACE_BUFFER_LEN - 1)];
+}
+
+const char *trace_task_name(uint32_t task)
+{
+	return task < TRACE_MAX_TASKS ? task_names[task] : NULL;
+}
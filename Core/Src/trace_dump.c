@@ -0,0 +1,153 @@
+/**
+ * @file trace_dump.c
+ * @brief Sends the kernel event trace over CAN or the serial console on request.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "trace_dump.h"
+#include "trace.h"
+#include "FreeRTOS.h"
+#include "can_handler.h"
+#include "cerberus_conf.h"
+#include "serial_monitor.h"
+#include "task_sched.h"
+#include "ccmram.h"
+#include "clock_profile.h"
+#include <string.h>
+
+#define TRACE_DUMP_CAN_FLAG  1U
+#define TRACE_DUMP_UART_FLAG 2U
+
+/* Give up on a dump if the bus or console stops draining */
+#define TRACE_DUMP_TIMEOUT 100 /* ms */
+
+/* Only queue a record while this much of the CAN queue is free, so a dump never crowds out control frames */
+#define TRACE_DUMP_CAN_RESERVE (CAN_MSG_QUEUE_SIZE / 2)
+
+void handle_trace_request(can_msg_t msg)
+{
+	switch (msg.data[0]) {
+	case TRACE_DUMP_CAN:
+		osThreadFlagsSet(trace_dump_handle, TRACE_DUMP_CAN_FLAG);
+		break;
+	case TRACE_DUMP_UART:
+		osThreadFlagsSet(trace_dump_handle, TRACE_DUMP_UART_FLAG);
+		break;
+	case TRACE_RESUME:
+		trace_resume();
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief Send one record of a dump, waiting for room in the CAN or print queue.
+ *
+ * @param flag TRACE_DUMP_CAN_FLAG or TRACE_DUMP_UART_FLAG
+ * @param event The record to send
+ * @return bool True if the record was sent, false if it timed out
+ */
+static bool send_record(uint32_t flag, const trace_event_t *event)
+{
+	const uint8_t *bytes = (const uint8_t *)event;
+	can_msg_t msg = { .id = CANID_TRACE_DUMP, .len = 8, .data = { 0 } };
+	memcpy(msg.data, event, sizeof(trace_event_t));
+
+	for (uint32_t waited = 0; waited < TRACE_DUMP_TIMEOUT; waited++) {
+		int ret;
+		if (flag == TRACE_DUMP_CAN_FLAG)
+			ret = can_outbound_space() > TRACE_DUMP_CAN_RESERVE ?
+				      queue_can_msg(msg) :
+				      -1;
+		else
+			ret = serial_print(
+				"TRACE %02x%02x%02x%02x%02x%02x%02x%02x\r\n",
+				bytes[0], bytes[1], bytes[2], bytes[3],
+				bytes[4], bytes[5], bytes[6], bytes[7]);
+
+		if (ret == 0)
+			return true;
+
+		osDelay(1);
+	}
+
+	return false;
+}
+
+/**
+ * @brief Send the names of every task the recorder has seen, 4 characters per record.
+ */
+static bool send_task_names(uint32_t flag)
+{
+	for (uint32_t task = 0; task < TRACE_MAX_TASKS; task++) {
+		const char *name = trace_task_name(task);
+		if (!name)
+			continue;
+
+		size_t len = strnlen(name, configMAX_TASK_NAME_LEN);
+		for (size_t offset = 0; offset < len; offset += 4) {
+			trace_event_t record = { .type = TRACE_TASK_NAME,
+						 .task = task,
+						 .arg = offset };
+			memcpy(&record.timestamp, name + offset,
+			       len - offset < 4 ? len - offset : 4);
+			if (!send_record(flag, &record))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+osThreadId_t trace_dump_handle;
+static StaticTask_t trace_dump_cb CCM_BSS(trace_dump_cb);
+/* serial_print formats on the stack */
+static uint32_t trace_dump_stack[128 * 8 / sizeof(uint32_t)]
+	CCM_BSS(trace_dump_stack);
+const osThreadAttr_t trace_dump_attributes = {
+	.name = "TraceDump",
+	.cb_mem = &trace_dump_cb,
+	.cb_size = sizeof(trace_dump_cb),
+	.stack_mem = trace_dump_stack,
+	.stack_size = sizeof(trace_dump_stack),
+	.priority = TASK_PRIORITY(TRACE_DUMP),
+};
+
+void vTraceDump(void *pv_params)
+{
+	for (;;) {
+		uint32_t flag = osThreadFlagsWait(TRACE_DUMP_CAN_FLAG |
+							  TRACE_DUMP_UART_FLAG,
+						  osFlagsWaitAny, osWaitForever);
+		/* CAN wins if both were requested */
+		flag = flag & TRACE_DUMP_CAN_FLAG ? TRACE_DUMP_CAN_FLAG :
+						    TRACE_DUMP_UART_FLAG;
+
+		/* Keep the buffer still, and keep the dump itself out of it */
+		trace_pause(true);
+
+		uint32_t num_events = trace_num_events();
+		trace_event_t record = { .timestamp = CLOCK_TIMEBASE_HZ,
+					 .type = TRACE_DUMP_START,
+					 .arg = num_events };
+		bool sent = send_record(flag, &record) &&
+			    send_task_names(flag);
+
+		for (uint32_t n = 0; sent && n < num_events; n++) {
+			trace_get_event(n, &record);
+			sent = send_record(flag, &record);
+		}
+
+		if (sent) {
+			record = (trace_event_t){ .type = TRACE_DUMP_END,
+						  .arg = num_events };
+			send_record(flag, &record);
+		}
+
+		trace_pause(false);
+	}
+}
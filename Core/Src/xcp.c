@@ -0,0 +1,711 @@
+/**
+ * @file xcp.c
+ * @brief XCP slave for measurement and calibration with standard tooling.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "xcp.h"
+#include <string.h>
+
+/* Commands */
+#define XCP_CONNECT		    0xFF
+#define XCP_DISCONNECT		    0xFE
+#define XCP_GET_STATUS		    0xFD
+#define XCP_SYNCH		    0xFC
+#define XCP_GET_COMM_MODE_INFO	    0xFB
+#define XCP_SET_MTA		    0xF6
+#define XCP_UPLOAD		    0xF5
+#define XCP_SHORT_UPLOAD	    0xF4
+#define XCP_DOWNLOAD		    0xF0
+#define XCP_SHORT_DOWNLOAD	    0xED
+#define XCP_CLEAR_DAQ_LIST	    0xE3
+#define XCP_SET_DAQ_PTR		    0xE2
+#define XCP_WRITE_DAQ		    0xE1
+#define XCP_SET_DAQ_LIST_MODE	    0xE0
+#define XCP_GET_DAQ_LIST_MODE	    0xDF
+#define XCP_START_STOP_DAQ_LIST	    0xDE
+#define XCP_START_STOP_SYNCH	    0xDD
+#define XCP_GET_DAQ_PROCESSOR_INFO  0xDA
+#define XCP_GET_DAQ_RESOLUTION_INFO 0xD9
+#define XCP_GET_DAQ_EVENT_INFO	    0xD7
+#define XCP_FREE_DAQ		    0xD6
+#define XCP_ALLOC_DAQ		    0xD5
+#define XCP_ALLOC_ODT		    0xD4
+#define XCP_ALLOC_ODT_ENTRY	    0xD3
+
+/* Packet identifiers */
+#define XCP_PID_RES 0xFF
+#define XCP_PID_ERR 0xFE
+
+/* Error codes */
+#define XCP_ERR_CMD_SYNCH	 0x00
+#define XCP_ERR_DAQ_ACTIVE	 0x11
+#define XCP_ERR_CMD_UNKNOWN	 0x20
+#define XCP_ERR_CMD_SYNTAX	 0x21
+#define XCP_ERR_OUT_OF_RANGE	 0x22
+#define XCP_ERR_ACCESS_DENIED	 0x24
+#define XCP_ERR_MODE_NOT_VALID	 0x27
+#define XCP_ERR_SEQUENCE	 0x29
+#define XCP_ERR_DAQ_CONFIG	 0x2A
+#define XCP_ERR_MEMORY_OVERFLOW 0x30
+
+/* CONNECT */
+#define XCP_RESOURCE_CAL_PAG	0x01
+#define XCP_RESOURCE_DAQ	0x04
+#define XCP_COMM_MODE_OPTIONAL	0x80
+#define XCP_PROTOCOL_VERSION	0x01
+#define XCP_TRANSPORT_VERSION	0x01
+#define XCP_DRIVER_VERSION	0x10
+
+/* GET_STATUS */
+#define XCP_SESSION_DAQ_RUNNING 0x40
+
+/* GET_DAQ_PROCESSOR_INFO */
+#define XCP_DAQ_CONFIG_DYNAMIC	 0x01
+#define XCP_PRESCALER_SUPPORTED 0x02
+#define XCP_TIMESTAMP_SUPPORTED 0x10
+
+/* GET_DAQ_RESOLUTION_INFO */
+#define XCP_TIMESTAMP_SIZE     4 /* Bytes */
+#define XCP_TIMESTAMP_UNIT_1US 0x30
+
+/* SET_DAQ_LIST_MODE and GET_DAQ_LIST_MODE */
+#define XCP_DAQ_MODE_SELECTED  0x01
+#define XCP_DAQ_MODE_TIMESTAMP 0x10
+#define XCP_DAQ_MODE_RUNNING   0x40
+#define XCP_DAQ_MODE_UNSUPPORTED \
+	0x2E /* Direction, DTO counters and turning the PID off */
+
+/* GET_DAQ_EVENT_INFO */
+#define XCP_EVENT_DAQ	    0x04
+#define XCP_TIME_UNIT_1MS 6
+
+#define XCP_EVENT_PERIOD(name, period) period,
+static const uint8_t event_periods[XCP_NUM_EVENTS] = { XCP_EVENT_TABLE(
+	XCP_EVENT_PERIOD) };
+
+typedef struct {
+	const uint8_t *src; /* Mapped when the entry is written */
+	uint8_t size; /* 0 until written */
+} odt_entry_t;
+
+typedef struct {
+	uint16_t first_entry;
+	uint8_t num_entries;
+} odt_t;
+
+typedef struct {
+	uint16_t first_odt; /* Also the PID of the list's first ODT */
+	uint8_t num_odts;
+	uint8_t event;
+	uint8_t prescaler;
+	uint8_t prescaler_count;
+	uint8_t priority;
+	bool timestamp; /* First ODT's packet carries the time it was sampled */
+	bool selected;
+	volatile bool running; /* Read by the event, written by the command handler */
+} daq_list_t;
+
+static xcp_send_t xcp_send;
+static bool connected;
+
+/* Memory transfer address, where UPLOAD and DOWNLOAD read and write */
+static uint32_t mta;
+static uint8_t mta_ext;
+
+/* Allocated in order: every list, then every ODT, then every entry */
+static daq_list_t daq_lists[XCP_MAX_DAQ_LISTS];
+static odt_t odts[XCP_MAX_ODTS];
+static odt_entry_t odt_entries[XCP_MAX_ODT_ENTRIES];
+static uint16_t num_daq_lists;
+static uint16_t num_odts;
+static uint16_t num_odt_entries;
+
+/* Where the next WRITE_DAQ goes */
+static struct {
+	uint16_t daq;
+	uint8_t odt;
+	uint8_t entry;
+	bool valid;
+} daq_ptr;
+
+static uint16_t get_u16(const uint8_t *data)
+{
+	return data[0] | (data[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) |
+	       ((uint32_t)data[3] << 24);
+}
+
+static void put_u16(uint8_t *data, uint16_t value)
+{
+	data[0] = value & 0xFF;
+	data[1] = value >> 8;
+}
+
+static void send_error(uint8_t code)
+{
+	uint8_t err[2] = { XCP_PID_ERR, code };
+	xcp_send(err, sizeof(err));
+}
+
+static void send_ok(void)
+{
+	uint8_t res[1] = { XCP_PID_RES };
+	xcp_send(res, sizeof(res));
+}
+
+static bool daq_running(void)
+{
+	for (uint16_t daq = 0; daq < num_daq_lists; daq++) {
+		if (daq_lists[daq].running)
+			return true;
+	}
+
+	return false;
+}
+
+static void stop_all(void)
+{
+	for (uint16_t daq = 0; daq < num_daq_lists; daq++) {
+		daq_lists[daq].running = false;
+		daq_lists[daq].selected = false;
+	}
+}
+
+/**
+ * @brief Check every entry of a list has been written, and every ODT fits in a DAQ packet.
+ */
+static bool daq_list_valid(const daq_list_t *list)
+{
+	if (!list->num_odts)
+		return false;
+
+	for (uint16_t odt = list->first_odt;
+	     odt < list->first_odt + list->num_odts; odt++) {
+		uint32_t len = 0;
+		for (uint16_t entry = odts[odt].first_entry;
+		     entry < odts[odt].first_entry + odts[odt].num_entries;
+		     entry++) {
+			if (!odt_entries[entry].size)
+				return false;
+			len += odt_entries[entry].size;
+		}
+
+		/* The timestamp follows the PID of the first ODT */
+		uint32_t max_len = XCP_MAX_DTO - 1;
+		if (list->timestamp && odt == list->first_odt)
+			max_len -= XCP_TIMESTAMP_SIZE;
+
+		if (len > max_len)
+			return false;
+	}
+
+	return true;
+}
+
+static void start_daq_list(daq_list_t *list)
+{
+	list->prescaler_count = 0;
+	__atomic_store_n(&list->running, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Read from the MTA and send it back, then move the MTA past it.
+ */
+static void upload(uint8_t len)
+{
+	uint8_t res[XCP_MAX_CTO] = { XCP_PID_RES };
+
+	if (len > XCP_MAX_CTO - 1) {
+		send_error(XCP_ERR_OUT_OF_RANGE);
+		return;
+	}
+
+	const uint8_t *src = xcp_map(mta, mta_ext, len, false);
+	if (!src) {
+		send_error(XCP_ERR_ACCESS_DENIED);
+		return;
+	}
+
+	memcpy(&res[1], src, len);
+	mta += len;
+	xcp_send(res, len + 1);
+}
+
+/**
+ * @brief Write to the MTA, then move the MTA past it.
+ */
+static void download(const uint8_t *data, uint8_t len)
+{
+	uint8_t *dst = xcp_map(mta, mta_ext, len, true);
+	if (!dst) {
+		send_error(XCP_ERR_ACCESS_DENIED);
+		return;
+	}
+
+	memcpy(dst, data, len);
+	mta += len;
+	send_ok();
+}
+
+static void handle_connect(void)
+{
+	uint8_t res[8] = { XCP_PID_RES,
+			   XCP_RESOURCE_CAL_PAG | XCP_RESOURCE_DAQ,
+			   XCP_COMM_MODE_OPTIONAL,
+			   XCP_MAX_CTO,
+			   0,
+			   0,
+			   XCP_PROTOCOL_VERSION,
+			   XCP_TRANSPORT_VERSION };
+	put_u16(&res[4], XCP_MAX_DTO);
+
+	connected = true;
+	xcp_send(res, sizeof(res));
+}
+
+/**
+ * @brief Handle the DAQ configuration commands, which are refused while DAQ is running.
+ */
+static void configure_daq(const uint8_t *cmd)
+{
+	if (daq_running()) {
+		send_error(XCP_ERR_DAQ_ACTIVE);
+		return;
+	}
+
+	switch (cmd[0]) {
+	case XCP_FREE_DAQ:
+		num_daq_lists = 0;
+		num_odts = 0;
+		num_odt_entries = 0;
+		daq_ptr.valid = false;
+		break;
+	case XCP_ALLOC_DAQ: {
+		uint16_t count = get_u16(&cmd[2]);
+		if (num_odts) {
+			send_error(XCP_ERR_SEQUENCE);
+			return;
+		}
+		if (count > XCP_MAX_DAQ_LISTS) {
+			send_error(XCP_ERR_MEMORY_OVERFLOW);
+			return;
+		}
+		for (uint16_t daq = 0; daq < count; daq++)
+			daq_lists[daq] = (daq_list_t){ .prescaler = 1 };
+		num_daq_lists = count;
+		break;
+	}
+	case XCP_ALLOC_ODT: {
+		uint16_t daq = get_u16(&cmd[2]);
+		uint8_t count = cmd[4];
+		/* Each list's ODTs are allocated at once, before any entries */
+		if (daq >= num_daq_lists) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		if (daq_lists[daq].num_odts || num_odt_entries) {
+			send_error(XCP_ERR_SEQUENCE);
+			return;
+		}
+		if (num_odts + count > XCP_MAX_ODTS) {
+			send_error(XCP_ERR_MEMORY_OVERFLOW);
+			return;
+		}
+		daq_lists[daq].first_odt = num_odts;
+		daq_lists[daq].num_odts = count;
+		for (uint8_t odt = 0; odt < count; odt++)
+			odts[num_odts + odt] = (odt_t){ 0 };
+		num_odts += count;
+		break;
+	}
+	case XCP_ALLOC_ODT_ENTRY: {
+		uint16_t daq = get_u16(&cmd[2]);
+		uint8_t odt = cmd[4];
+		uint8_t count = cmd[5];
+		if (daq >= num_daq_lists || odt >= daq_lists[daq].num_odts) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		odt_t *table = &odts[daq_lists[daq].first_odt + odt];
+		if (table->num_entries) {
+			send_error(XCP_ERR_SEQUENCE);
+			return;
+		}
+		if (num_odt_entries + count > XCP_MAX_ODT_ENTRIES) {
+			send_error(XCP_ERR_MEMORY_OVERFLOW);
+			return;
+		}
+		table->first_entry = num_odt_entries;
+		table->num_entries = count;
+		for (uint8_t entry = 0; entry < count; entry++)
+			odt_entries[num_odt_entries + entry] =
+				(odt_entry_t){ 0 };
+		num_odt_entries += count;
+		break;
+	}
+	case XCP_SET_DAQ_PTR: {
+		uint16_t daq = get_u16(&cmd[2]);
+		uint8_t odt = cmd[4];
+		uint8_t entry = cmd[5];
+		if (daq >= num_daq_lists || odt >= daq_lists[daq].num_odts ||
+		    entry >= odts[daq_lists[daq].first_odt + odt].num_entries) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		daq_ptr.daq = daq;
+		daq_ptr.odt = odt;
+		daq_ptr.entry = entry;
+		daq_ptr.valid = true;
+		break;
+	}
+	case XCP_WRITE_DAQ: {
+		uint8_t bit_offset = cmd[1];
+		uint8_t size = cmd[2];
+		if (!daq_ptr.valid) {
+			send_error(XCP_ERR_SEQUENCE);
+			return;
+		}
+		if (bit_offset != 0xFF || size == 0 || size > XCP_MAX_DTO - 1) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		const uint8_t *src = xcp_map(get_u32(&cmd[4]), cmd[3], size,
+					     false);
+		if (!src) {
+			send_error(XCP_ERR_ACCESS_DENIED);
+			return;
+		}
+		odt_t *odt = &odts[daq_lists[daq_ptr.daq].first_odt +
+				   daq_ptr.odt];
+		odt_entries[odt->first_entry + daq_ptr.entry] =
+			(odt_entry_t){ .src = src, .size = size };
+		/* The pointer moves to the next entry, and becomes invalid past the end of the ODT */
+		daq_ptr.valid = ++daq_ptr.entry < odt->num_entries;
+		break;
+	}
+	case XCP_CLEAR_DAQ_LIST: {
+		uint16_t daq = get_u16(&cmd[2]);
+		if (daq >= num_daq_lists) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		const daq_list_t *list = &daq_lists[daq];
+		for (uint16_t odt = list->first_odt;
+		     odt < list->first_odt + list->num_odts; odt++) {
+			for (uint16_t entry = odts[odt].first_entry;
+			     entry <
+			     odts[odt].first_entry + odts[odt].num_entries;
+			     entry++)
+				odt_entries[entry] = (odt_entry_t){ 0 };
+		}
+		break;
+	}
+	case XCP_SET_DAQ_LIST_MODE: {
+		uint8_t mode = cmd[1];
+		uint16_t daq = get_u16(&cmd[2]);
+		uint16_t event = get_u16(&cmd[4]);
+		uint8_t prescaler = cmd[6];
+		if (daq >= num_daq_lists || event >= XCP_NUM_EVENTS ||
+		    prescaler == 0) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		if (mode & XCP_DAQ_MODE_UNSUPPORTED) {
+			send_error(XCP_ERR_MODE_NOT_VALID);
+			return;
+		}
+		daq_lists[daq].event = event;
+		daq_lists[daq].prescaler = prescaler;
+		daq_lists[daq].priority = cmd[7];
+		daq_lists[daq].timestamp = mode & XCP_DAQ_MODE_TIMESTAMP;
+		break;
+	}
+	}
+
+	send_ok();
+}
+
+/**
+ * @brief Handle the commands that start, stop and describe DAQ lists.
+ */
+static void control_daq(const uint8_t *cmd)
+{
+	uint8_t res[8] = { XCP_PID_RES };
+
+	switch (cmd[0]) {
+	case XCP_GET_DAQ_LIST_MODE: {
+		uint16_t daq = get_u16(&cmd[2]);
+		if (daq >= num_daq_lists) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		const daq_list_t *list = &daq_lists[daq];
+		res[1] = (list->selected ? XCP_DAQ_MODE_SELECTED : 0) |
+			 (list->timestamp ? XCP_DAQ_MODE_TIMESTAMP : 0) |
+			 (list->running ? XCP_DAQ_MODE_RUNNING : 0);
+		put_u16(&res[4], list->event);
+		res[6] = list->prescaler;
+		res[7] = list->priority;
+		xcp_send(res, 8);
+		return;
+	}
+	case XCP_START_STOP_DAQ_LIST: {
+		uint8_t mode = cmd[1];
+		uint16_t daq = get_u16(&cmd[2]);
+		if (daq >= num_daq_lists || mode > 2) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		daq_list_t *list = &daq_lists[daq];
+		if (mode != 0 && !daq_list_valid(list)) {
+			send_error(XCP_ERR_DAQ_CONFIG);
+			return;
+		}
+		if (mode == 0)
+			list->running = false;
+		else if (mode == 1)
+			start_daq_list(list);
+		else
+			list->selected = true;
+		res[1] = list->first_odt;
+		xcp_send(res, 2);
+		return;
+	}
+	case XCP_START_STOP_SYNCH: {
+		uint8_t mode = cmd[1];
+		if (mode > 2) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		if (mode == 0) {
+			stop_all();
+		} else {
+			for (uint16_t daq = 0; daq < num_daq_lists; daq++) {
+				daq_list_t *list = &daq_lists[daq];
+				if (!list->selected)
+					continue;
+				if (mode == 1)
+					start_daq_list(list);
+				else
+					list->running = false;
+				list->selected = false;
+			}
+		}
+		send_ok();
+		return;
+	}
+	case XCP_GET_DAQ_PROCESSOR_INFO:
+		res[1] = XCP_DAQ_CONFIG_DYNAMIC | XCP_PRESCALER_SUPPORTED |
+			 XCP_TIMESTAMP_SUPPORTED;
+		put_u16(&res[2], XCP_MAX_DAQ_LISTS);
+		put_u16(&res[4], XCP_NUM_EVENTS);
+		res[6] = 0; /* No predefined lists */
+		res[7] = 0; /* Absolute ODT number as the PID */
+		xcp_send(res, 8);
+		return;
+	case XCP_GET_DAQ_RESOLUTION_INFO:
+		res[1] = 1; /* Granularity of ODT entries */
+		res[2] = XCP_MAX_DTO - 1; /* Largest ODT entry */
+		res[3] = 1; /* Granularity of STIM entries */
+		res[4] = 0; /* No STIM */
+		res[5] = XCP_TIMESTAMP_SIZE | XCP_TIMESTAMP_UNIT_1US;
+		put_u16(&res[6], 1); /* Ticks per unit */
+		xcp_send(res, 8);
+		return;
+	case XCP_GET_DAQ_EVENT_INFO: {
+		uint16_t event = get_u16(&cmd[2]);
+		if (event >= XCP_NUM_EVENTS) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			return;
+		}
+		res[1] = XCP_EVENT_DAQ;
+		res[2] = XCP_MAX_DAQ_LISTS;
+		res[3] = 0; /* No name */
+		res[4] = event_periods[event];
+		res[5] = XCP_TIME_UNIT_1MS;
+		res[6] = 0; /* Priority */
+		xcp_send(res, 7);
+		return;
+	}
+	}
+}
+
+void xcp_init(xcp_send_t send)
+{
+	xcp_send = send;
+}
+
+void xcp_command(const uint8_t *cmd, uint8_t len)
+{
+	if (len == 0)
+		return;
+
+	/* Nothing but CONNECT is answered until the master connects */
+	if (!connected && cmd[0] != XCP_CONNECT)
+		return;
+
+	/* Every command carries its fixed arguments, the variable part is checked per command */
+	static const struct {
+		uint8_t cmd;
+		uint8_t len;
+	} min_len[] = {
+		{ XCP_CONNECT, 2 },	       { XCP_SET_MTA, 8 },
+		{ XCP_UPLOAD, 2 },	       { XCP_SHORT_UPLOAD, 8 },
+		{ XCP_DOWNLOAD, 2 },	       { XCP_SHORT_DOWNLOAD, 8 },
+		{ XCP_CLEAR_DAQ_LIST, 4 },     { XCP_SET_DAQ_PTR, 6 },
+		{ XCP_WRITE_DAQ, 8 },	       { XCP_SET_DAQ_LIST_MODE, 8 },
+		{ XCP_GET_DAQ_LIST_MODE, 4 },  { XCP_START_STOP_DAQ_LIST, 4 },
+		{ XCP_START_STOP_SYNCH, 2 },   { XCP_GET_DAQ_EVENT_INFO, 4 },
+		{ XCP_ALLOC_DAQ, 4 },	       { XCP_ALLOC_ODT, 5 },
+		{ XCP_ALLOC_ODT_ENTRY, 6 },
+	};
+	for (uint32_t i = 0; i < sizeof(min_len) / sizeof(min_len[0]); i++) {
+		if (cmd[0] == min_len[i].cmd && len < min_len[i].len) {
+			send_error(XCP_ERR_CMD_SYNTAX);
+			return;
+		}
+	}
+
+	switch (cmd[0]) {
+	case XCP_CONNECT:
+		handle_connect();
+		break;
+	case XCP_DISCONNECT:
+		stop_all();
+		connected = false;
+		send_ok();
+		break;
+	case XCP_GET_STATUS: {
+		uint8_t res[6] = { XCP_PID_RES,
+				   daq_running() ? XCP_SESSION_DAQ_RUNNING : 0 };
+		xcp_send(res, sizeof(res));
+		break;
+	}
+	case XCP_SYNCH:
+		send_error(XCP_ERR_CMD_SYNCH);
+		break;
+	case XCP_GET_COMM_MODE_INFO: {
+		uint8_t res[8] = { XCP_PID_RES };
+		res[7] = XCP_DRIVER_VERSION;
+		xcp_send(res, sizeof(res));
+		break;
+	}
+	case XCP_SET_MTA:
+		mta_ext = cmd[3];
+		mta = get_u32(&cmd[4]);
+		send_ok();
+		break;
+	case XCP_UPLOAD:
+		upload(cmd[1]);
+		break;
+	case XCP_SHORT_UPLOAD:
+		mta_ext = cmd[3];
+		mta = get_u32(&cmd[4]);
+		upload(cmd[1]);
+		break;
+	case XCP_DOWNLOAD:
+		if (cmd[1] > len - 2) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			break;
+		}
+		download(&cmd[2], cmd[1]);
+		break;
+	case XCP_SHORT_DOWNLOAD:
+		/* Only room for data on transports with packets over 8 bytes */
+		if (cmd[1] > len - 8) {
+			send_error(XCP_ERR_OUT_OF_RANGE);
+			break;
+		}
+		mta_ext = cmd[3];
+		mta = get_u32(&cmd[4]);
+		download(&cmd[8], cmd[1]);
+		break;
+	case XCP_FREE_DAQ:
+	case XCP_ALLOC_DAQ:
+	case XCP_ALLOC_ODT:
+	case XCP_ALLOC_ODT_ENTRY:
+	case XCP_SET_DAQ_PTR:
+	case XCP_WRITE_DAQ:
+	case XCP_CLEAR_DAQ_LIST:
+	case XCP_SET_DAQ_LIST_MODE:
+		configure_daq(cmd);
+		break;
+	case XCP_GET_DAQ_LIST_MODE:
+	case XCP_START_STOP_DAQ_LIST:
+	case XCP_START_STOP_SYNCH:
+	case XCP_GET_DAQ_PROCESSOR_INFO:
+	case XCP_GET_DAQ_RESOLUTION_INFO:
+	case XCP_GET_DAQ_EVENT_INFO:
+		control_daq(cmd);
+		break;
+	default:
+		send_error(XCP_ERR_CMD_UNKNOWN);
+		break;
+	}
+}
+
+void xcp_event(xcp_event_t event)
+{
+	/* Every list's ODTs come out of the same table, so this holds them all */
+	uint8_t packets[XCP_MAX_ODTS][XCP_MAX_DTO];
+	uint8_t lens[XCP_MAX_ODTS];
+	uint8_t num_packets = 0;
+
+	/* Read without the lock, it only saves taking it when nothing is configured */
+	if (!num_daq_lists)
+		return;
+
+	/* The command task can preempt this, so hold the lock while reading the configuration */
+	xcp_lock();
+
+	for (uint16_t daq = 0; daq < num_daq_lists; daq++) {
+		daq_list_t *list = &daq_lists[daq];
+		if (!__atomic_load_n(&list->running, __ATOMIC_ACQUIRE) ||
+		    list->event != event)
+			continue;
+
+		if (++list->prescaler_count < list->prescaler)
+			continue;
+		list->prescaler_count = 0;
+
+		/* Sample every ODT before sending any, so the whole list is from the same instant */
+		for (uint8_t n = 0;
+		     n < list->num_odts && num_packets < XCP_MAX_ODTS; n++) {
+			const odt_t *odt = &odts[list->first_odt + n];
+			uint8_t *packet = packets[num_packets];
+			uint8_t len = 1;
+
+			packet[0] = list->first_odt + n;
+			if (list->timestamp && n == 0) {
+				uint32_t timestamp = xcp_timestamp();
+				memcpy(&packet[1], &timestamp,
+				       XCP_TIMESTAMP_SIZE);
+				len += XCP_TIMESTAMP_SIZE;
+			}
+			for (uint16_t entry = odt->first_entry;
+			     entry < odt->first_entry + odt->num_entries;
+			     entry++) {
+				/* Checked when the list was started, but never trust it with the packet */
+				if (odt_entries[entry].size > XCP_MAX_DTO - len)
+					break;
+				memcpy(&packet[len], odt_entries[entry].src,
+				       odt_entries[entry].size);
+				len += odt_entries[entry].size;
+			}
+			lens[num_packets++] = len;
+		}
+	}
+
+	xcp_unlock();
+
+	for (uint8_t n = 0; n < num_packets; n++)
+		xcp_send(packets[n], lens[n]);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file xcp_can.c
+ * @brief XCP on CAN, and the memory the master is allowed to access.
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "xcp_can.h"
+#include "xcp.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "can_handler.h"
+#include "cerberus_conf.h"
+#include "params.h"
+#include "timebase.h"
+#include <stddef.h>
+#include <string.h>
+
+typedef struct {
+	uint32_t start;
+	uint32_t end;
+	bool writable;
+} xcp_region_t;
+
+/* Flash can be read, never written: calibrate RAM and persist it some other way */
+static const xcp_region_t regions[] = {
+	{ 0x08000000, 0x08100000, false }, /* Flash */
+	{ 0x10000000, 0x10010000, true }, /* CCM RAM */
+	{ 0x20000000, 0x20020000, true }, /* SRAM */
+};
+
+void *xcp_map(uint32_t addr, uint8_t ext, uint32_t len, bool write)
+{
+	if (ext != 0)
+		return NULL;
+
+	for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+		if (addr >= regions[i].start && addr <= regions[i].end &&
+		    len <= regions[i].end - addr) {
+			/* Parameters only change through param_set(), which checks their limits */
+			if (write && (!regions[i].writable ||
+				      params_overlaps((const void *)addr, len)))
+				return NULL;
+			return (void *)addr;
+		}
+	}
+
+	return NULL;
+}
+
+uint32_t xcp_timestamp(void)
+{
+	return now_us();
+}
+
+/* Only a few copies long, so a critical section costs less than a mutex */
+void xcp_lock(void)
+{
+	taskENTER_CRITICAL();
+}
+
+void xcp_unlock(void)
+{
+	taskEXIT_CRITICAL();
+}
+
+static void xcp_can_send(const uint8_t *data, uint8_t len)
+{
+	can_msg_t msg = { .id = CANID_XCP_DTO, .len = len, .data = { 0 } };
+	memcpy(msg.data, data, len);
+
+	/* The master times out and retries a lost response, and a lost DAQ packet is just a gap */
+	queue_can_msg(msg);
+}
+
+void xcp_can_init(void)
+{
+	xcp_init(xcp_can_send);
+}
+
+void handle_xcp_command(can_msg_t msg)
+{
+	xcp_command(msg.data, msg.len);
+}
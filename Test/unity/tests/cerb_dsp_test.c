@@ -0,0 +1,221 @@
+#include "unity.h"
+#include "cerb_dsp.h"
+#include <stdio.h>
+
+#if defined(__ARM_ARCH_7EM__)
+#include "stm32f4xx.h"
+#define BENCH_UNITS "cycles"
+
+static void bench_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static uint32_t bench_now(void)
+{
+    return DWT->CYCCNT;
+}
+#else
+/* Off target there is no cycle counter, so only the ratio is meaningful */
+#include <time.h>
+#define BENCH_UNITS "clock ticks"
+
+static void bench_init(void)
+{
+}
+
+static uint32_t bench_now(void)
+{
+    return (uint32_t)clock();
+}
+#endif
+
+#define BENCH_TAPS    32
+#define BENCH_SAMPLES 1024
+
+/* Q15 4 tap moving average */
+static const int16_t avg4[4] = { 8192, 8192, 8192, 8192 };
+
+void test_dsp_fir_impulse(void)
+{
+    const int16_t coeffs[4] = { 16384, -8192, 4096, 2048 };
+    int16_t state[8];
+    dsp_fir_t fir;
+
+    dsp_fir_init(&fir, coeffs, state, 4);
+
+    /* Impulse response of a FIR filter is its coefficients */
+    TEST_ASSERT_INT16_WITHIN(1, coeffs[0], dsp_fir(&fir, INT16_MAX));
+    for (int i = 1; i < 4; i++) {
+        TEST_ASSERT_INT16_WITHIN(1, coeffs[i], dsp_fir(&fir, 0));
+    }
+    TEST_ASSERT_EQUAL_INT16(0, dsp_fir(&fir, 0));
+}
+
+void test_dsp_fir_moving_average(void)
+{
+    int16_t state[8];
+    int16_t in[8] = { 1000, 1000, 1000, 1000, 2000, 2000, 2000, 2000 };
+    int16_t out[8];
+    dsp_fir_t fir;
+
+    dsp_fir_init(&fir, avg4, state, 4);
+    dsp_fir_block(&fir, in, out, 8);
+
+    TEST_ASSERT_EQUAL_INT16(250, out[0]);
+    TEST_ASSERT_EQUAL_INT16(1000, out[3]);
+    TEST_ASSERT_EQUAL_INT16(1250, out[4]);
+    TEST_ASSERT_EQUAL_INT16(2000, out[7]);
+}
+
+void test_dsp_fir_saturates(void)
+{
+    int16_t state[8];
+    dsp_fir_t fir;
+    const int16_t gain2[4] = { INT16_MAX, INT16_MAX, 0, 0 };
+
+    dsp_fir_init(&fir, gain2, state, 4);
+    dsp_fir(&fir, 30000);
+
+    TEST_ASSERT_EQUAL_INT16(INT16_MAX, dsp_fir(&fir, 30000));
+    dsp_fir(&fir, -30000);
+    TEST_ASSERT_EQUAL_INT16(INT16_MIN, dsp_fir(&fir, -30000));
+}
+
+void test_dsp_biquad_passthrough(void)
+{
+    /* b0 = 1.0 in Q14 */
+    const int16_t coeffs[5] = { 16384, 0, 0, 0, 0 };
+    dsp_biquad_t biquad;
+
+    dsp_biquad_init(&biquad, coeffs);
+
+    TEST_ASSERT_EQUAL_INT16(1234, dsp_biquad(&biquad, 1234));
+    TEST_ASSERT_EQUAL_INT16(-4321, dsp_biquad(&biquad, -4321));
+}
+
+void test_dsp_biquad_lowpass_settles(void)
+{
+    /* y[n] = 0.25 x[n] + 0.75 y[n-1], unity DC gain */
+    const int16_t coeffs[5] = { 4096, 0, 0, -12288, 0 };
+    dsp_biquad_t biquad;
+    int16_t out = 0;
+
+    dsp_biquad_init(&biquad, coeffs);
+
+    TEST_ASSERT_EQUAL_INT16(250, dsp_biquad(&biquad, 1000));
+    for (int i = 0; i < 100; i++) {
+        out = dsp_biquad(&biquad, 1000);
+    }
+    /* Truncation leaves the output a few counts short */
+    TEST_ASSERT_INT16_WITHIN(4, 1000, out);
+}
+
+void test_dsp_norm_dual(void)
+{
+    const int16_t offset[2] = { 980, 1780 };
+    const int16_t max[2] = { 1866, 3365 };
+    dsp_norm_dual_t norm;
+    uint16_t out[2];
+
+    dsp_norm_dual_init(&norm, offset, max);
+
+    for (int32_t raw = 0; raw < 4096; raw++) {
+        dsp_norm_dual(&norm, raw, raw, out);
+
+        for (int i = 0; i < 2; i++) {
+            int32_t expected = raw <= offset[i] ?
+                0 : (raw - offset[i]) * 100 / (max[i] - offset[i]);
+            TEST_ASSERT_INT32_WITHIN(1, expected, out[i]);
+        }
+    }
+}
+
+void test_dsp_stats(void)
+{
+    const int16_t odd[5] = { 3, 1, 5, 2, 4 };
+    const int16_t even[4] = { -100, 100, -100, 100 };
+    dsp_stats_t stats;
+
+    dsp_stats(odd, 5, &stats);
+    TEST_ASSERT_EQUAL_INT16(1, stats.min);
+    TEST_ASSERT_EQUAL_INT16(5, stats.max);
+    TEST_ASSERT_EQUAL_INT16(3, stats.mean);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.variance);
+
+    dsp_stats(even, 4, &stats);
+    TEST_ASSERT_EQUAL_INT16(-100, stats.min);
+    TEST_ASSERT_EQUAL_INT16(100, stats.max);
+    TEST_ASSERT_EQUAL_INT16(0, stats.mean);
+    TEST_ASSERT_EQUAL_UINT32(10000, stats.variance);
+
+    dsp_stats(odd, 0, &stats);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.variance);
+}
+
+/**
+ * @brief Same filter as dsp_fir() written the way the existing moving averages are, as a baseline.
+ */
+static int16_t scalar_fir(const int16_t *coeffs, int16_t *history,
+                          uint16_t *index, int16_t sample)
+{
+    history[*index] = sample;
+    *index = (*index + 1) % BENCH_TAPS;
+
+    int32_t acc = 0;
+    for (uint16_t i = 0; i < BENCH_TAPS; i++) {
+        acc += (int32_t)coeffs[i] *
+               history[(*index + BENCH_TAPS - 1 - i) % BENCH_TAPS];
+    }
+    return acc >> 15;
+}
+
+void test_dsp_bench(void)
+{
+    static int16_t coeffs[BENCH_TAPS];
+    static int16_t state[2 * BENCH_TAPS];
+    static int16_t history[BENCH_TAPS];
+    static int16_t samples[BENCH_SAMPLES];
+    volatile int16_t sink;
+    uint16_t index = 0;
+    dsp_fir_t fir;
+    dsp_stats_t stats;
+    char msg[96];
+
+    for (int i = 0; i < BENCH_TAPS; i++) {
+        coeffs[i] = INT16_MAX / BENCH_TAPS;
+    }
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        samples[i] = (i * 37) % 4096;
+    }
+    dsp_fir_init(&fir, coeffs, state, BENCH_TAPS);
+    bench_init();
+
+    uint32_t start = bench_now();
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        sink = scalar_fir(coeffs, history, &index, samples[i]);
+    }
+    uint32_t scalar = bench_now() - start;
+
+    start = bench_now();
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        sink = dsp_fir(&fir, samples[i]);
+    }
+    uint32_t kernel = bench_now() - start;
+
+    start = bench_now();
+    dsp_stats(samples, BENCH_SAMPLES, &stats);
+    uint32_t stats_time = bench_now() - start;
+    (void)sink;
+
+    snprintf(msg, sizeof(msg),
+             "%d tap FIR x %d: scalar %lu, kernel %lu " BENCH_UNITS,
+             BENCH_TAPS, BENCH_SAMPLES, (unsigned long)scalar,
+             (unsigned long)kernel);
+    TEST_MESSAGE(msg);
+    snprintf(msg, sizeof(msg), "stats x %d: %lu " BENCH_UNITS,
+             BENCH_SAMPLES, (unsigned long)stats_time);
+    TEST_MESSAGE(msg);
+}
@@ -12,5 +12,19 @@ void tearDown(void) {
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(test_can_handler);
+    RUN_TEST(test_dsp_fir_impulse);
+    RUN_TEST(test_dsp_fir_moving_average);
+    RUN_TEST(test_dsp_fir_saturates);
+    RUN_TEST(test_dsp_biquad_passthrough);
+    RUN_TEST(test_dsp_biquad_lowpass_settles);
+    RUN_TEST(test_dsp_norm_dual);
+    RUN_TEST(test_dsp_stats);
+    RUN_TEST(test_dsp_bench);
+    RUN_TEST(test_xcp_connect);
+    RUN_TEST(test_xcp_upload_download);
+    RUN_TEST(test_xcp_daq_samples_on_event);
+    RUN_TEST(test_xcp_daq_prescaler);
+    RUN_TEST(test_xcp_daq_config_checked);
+    RUN_TEST(test_xcp_daq_timestamp);
     return UNITY_END();
 }
\ No newline at end of file
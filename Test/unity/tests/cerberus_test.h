@@ -14,4 +14,20 @@
 
 void test_can_handler(void);
 
+void test_dsp_fir_impulse(void);
+void test_dsp_fir_moving_average(void);
+void test_dsp_fir_saturates(void);
+void test_dsp_biquad_passthrough(void);
+void test_dsp_biquad_lowpass_settles(void);
+void test_dsp_norm_dual(void);
+void test_dsp_stats(void);
+void test_dsp_bench(void);
+
+void test_xcp_connect(void);
+void test_xcp_upload_download(void);
+void test_xcp_daq_samples_on_event(void);
+void test_xcp_daq_prescaler(void);
+void test_xcp_daq_config_checked(void);
+void test_xcp_daq_timestamp(void);
+
 #endif // CERBERUS_TEST_H
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "unity.h"
+#include "xcp.h"
+#include <string.h>
+
+/*
+ * Stands in for the CAN transport: commands are fed straight into the slave
+ * and every packet it sends is captured. Addresses are offsets into a block
+ * of memory whose first half is writable.
+ */
+#define MEMORY_LEN   64
+#define WRITABLE_LEN 32
+#define MAX_PACKETS  8
+
+static uint8_t memory[MEMORY_LEN];
+static uint8_t packets[MAX_PACKETS][XCP_MAX_DTO];
+static uint8_t lens[MAX_PACKETS];
+static int num_packets;
+static uint32_t now;
+static int locks;
+
+void *xcp_map(uint32_t addr, uint8_t ext, uint32_t len, bool write)
+{
+    if (ext != 0 || addr > MEMORY_LEN || len > MEMORY_LEN - addr)
+        return NULL;
+    if (write && addr + len > WRITABLE_LEN)
+        return NULL;
+    return &memory[addr];
+}
+
+uint32_t xcp_timestamp(void)
+{
+    return now;
+}
+
+void xcp_lock(void)
+{
+    locks++;
+}
+
+void xcp_unlock(void)
+{
+    locks--;
+}
+
+static void capture(const uint8_t *data, uint8_t len)
+{
+    TEST_ASSERT_TRUE(len <= XCP_MAX_DTO);
+    /* Sending can block, so it must never happen under the lock */
+    TEST_ASSERT_EQUAL_INT(0, locks);
+    TEST_ASSERT_TRUE(num_packets < MAX_PACKETS);
+    memcpy(packets[num_packets], data, len);
+    lens[num_packets++] = len;
+}
+
+/* Send a command, and return the first byte of the single packet sent back */
+static uint8_t command(const uint8_t *cmd, uint8_t len)
+{
+    num_packets = 0;
+    xcp_command(cmd, len);
+    TEST_ASSERT_EQUAL_INT(1, num_packets);
+    return packets[0][0];
+}
+
+#define COMMAND(...)                                             \
+    command((const uint8_t[]){ __VA_ARGS__ },                    \
+            sizeof((const uint8_t[]){ __VA_ARGS__ }))
+
+static void connect_clean(void)
+{
+    xcp_init(capture);
+    memset(memory, 0, sizeof(memory));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xFF, 0x00)); /* CONNECT */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xDD, 0x00)); /* Stop all */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD6)); /* FREE_DAQ */
+}
+
+/* One DAQ list on the pedals event with two ODTs: [u16 at 0, u8 at 4] and [u32 at 8] */
+static void configure_daq(uint8_t prescaler)
+{
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD5, 0, 1, 0)); /* ALLOC_DAQ 1 */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD4, 0, 0, 0, 2)); /* ALLOC_ODT 2 */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD3, 0, 0, 0, 0, 2));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD3, 0, 0, 0, 1, 1));
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE2, 0, 0, 0, 0, 0)); /* SET_DAQ_PTR */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE1, 0xFF, 2, 0, 0, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE1, 0xFF, 1, 0, 4, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE2, 0, 0, 0, 1, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE1, 0xFF, 4, 0, 8, 0, 0, 0));
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE0, 0, 0, 0, XCP_EVENT_PEDALS, 0,
+                                         prescaler, 0)); /* SET_DAQ_LIST_MODE */
+}
+
+void test_xcp_connect(void)
+{
+    xcp_init(capture);
+    xcp_command((const uint8_t[]){ 0xFE }, 1);
+    num_packets = 0;
+
+    /* Silent until connected */
+    xcp_command((const uint8_t[]){ 0xFD }, 1);
+    TEST_ASSERT_EQUAL_INT(0, num_packets);
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xFF, 0x00));
+    TEST_ASSERT_EQUAL_INT(8, lens[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x05, packets[0][1]); /* CAL/PAG and DAQ */
+    TEST_ASSERT_EQUAL_INT(XCP_MAX_CTO, packets[0][3]);
+    TEST_ASSERT_EQUAL_INT(XCP_MAX_DTO, packets[0][4]);
+
+    TEST_ASSERT_EQUAL_HEX8(0xFE, COMMAND(0x12)); /* Unknown command */
+    TEST_ASSERT_EQUAL_HEX8(0x20, packets[0][1]);
+}
+
+void test_xcp_upload_download(void)
+{
+    connect_clean();
+    memory[40] = 0xAB;
+    memory[41] = 0xCD;
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xF4, 2, 0, 0, 40, 0, 0, 0));
+    TEST_ASSERT_EQUAL_INT(3, lens[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xAB, packets[0][1]);
+    TEST_ASSERT_EQUAL_HEX8(0xCD, packets[0][2]);
+
+    /* SET_MTA then DOWNLOAD, which moves the MTA on */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xF6, 0, 0, 0, 4, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xF0, 2, 0x11, 0x22));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xF0, 1, 0x33));
+    TEST_ASSERT_EQUAL_HEX8(0x11, memory[4]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, memory[5]);
+    TEST_ASSERT_EQUAL_HEX8(0x33, memory[6]);
+
+    /* Read only and unmapped memory */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xF6, 0, 0, 0, 40, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFE, COMMAND(0xF0, 1, 0x44));
+    TEST_ASSERT_EQUAL_HEX8(0x24, packets[0][1]);
+    TEST_ASSERT_EQUAL_HEX8(0xFE, COMMAND(0xF4, 1, 0, 0, 0, 1, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0x24, packets[0][1]);
+}
+
+void test_xcp_daq_samples_on_event(void)
+{
+    connect_clean();
+    configure_daq(1);
+
+    /* Nothing is sent until the list is started */
+    num_packets = 0;
+    xcp_event(XCP_EVENT_PEDALS);
+    TEST_ASSERT_EQUAL_INT(0, num_packets);
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xDE, 2, 0, 0)); /* Select */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xDD, 1)); /* Start selected */
+
+    memory[0] = 0x34;
+    memory[1] = 0x12;
+    memory[4] = 0x56;
+    memory[8] = 0x78;
+    memory[11] = 0x9A;
+
+    num_packets = 0;
+    xcp_event(XCP_EVENT_PEDALS);
+    TEST_ASSERT_EQUAL_INT(2, num_packets);
+
+    const uint8_t odt0[] = { 0, 0x34, 0x12, 0x56 };
+    const uint8_t odt1[] = { 1, 0x78, 0, 0, 0x9A };
+    TEST_ASSERT_EQUAL_INT(sizeof(odt0), lens[0]);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(odt0, packets[0], sizeof(odt0));
+    TEST_ASSERT_EQUAL_INT(sizeof(odt1), lens[1]);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(odt1, packets[1], sizeof(odt1));
+
+    /* Stopped lists cost nothing */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xDE, 0, 0, 0));
+    num_packets = 0;
+    xcp_event(XCP_EVENT_PEDALS);
+    TEST_ASSERT_EQUAL_INT(0, num_packets);
+}
+
+void test_xcp_daq_prescaler(void)
+{
+    connect_clean();
+    configure_daq(3);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xDE, 1, 0, 0));
+
+    int sent = 0;
+    for (int i = 0; i < 9; i++) {
+        num_packets = 0;
+        xcp_event(XCP_EVENT_PEDALS);
+        sent += num_packets;
+    }
+    TEST_ASSERT_EQUAL_INT(3 * 2, sent);
+}
+
+void test_xcp_daq_config_checked(void)
+{
+    connect_clean();
+
+    /* Entries are allocated and written through the DAQ pointer */
+    TEST_ASSERT_EQUAL_HEX8(0xFE, COMMAND(0xE1, 0xFF, 1, 0, 0, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0x29, packets[0][1]);
+
+    /* Entries that do not fit in one packet */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD5, 0, 1, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD4, 0, 0, 0, 1));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD3, 0, 0, 0, 0, 2));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE2, 0, 0, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE1, 0xFF, 4, 0, 0, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFE, COMMAND(0xDE, 1, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0x2A, packets[0][1]);
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE2, 0, 0, 0, 0, 1));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE1, 0xFF, 3, 0, 4, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xDE, 1, 0, 0));
+
+    /* No reconfiguring a running list */
+    TEST_ASSERT_EQUAL_HEX8(0xFE, COMMAND(0xD6));
+    TEST_ASSERT_EQUAL_HEX8(0x11, packets[0][1]);
+
+    /* Disconnecting stops everything */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xFE));
+    num_packets = 0;
+    xcp_event(XCP_EVENT_PEDALS);
+    TEST_ASSERT_EQUAL_INT(0, num_packets);
+}
+
+void test_xcp_daq_timestamp(void)
+{
+    connect_clean();
+    configure_daq(1);
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD9)); /* GET_DAQ_RESOLUTION_INFO */
+    TEST_ASSERT_EQUAL_HEX8(0x34, packets[0][5]); /* 4 bytes, 1 us */
+
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE0, 0x10, 0, 0, XCP_EVENT_PEDALS, 0,
+                                         1, 0)); /* SET_DAQ_LIST_MODE */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xDF, 0, 0, 0)); /* GET_DAQ_LIST_MODE */
+    TEST_ASSERT_EQUAL_HEX8(0x10, packets[0][1]);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xDE, 1, 0, 0));
+
+    memory[0] = 0x34;
+    memory[1] = 0x12;
+    memory[4] = 0x56;
+    now = 0x89ABCDEF;
+
+    num_packets = 0;
+    xcp_event(XCP_EVENT_PEDALS);
+    TEST_ASSERT_EQUAL_INT(2, num_packets);
+
+    /* Only the first ODT is stamped */
+    const uint8_t odt0[] = { 0, 0xEF, 0xCD, 0xAB, 0x89, 0x34, 0x12, 0x56 };
+    TEST_ASSERT_EQUAL_INT(sizeof(odt0), lens[0]);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(odt0, packets[0], sizeof(odt0));
+    TEST_ASSERT_EQUAL_INT(5, lens[1]);
+
+    /* A first ODT with no room left for the timestamp */
+    connect_clean();
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD5, 0, 1, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD4, 0, 0, 0, 1));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xD3, 0, 0, 0, 0, 1));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE2, 0, 0, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE1, 0xFF, 4, 0, 0, 0, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, COMMAND(0xE0, 0x10, 0, 0, XCP_EVENT_PEDALS, 0,
+                                         1, 0));
+    TEST_ASSERT_EQUAL_HEX8(0xFE, COMMAND(0xDE, 1, 0, 0));
+    TEST_ASSERT_EQUAL_HEX8(0x2A, packets[0][1]);
+}
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""
+Turn a black box dump into CSV, one row per pedals task iteration, and
+optionally a second CSV of the CAN frames received around it.
+
+The dump is a raw copy of the black box flash sector, read with
+"st-flash read blackbox.bin 0x0800C000 0x4000" or uploaded over XCP.
+Times are in ms relative to when the recorder was frozen, so the fault is at
+0. Pass --absolute for bus time in us instead, which lines up with logs from
+the other nodes on the bus. See blackbox.h for the format.
+
+Usage: python3 scripts/blackbox_decode.py blackbox.bin [-o samples.csv] [--can can.csv] [--absolute]
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+MAGIC = 0x31584242
+VERSION = 2
+
+SAMPLES = 512
+CAN_FRAMES = 128
+
+HEADER = struct.Struct("<8I")
+SAMPLE = struct.Struct("<I4H4BHhhBxf")
+CAN = struct.Struct("<IHBx4s")
+
+BSPD_PREFAULT = 1 << 0
+BRAKE = 1 << 1
+
+# func_state_t, see state_machine.h
+FUNC_STATES = ["READY", "F_PIT", "F_PERFORMANCE", "F_EFFICIENCY", "REVERSE", "FAULTED"]
+
+SAMPLE_COLUMNS = ["time", "state", "accel2_raw", "accel1_raw", "brake1_raw", "brake2_raw",
+                  "accel1", "accel2", "accel", "brake", "torque", "current", "mph",
+                  "bspd_prefault", "brake_on"]
+CAN_COLUMNS = ["time", "id", "len", "data"]
+
+
+def ring(data, offset, entry, size, count, next_index):
+    """Yield the entries of a ring oldest first."""
+    start = next_index - count
+    for i in range(start, next_index):
+        yield entry.unpack_from(data, offset + (i % size) * entry.size)
+
+
+def decode(data, absolute=False):
+    """Return (header, samples, frames), or None if there is no dump."""
+    if len(data) < HEADER.size:
+        return None
+
+    magic, version, num_samples, next_sample, num_can, next_can, fault, time = \
+        HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        return None
+
+    header = {"fault": fault, "time": time}
+
+    def stamp(t):
+        # Bus time wraps every 71 minutes, a dump only spans a few seconds
+        if absolute:
+            return t
+        return ((t - time + 0x80000000) % 0x100000000 - 0x80000000) / 1000
+
+    samples_offset = HEADER.size
+    can_offset = samples_offset + SAMPLES * SAMPLE.size
+
+    samples = []
+    for (t, accel2_raw, accel1_raw, brake1_raw, brake2_raw, accel1, accel2, accel, state,
+         brake, torque, current, flags, mph) in ring(data, samples_offset, SAMPLE, SAMPLES,
+                                                     num_samples, next_sample):
+        samples.append([
+            stamp(t),
+            FUNC_STATES[state] if state < len(FUNC_STATES) else state,
+            accel2_raw, accel1_raw, brake1_raw, brake2_raw,
+            accel1, accel2, accel, brake, torque, current / 10, round(mph, 2),
+            int(bool(flags & BSPD_PREFAULT)), int(bool(flags & BRAKE)),
+        ])
+
+    frames = []
+    for t, can_id, length, payload in ring(data, can_offset, CAN, CAN_FRAMES, num_can, next_can):
+        frames.append([stamp(t), "0x%03X" % can_id, length, payload[:min(length, 4)].hex()])
+
+    return header, samples, frames
+
+
+def write_csv(path, columns, rows):
+    out = open(path, "w", newline="") if path else sys.stdout
+    writer = csv.writer(out)
+    writer.writerow(columns)
+    writer.writerows(rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a black box dump to CSV")
+    parser.add_argument("dump", help="Raw copy of the black box flash sector")
+    parser.add_argument("-o", "--output", help="Samples CSV, defaults to stdout")
+    parser.add_argument("--can", help="Also write the received CAN frames to this CSV")
+    parser.add_argument("--absolute", action="store_true", help="Bus time in us instead of ms from the freeze")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as f:
+        dump = decode(f.read(), args.absolute)
+    if dump is None:
+        print("No black box dump found", file=sys.stderr)
+        return 1
+
+    header, samples, frames = dump
+    print("Fault 0x%05x frozen at %u us, %u samples, %u CAN frames"
+          % (header["fault"], header["time"], len(samples), len(frames)), file=sys.stderr)
+
+    write_csv(args.output, SAMPLE_COLUMNS, samples)
+    if args.can:
+        write_csv(args.can, CAN_COLUMNS, frames)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
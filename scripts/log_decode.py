@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""
+Rebuild the text of deferred LOG() records from a serial console capture.
+
+The target sends format string ids instead of text, see Core/Inc/log.h. The
+strings themselves are in the .log_fmt section of the ELF the target is
+running, which this reads to format each record. Text printed with
+serial_print or printf is passed through as it is.
+
+The capture must be the raw bytes off the UART, for example from
+`cat /dev/ttyUSB0 > capture.bin`, or read straight from the port with --port,
+which needs pyserial.
+
+Usage: python3 scripts/log_decode.py capture.bin [--elf build/cerberus.elf]
+       python3 scripts/log_decode.py --port /dev/ttyUSB0 [--baud 115200]
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+LOG_RECORD_START = 0x1E
+LOG_HEADER_LEN = 6
+
+SHT_NOBITS = 8
+SHF_ALLOC = 2
+
+# printf conversions, with the length modifier split out since Python has none
+CONVERSION_RE = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|j|z|t|L)?([diouxXcsfFeEgGp%])")
+
+
+class Elf:
+    """Just enough of a 32 bit little endian ELF to read sections by name and memory by address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError(f"{path} is not a 32 bit little endian ELF")
+
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 0x2E)
+
+        headers = [struct.unpack_from("<IIIIIIIIII", self.data, shoff + i * shentsize) for i in range(shnum)]
+        names = headers[shstrndx][4]
+
+        # name: (address, bytes, allocated)
+        self.sections = {}
+        for name, kind, flags, addr, offset, size, *_ in headers:
+            end = self.data.index(b"\0", names + name)
+            section = self.data[names + name:end].decode()
+            contents = b"" if kind == SHT_NOBITS else self.data[offset:offset + size]
+            self.sections[section] = (addr, contents, bool(flags & SHF_ALLOC))
+
+    def section(self, name):
+        return self.sections[name][1] if name in self.sections else b""
+
+    def string_at(self, addr):
+        """Read a string from flash, or None if the address is not in a loaded section."""
+        for section_addr, contents, alloc in self.sections.values():
+            if alloc and contents and section_addr <= addr < section_addr + len(contents):
+                offset = addr - section_addr
+                return contents[offset:contents.index(b"\0", offset)].decode(errors="replace")
+        return None
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            raise ValueError("bad COBS encoding")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def format_record(fmt, words, elf):
+    """Apply a C format string to the raw argument words."""
+    args = iter(words)
+
+    def convert(m):
+        flags, _, kind = m.groups()
+        if kind == "%":
+            return "%"
+        word = next(args, 0)
+        if kind in "di":
+            return f"%{flags}d" % struct.unpack("<i", struct.pack("<I", word))[0]
+        if kind in "ouxX":
+            return f"%{flags}{kind}" % word
+        if kind == "c":
+            return f"%{flags}c" % chr(word & 0xFF)
+        if kind == "s":
+            string = elf.string_at(word)
+            return f"%{flags}s" % (string if string is not None else f"<0x{word:08x}>")
+        if kind == "p":
+            return f"0x{word:08x}"
+        return f"%{flags}{kind}" % struct.unpack("<f", struct.pack("<I", word))[0]
+
+    return CONVERSION_RE.sub(convert, fmt)
+
+
+def decode_record(frame, formats, elf):
+    record = cobs_decode(frame)
+    if len(record) < LOG_HEADER_LEN or (len(record) - LOG_HEADER_LEN) % 4:
+        return "<bad log record>\n"
+
+    fmt_id, timestamp = struct.unpack_from("<HI", record)
+    words = struct.unpack_from(f"<{(len(record) - LOG_HEADER_LEN) // 4}I", record, LOG_HEADER_LEN)
+
+    if fmt_id >= len(formats):
+        return f"[{timestamp / 1e6:11.6f}] <unknown format {fmt_id}, is the ELF the one on the car?>\n"
+    fmt = formats[fmt_id:formats.index(b"\0", fmt_id)].decode(errors="replace")
+
+    return f"[{timestamp / 1e6:11.6f}] " + format_record(fmt, words, elf).lstrip("\r\n")
+
+
+def decode_stream(chunks, elf, out):
+    formats = elf.section(".log_fmt")
+    frame = None
+
+    for chunk in chunks:
+        text = bytearray()
+        for byte in chunk:
+            if frame is not None:
+                if byte == 0:
+                    out.write(decode_record(bytes(frame), formats, elf).replace("\r", ""))
+                    frame = None
+                else:
+                    frame.append(byte)
+            elif byte == LOG_RECORD_START:
+                out.write(text.decode(errors="replace").replace("\r", ""))
+                text = bytearray()
+                frame = bytearray()
+            else:
+                text.append(byte)
+        out.write(text.decode(errors="replace").replace("\r", ""))
+        out.flush()
+
+
+def read_file(path):
+    with open(path, "rb") as f:
+        while chunk := f.read(4096):
+            yield chunk
+
+
+def read_port(port, baud):
+    import serial  # pyserial
+
+    with serial.Serial(port, baud, timeout=0.1) as s:
+        while True:
+            yield s.read(4096)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode deferred LOG() records in a serial capture")
+    parser.add_argument("capture", nargs="?", help="Raw serial capture")
+    parser.add_argument("--elf", default="build/cerberus.elf", help="ELF the target is running")
+    parser.add_argument("--port", help="Read from a serial port instead of a capture")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    if not args.capture and not args.port:
+        parser.error("pass a capture or --port")
+
+    elf = Elf(args.elf)
+    if not elf.section(".log_fmt"):
+        print(f"{args.elf} has no .log_fmt section, was it built with LOG_TEXT?", file=sys.stderr)
+        return 1
+
+    chunks = read_port(args.port, args.baud) if args.port else read_file(args.capture)
+    try:
+        decode_stream(chunks, elf, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+"""
+RAM budget report, built from the linker map file.
+
+Every task stack, kernel control block, queue buffer and driver struct is
+statically allocated, so the map file accounts for all of RAM. Storage is
+grouped by the naming convention used for it:
+
+    <name>_stack       task stacks
+    <name>_cb          kernel object control blocks
+    <name>_buf         queue storage
+    <name>_data        driver structs
+
+Variables placed with the macros in ccmram.h get their own section, so they
+are listed by name under CCMRAM like everything else. --placement lists every
+symbol in every RAM region, which the build writes next to the map file.
+
+Usage: python3 scripts/ram_report.py build/cerberus.map [--budget BYTES] [--top N] [--placement]
+Exits with an error if RAM use is over the budget, or if anything that looks
+like a DMA buffer was placed in CCM RAM, which DMA can't reach.
+"""
+
+import argparse
+import re
+import sys
+from collections import defaultdict
+
+CATEGORIES = [
+    ("task stacks", re.compile(r"(_stack|TaskBuffer|_Stack)$")),
+    ("control blocks", re.compile(r"(_cb|ControlBlock|_TCB)$")),
+    ("queue storage", re.compile(r"_buf$")),
+    ("driver structs", re.compile(r"_data$")),
+    ("kernel heap", re.compile(r"^ucHeap$")),
+]
+
+REGION_RE = re.compile(r"^(\w+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+OUTPUT_RE = re.compile(r"^(\.\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+))?\s*$")
+OUTPUT_CONT_RE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s*$")
+INPUT_RE = re.compile(r"^ (\.\S+|COMMON)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+))?\s*$")
+CONT_RE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+)\s*$")
+
+
+def parse_map(path):
+    """Return the memory regions, the output sections and every input section placed in them."""
+    regions = {}
+    outputs = []  # (output section, address, size)
+    sections = []  # (output section, input section, address, size, object)
+    in_regions = False
+    output = None
+    pending = None
+    pending_output = False
+
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip("\n")
+
+            if line.startswith("Memory Configuration"):
+                in_regions = True
+                continue
+            if in_regions:
+                if line.startswith("Linker script and memory map"):
+                    in_regions = False
+                m = REGION_RE.match(line)
+                if m and m.group(1) != "Name":
+                    regions[m.group(1)] = (int(m.group(2), 16), int(m.group(3), 16))
+                continue
+
+            m = OUTPUT_RE.match(line)
+            if m:
+                output = m.group(1)
+                pending = None
+                if m.group(2):
+                    outputs.append((output, int(m.group(2), 16), int(m.group(3), 16)))
+                    pending_output = False
+                else:
+                    pending_output = True
+                continue
+
+            m = OUTPUT_CONT_RE.match(line)
+            if m and pending_output:
+                outputs.append((output, int(m.group(1), 16), int(m.group(2), 16)))
+                pending_output = False
+                continue
+            pending_output = False
+
+            m = INPUT_RE.match(line)
+            if m:
+                name = m.group(1)
+                if m.group(2):
+                    sections.append((output, name, int(m.group(2), 16), int(m.group(3), 16), m.group(4)))
+                    pending = None
+                else:
+                    # Long section names put the address on the next line
+                    pending = name
+                continue
+
+            m = CONT_RE.match(line)
+            if m and pending:
+                sections.append((output, pending, int(m.group(1), 16), int(m.group(2), 16), m.group(3)))
+                pending = None
+
+    return regions, outputs, sections
+
+
+def region_of(regions, addr):
+    for name, (origin, length) in regions.items():
+        if origin <= addr < origin + length and name != "*default*":
+            return name
+    return None
+
+
+def symbol_of(section):
+    """.bss.fault_handle_stack -> fault_handle_stack"""
+    for prefix in (".bss.", ".data.", ".ccmram.", ".ccmbss."):
+        if section.startswith(prefix):
+            return section[len(prefix):]
+    return section
+
+
+def categorize(symbol):
+    for category, pattern in CATEGORIES:
+        if pattern.search(symbol):
+            return category
+    return "other"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Summarize RAM use from a linker map file")
+    parser.add_argument("map", help="Linker map file")
+    parser.add_argument("--budget", type=int, help="Fail if main RAM use is above this many bytes")
+    parser.add_argument("--top", type=int, default=15, help="Number of largest symbols to list")
+    parser.add_argument("--placement", action="store_true", help="List every symbol by region and address")
+    args = parser.parse_args()
+
+    regions, outputs, sections = parse_map(args.map)
+    ram_regions = [r for r in regions if "RAM" in r.upper()]
+
+    used = defaultdict(int)
+    by_category = defaultdict(int)
+    by_object = defaultdict(int)
+    symbols = []
+
+    # Initialized data also takes flash for its load image, only the RAM copy is counted here
+    for output, addr, size in outputs:
+        region = region_of(regions, addr)
+        if region in ram_regions:
+            used[region] += size
+            if output == "._user_heap_stack":
+                by_category["newlib heap and main stack"] += size
+
+    for output, section, addr, size, obj in sections:
+        region = region_of(regions, addr)
+        if region not in ram_regions or size == 0:
+            continue
+        symbol = symbol_of(section)
+        by_category[categorize(symbol)] += size
+        by_object[obj.split("/")[-1]] += size
+        symbols.append((size, symbol, region, addr, obj.split("/")[-1]))
+
+    print("Region        Used       Size   Use")
+    for region in ram_regions:
+        length = regions[region][1]
+        print(f"{region:<10} {used[region]:>7} {length:>10} {100.0 * used[region] / length:>5.1f}%")
+
+    print("\nCategory                       Bytes")
+    for category, size in sorted(by_category.items(), key=lambda x: -x[1]):
+        print(f"{category:<28} {size:>9}")
+
+    print("\nObject             Bytes")
+    for obj, size in sorted(by_object.items(), key=lambda x: -x[1]):
+        print(f"{obj:<16} {size:>7}")
+
+    print(f"\nLargest {args.top} symbols")
+    for size, symbol, region, _, _ in sorted(symbols, reverse=True)[: args.top]:
+        print(f"{size:>7}  {symbol} ({region})")
+
+    if args.placement:
+        for region in ram_regions:
+            print(f"\n{region}")
+            for size, symbol, _, addr, obj in sorted(
+                (s for s in symbols if s[2] == region), key=lambda s: s[3]
+            ):
+                print(f"  0x{addr:08x} {size:>7}  {symbol:<40} {obj}")
+
+    ret = 0
+
+    for size, symbol, region, _, obj in symbols:
+        if region == "CCMRAM" and "dma" in symbol.lower():
+            print(f"\n{symbol} ({obj}) is in CCMRAM, which DMA can't reach", file=sys.stderr)
+            ret = 1
+
+    if args.budget is not None and used["RAM"] > args.budget:
+        print(f"\nRAM use of {used['RAM']} bytes is over the budget of {args.budget}", file=sys.stderr)
+        ret = 1
+
+    return ret
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""
+Turn a kernel trace dump into a Chrome trace, which can be opened in
+chrome://tracing or https://ui.perfetto.dev.
+
+The dump can be a serial console log, where every record is a line of
+"TRACE <16 hex digits>", or a candump log of the CANID_TRACE_DUMP frames.
+Anything else in the log is ignored, so a whole session can be passed in.
+See trace.h and trace_dump.h for the record format.
+
+Queues, mutexes and semaphores are recorded by the address of their control
+block. Pass the map file to name them after their _cb symbol.
+
+Usage: python3 scripts/trace_decode.py dump.log [--map build/cerberus.map] [-o trace.json]
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ram_report import parse_map, symbol_of  # noqa: E402
+
+CANID_TRACE_DUMP = 0x50A
+
+TASK_SWITCHED_IN = 1
+QUEUE_SEND = 2
+QUEUE_SEND_FAILED = 3
+QUEUE_RECEIVE = 4
+QUEUE_RECEIVE_FAILED = 5
+QUEUE_SEND_FROM_ISR = 6
+QUEUE_RECEIVE_FROM_ISR = 7
+TASK_NOTIFY = 8
+TASK_NOTIFY_FROM_ISR = 9
+ISR_ENTER = 10
+ISR_EXIT = 11
+FREEZE = 12
+DUMP_START = 0xF0
+TASK_NAME = 0xF1
+DUMP_END = 0xF2
+
+QUEUE_EVENTS = {
+    QUEUE_SEND: "send",
+    QUEUE_SEND_FAILED: "send failed",
+    QUEUE_RECEIVE: "receive",
+    QUEUE_RECEIVE_FAILED: "receive failed",
+    QUEUE_SEND_FROM_ISR: "send from ISR",
+    QUEUE_RECEIVE_FROM_ISR: "receive from ISR",
+}
+
+# Exception numbers of the interrupts that are traced, see stm32f4xx_it.c
+ISR_NAMES = {
+    16 + 7: "EXTI1",
+    16 + 10: "EXTI4",
+    16 + 14: "DMA1_Stream3",
+    16 + 18: "ADC",
+    16 + 20: "CAN1_RX0",
+    16 + 23: "EXTI9_5",
+    16 + 39: "USART3",
+    16 + 55: "TIM7",
+}
+
+ISR_TID = 0
+
+SERIAL_RE = re.compile(r"TRACE ([0-9a-fA-F]{16})")
+CANDUMP_LOG_RE = re.compile(r"\b([0-9a-fA-F]{3})#([0-9a-fA-F]{16})\b")
+CANDUMP_RE = re.compile(r"\b([0-9a-fA-F]{3})\s+\[8\]\s+((?:[0-9a-fA-F]{2}\s*){8})")
+
+
+def read_records(path):
+    """Yield (timestamp, type, task, arg) for every trace record in a log."""
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = SERIAL_RE.search(line)
+            if m:
+                data = bytes.fromhex(m.group(1))
+            else:
+                m = CANDUMP_LOG_RE.search(line) or CANDUMP_RE.search(line)
+                if not m or int(m.group(1), 16) != CANID_TRACE_DUMP:
+                    continue
+                data = bytes.fromhex(m.group(2).replace(" ", ""))
+            yield struct.unpack("<IBBH", data)
+
+
+def object_names(map_path):
+    """Map control block addresses to their symbols."""
+    names = {}
+    if map_path:
+        _, _, sections = parse_map(map_path)
+        for _, section, addr, _, _ in sections:
+            names[addr] = symbol_of(section)
+    return names
+
+
+def object_address(object_id):
+    """Reverse of trace_object_id()."""
+    base = 0x10000000 if object_id & 0x8000 else 0x20000000
+    return base + ((object_id & 0x7FFF) << 2)
+
+
+def decode(records, objects):
+    clock = None
+    names = {}
+    events = []
+    now = 0  # timebase ticks, unwrapped
+    last = None
+    running = None  # (task, start)
+    isr_stack = []
+
+    def us(ticks):
+        return ticks * 1e6 / clock
+
+    def task_name(task):
+        return names.get(task, f"task {task}")
+
+    for timestamp, kind, task, arg in records:
+        if kind == DUMP_START:
+            clock = timestamp
+            names = {}
+            events = []
+            now = 0
+            last = None
+            running = None
+            isr_stack = []
+            continue
+        if kind == TASK_NAME:
+            chunk = struct.pack("<I", timestamp).rstrip(b"\0").decode(errors="replace")
+            name = names.get(task, "")
+            names[task] = name[:arg] + chunk
+            continue
+        if kind == DUMP_END:
+            break
+        if clock is None:
+            continue
+
+        # Events are stamped with bus time, so traces from different nodes line up.
+        # It wraps every 71 minutes, the kernel switches tasks far more often than that
+        if last is None:
+            now = timestamp
+        else:
+            now += (timestamp - last) & 0xFFFFFFFF
+        last = timestamp
+        ts = us(now)
+
+        if kind == TASK_SWITCHED_IN:
+            if running and running[0] != task:
+                events.append({"name": task_name(running[0]), "ph": "X", "pid": 0, "tid": running[0],
+                               "ts": us(running[1]), "dur": ts - us(running[1])})
+                running = (task, now)
+            elif not running:
+                running = (task, now)
+        elif kind in QUEUE_EVENTS:
+            addr = object_address(arg)
+            obj = objects.get(addr, f"0x{addr:08x}")
+            tid = ISR_TID if kind in (QUEUE_SEND_FROM_ISR, QUEUE_RECEIVE_FROM_ISR) else task
+            events.append({"name": f"{QUEUE_EVENTS[kind]} {obj}", "ph": "i", "s": "t", "pid": 0, "tid": tid, "ts": ts})
+        elif kind in (TASK_NOTIFY, TASK_NOTIFY_FROM_ISR):
+            tid = ISR_TID if kind == TASK_NOTIFY_FROM_ISR else task
+            events.append({"name": f"notify {task_name(arg)}", "ph": "i", "s": "t", "pid": 0, "tid": tid, "ts": ts})
+        elif kind == ISR_ENTER:
+            isr_stack.append(arg)
+            events.append({"name": ISR_NAMES.get(arg, f"exception {arg}"), "ph": "B", "pid": 0, "tid": ISR_TID, "ts": ts})
+        elif kind == ISR_EXIT:
+            if isr_stack:
+                isr_stack.pop()
+                events.append({"name": ISR_NAMES.get(arg, f"exception {arg}"), "ph": "E", "pid": 0, "tid": ISR_TID, "ts": ts})
+        elif kind == FREEZE:
+            events.append({"name": "fault, trace frozen", "ph": "i", "s": "g", "pid": 0, "tid": task, "ts": ts})
+
+    if clock is None:
+        return None
+
+    if running:
+        events.append({"name": task_name(running[0]), "ph": "X", "pid": 0, "tid": running[0],
+                       "ts": us(running[1]), "dur": us(now) - us(running[1])})
+
+    events.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": ISR_TID, "args": {"name": "Interrupts"}})
+    for task, name in names.items():
+        events.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": task, "args": {"name": name}})
+
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a kernel trace dump to a Chrome trace")
+    parser.add_argument("log", help="Serial console or candump log containing a dump")
+    parser.add_argument("--map", help="Linker map file, to name queues and mutexes")
+    parser.add_argument("-o", "--output", help="Output file, defaults to stdout")
+    args = parser.parse_args()
+
+    trace = decode(read_records(args.log), object_names(args.map))
+    if trace is None:
+        print("No trace dump found", file=sys.stderr)
+        return 1
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    json.dump(trace, out, indent=1)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())